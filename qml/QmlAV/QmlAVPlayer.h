@@ -26,10 +26,8 @@
 #include <QtCore/QObject>
 #include <QmlAV/QQuickItemRenderer.h>
 
-/*!
- *  Not work: autoPlay, autoLoad
- */
 namespace QtAV {
+class AVError;
 class AVPlayer;
 }
 using namespace QtAV;
@@ -43,6 +41,7 @@ class QMLAV_EXPORT QmlAVPlayer : public QObject
     Q_PROPERTY(bool hasAudio READ hasAudio NOTIFY hasAudioChanged)
     Q_PROPERTY(bool hasVideo READ hasVideo NOTIFY hasVideoChanged)
     Q_PROPERTY(PlaybackState playbackState READ playbackState NOTIFY playbackStateChanged)
+    Q_PROPERTY(Status status READ status NOTIFY statusChanged)
     Q_PROPERTY(bool autoPlay READ autoPlay WRITE setAutoPlay NOTIFY autoPlayChanged)
     Q_PROPERTY(bool autoLoad READ isAutoLoad WRITE setAutoLoad NOTIFY autoLoadChanged)
     Q_PROPERTY(qreal speed READ speed WRITE setSpeed NOTIFY speedChanged)
@@ -51,6 +50,7 @@ class QMLAV_EXPORT QmlAVPlayer : public QObject
     Q_PROPERTY(bool seekable READ isSeekable NOTIFY seekableChanged)
     Q_ENUMS(Loop)
     Q_ENUMS(PlaybackState)
+    Q_ENUMS(Status)
     // not supported by QtMultimedia
     Q_PROPERTY(QStringList videoCodecs READ videoCodecs)
     Q_PROPERTY(QStringList videoCodecPriority READ videoCodecPriority WRITE setVideoCodecPriority NOTIFY videoCodecPriorityChanged)
@@ -65,6 +65,14 @@ public:
         PausedState,
         StoppedState
     };
+    // a subset of QtMultimedia's MediaPlayer.Status
+    enum Status {
+        UnknownStatus,
+        NoMedia,
+        Loading, // autoLoad or autoPlay. the file is opened in a thread
+        Loaded,
+        InvalidMedia
+    };
 
     explicit QmlAVPlayer(QObject *parent = 0);
 
@@ -88,6 +96,7 @@ public:
     int position() const;
     bool isSeekable() const;
     PlaybackState playbackState() const;
+    Status status() const;
     void setPlaybackState(PlaybackState playbackState);
     qreal speed() const;
     void setSpeed(qreal s);
@@ -127,6 +136,7 @@ Q_SIGNALS:
     void loopCountChanged();
     void videoOutChanged();
     void playbackStateChanged();
+    void statusChanged();
     void autoPlayChanged();
     void speedChanged();
     void paused();
@@ -140,14 +150,18 @@ private Q_SLOTS:
     void _q_started();
     void _q_stopped();
     void _q_paused(bool);
+    void _q_loaded();
+    void _q_error(const QtAV::AVError& e);
 
 private:
     Q_DISABLE_COPY(QmlAVPlayer)
+    void setStatus(Status s);
 
     bool mAutoPlay;
     bool mAutoLoad;
     int mLoopCount;
     PlaybackState mPlaybackState;
+    Status mStatus;
     QtAV::AVPlayer *mpPlayer;
     QUrl mSource;
     QStringList mVideoCodecs;
@@ -22,6 +22,7 @@
 #include "QmlAVPlayer.h"
 #include <QtAV/AVPlayer.h>
 #include <QtAV/AudioOutput.h>
+#include <QtAV/AVError.h>
 
 template<typename ID, typename Factory>
 static QStringList idsToNames(QVector<ID> ids) {
@@ -60,12 +61,15 @@ QmlAVPlayer::QmlAVPlayer(QObject *parent) :
   , mAutoLoad(false)
   , mLoopCount(1)
   , mPlaybackState(StoppedState)
+  , mStatus(NoMedia)
   , mpPlayer(0)
 {
     mpPlayer = new AVPlayer(this);
     connect(mpPlayer, SIGNAL(paused(bool)), SLOT(_q_paused(bool)));
     connect(mpPlayer, SIGNAL(started()), SLOT(_q_started()));
     connect(mpPlayer, SIGNAL(stopped()), SLOT(_q_stopped()));
+    connect(mpPlayer, SIGNAL(loaded()), SLOT(_q_loaded()));
+    connect(mpPlayer, SIGNAL(error(QtAV::AVError)), SLOT(_q_error(QtAV::AVError)));
     connect(mpPlayer, SIGNAL(positionChanged(qint64)), SIGNAL(positionChanged()));
 
     mVideoCodecs << "FFmpeg";
@@ -100,7 +104,11 @@ void QmlAVPlayer::setSource(const QUrl &url)
     // TODO: in componentComplete()?
     if (mAutoLoad || mAutoPlay) {
         mpPlayer->stop();
-        mpPlayer->load();
+        // do not block the ui thread. play() waits for loaded()
+        mpPlayer->loadAsync();
+        setStatus(mSource.isEmpty() ? NoMedia : Loading);
+    } else {
+        setStatus(mSource.isEmpty() ? NoMedia : UnknownStatus);
     }
     if (mAutoPlay) {
         play();
@@ -225,6 +233,19 @@ QmlAVPlayer::PlaybackState QmlAVPlayer::playbackState() const
     return mPlaybackState;
 }
 
+QmlAVPlayer::Status QmlAVPlayer::status() const
+{
+    return mStatus;
+}
+
+void QmlAVPlayer::setStatus(Status s)
+{
+    if (mStatus == s)
+        return;
+    mStatus = s;
+    emit statusChanged();
+}
+
 void QmlAVPlayer::setPlaybackState(PlaybackState playbackState)
 {
     if (mPlaybackState == playbackState) {
@@ -325,8 +346,24 @@ void QmlAVPlayer::_q_paused(bool p)
     emit playbackStateChanged();
 }
 
+void QmlAVPlayer::_q_loaded()
+{
+    setStatus(Loaded);
+    emit durationChanged();
+    emit hasAudioChanged();
+    emit hasVideoChanged();
+}
+
+void QmlAVPlayer::_q_error(const QtAV::AVError &e)
+{
+    Q_UNUSED(e);
+    if (mStatus == Loading)
+        setStatus(InvalidMedia);
+}
+
 void QmlAVPlayer::_q_started()
 {
+    setStatus(Loaded);
     mPlaybackState = PlayingState;
     emit playing();
     emit playbackStateChanged();
@@ -87,6 +87,9 @@ void AVClock::updateExternalClock(const AVClock &clock)
 
 void AVClock::setSpeed(qreal speed)
 {
+    // the time elapsed since the last value() is at the old speed
+    if (clock_type != AudioClock && timer.isValid())
+        value();
     mSpeed = speed;
 }
 
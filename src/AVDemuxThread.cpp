@@ -24,13 +24,51 @@
 #include <QtAV/AVDecoder.h>
 #include <QtAV/Packet.h>
 #include <QtAV/AVThread.h>
-#include <QtCore/QTimer>
-#include <QtCore/QEventLoop>
+#include <QtAV/Statistics.h>
+#include <QtAV/StreamRecorder.h>
+#include <QtAV/QtAV_Compat.h>
 
 #define CORRECT_END 1
 
 namespace QtAV {
 
+// seek requests closer than it are scrubbing. ms
+static const qint64 kSeekInterval = 168;
+// jitter buffer. smoothing factor of the jitter(rfc 3550) and the target depth in jitters
+static const qreal kJitterGain = 1.0/16.0;
+static const qreal kJitterTargetFactor = 4.0;
+
+class AVDemuxThread::ReadThread : public QThread
+{
+public:
+    ReadThread(AVDemuxThread *thread) : QThread(thread), mpDemuxThread(thread) {}
+protected:
+    virtual void run() { mpDemuxThread->readPackets(); }
+private:
+    AVDemuxThread *mpDemuxThread;
+};
+
+// AVCodecContext.skip_frame is read by the decoder, so it's changed in the video thread
+class SkipFrameTask : public QRunnable
+{
+public:
+    SkipFrameTask(AVThread *thread, AVDiscard discard):
+        QRunnable()
+      , mpThread(thread)
+      , mDiscard(discard)
+    {
+        setAutoDelete(true);
+    }
+    virtual void run() {
+        AVDecoder *dec = mpThread->decoder();
+        if (dec && dec->codecContext())
+            dec->codecContext()->skip_frame = mDiscard;
+    }
+private:
+    AVThread *mpThread;
+    AVDiscard mDiscard;
+};
+
 class QueueEmptyCall : public PacketQueue::StateChangeCallback
 {
 public:
@@ -56,17 +94,64 @@ private:
 };
 
 AVDemuxThread::AVDemuxThread(QObject *parent) :
-    QThread(parent),paused(false),seeking(false),end(true)
+    QThread(parent),paused(false),seeking(false),pause_after_seek(false),end(true)
+    ,seek_pos(0),seek_preview(false),preview(false),preview_done(false)
+    ,key_frame_only(false),key_frame_only_applied(false),key_frame_interval(0),last_key_pts(-1)
     ,demuxer(0)
     ,audio_thread(0),video_thread(0)
+  , running_threads(0)
+  , staging_bytes(0)
+  , prefetch_bytes(32*1024*1024)
+  , prefetch_seconds(8.0)
+  , read_end(false)
+  , stop_read(false)
+  , last_pts(-1)
+  , drop_pts(-1)
+  , jitter_enabled(false)
+  , jitter_floor(0.1)
+  , jitter_ceiling(2.0)
+  , jitter(0)
+  , jitter_target(0.1)
+  , last_transit(-1e10)
+  , jitter_stream(-1)
+  , buffering(false)
+  , overflowing(false)
+  , underruns(0)
+  , overflows(0)
+  , statistics(0)
+  , recorder(0)
 {
+    read_thread = new ReadThread(this);
 }
 
 AVDemuxThread::AVDemuxThread(AVDemuxer *dmx, QObject *parent) :
-    QThread(parent),paused(false),seeking(false),end(true)
+    QThread(parent),paused(false),seeking(false),pause_after_seek(false),end(true)
+    ,seek_pos(0),seek_preview(false),preview(false),preview_done(false)
+    ,key_frame_only(false),key_frame_only_applied(false),key_frame_interval(0),last_key_pts(-1)
     ,audio_thread(0),video_thread(0)
   , running_threads(0)
+  , staging_bytes(0)
+  , prefetch_bytes(32*1024*1024)
+  , prefetch_seconds(8.0)
+  , read_end(false)
+  , stop_read(false)
+  , last_pts(-1)
+  , drop_pts(-1)
+  , jitter_enabled(false)
+  , jitter_floor(0.1)
+  , jitter_ceiling(2.0)
+  , jitter(0)
+  , jitter_target(0.1)
+  , last_transit(-1e10)
+  , jitter_stream(-1)
+  , buffering(false)
+  , overflowing(false)
+  , underruns(0)
+  , overflows(0)
+  , statistics(0)
+  , recorder(0)
 {
+    read_thread = new ReadThread(this);
     setDemuxer(dmx);
 }
 
@@ -89,6 +174,7 @@ void AVDemuxThread::setAVThread(AVThread*& pOld, AVThread *pNew)
         disconnect(pOld, SIGNAL(terminated()), this, SLOT(notifyEnd()));
         disconnect(pOld, SIGNAL(finished()), this, SLOT(notifyEnd()));
 #endif //CORRECT_END
+        disconnect(pOld, SIGNAL(seekFinished(qreal)), this, SLOT(onSeekFinished()));
     }
     pOld = pNew;
     if (!pNew)
@@ -97,6 +183,7 @@ void AVDemuxThread::setAVThread(AVThread*& pOld, AVThread *pNew)
     connect(pOld, SIGNAL(terminated()), this, SLOT(notifyEnd()));
     connect(pOld, SIGNAL(finished()), this, SLOT(notifyEnd()));
 #endif //CORRECT_END
+    connect(pOld, SIGNAL(seekFinished(qreal)), this, SLOT(onSeekFinished()));
     pOld->packetQueue()->setEmptyCallback(new QueueEmptyCall(this));
 }
 
@@ -120,10 +207,65 @@ AVThread* AVDemuxThread::audioThread()
     return audio_thread;
 }
 
+/*
+ * A seek request is put in a mailbox and the demux thread runs it before reading the next packet.
+ * A newer request overwrites the pending one, so when scrubbing only the latest position is used.
+ * Requests closer than kSeekInterval are previews: only the first video key frame after the seek
+ * is decoded and presented. When no request comes for kSeekInterval, the last preview position is
+ * seeked again normally.
+ */
 void AVDemuxThread::seek(qint64 pos)
 {
-    qDebug("demux thread start to seek...");
-    seeking = true;
+    if (!isRunning()) {
+        seekInternal(pos, false);
+        return;
+    }
+    {
+        QMutexLocker lock(&seek_mutex);
+        Q_UNUSED(lock);
+        seek_preview = seeking || preview || (seek_timer.isValid() && !seek_timer.hasExpired(kSeekInterval));
+        seek_timer.start();
+        seek_pos = pos;
+        seeking = true;
+    }
+    // wake up the demux thread blocked by a full queue, pause or preview
+    if (audio_thread)
+        audio_thread->packetQueue()->clear();
+    if (video_thread)
+        video_thread->packetQueue()->clear();
+    cond.wakeAll();
+    seek_cond.wakeAll();
+    staging_data_cond.wakeAll();
+}
+
+bool AVDemuxThread::processNextSeek()
+{
+    qint64 pos = 0;
+    bool preview_seek = false;
+    {
+        QMutexLocker lock(&seek_mutex);
+        Q_UNUSED(lock);
+        if (seeking) {
+            pos = seek_pos;
+            preview_seek = seek_preview;
+            seeking = false;
+        } else if (preview && seek_timer.hasExpired(kSeekInterval)) {
+            // scrubbing stopped
+            pos = seek_pos;
+        } else {
+            return false;
+        }
+    }
+    seekInternal(pos, preview_seek);
+    return true;
+}
+
+void AVDemuxThread::seekInternal(qint64 pos, bool previewSeek)
+{
+    qDebug("demux thread start to seek %lld. preview: %d", pos, previewSeek);
+    preview = previewSeek;
+    preview_done = false;
+    last_key_pts = -1;
     end = false;
     if (audio_thread) {
         audio_thread->setDemuxEnded(false);
@@ -133,7 +275,41 @@ void AVDemuxThread::seek(qint64 pos)
         video_thread->setDemuxEnded(false);
         video_thread->packetQueue()->clear();
     }
-    demuxer->seek(pos);
+    /*
+     * accurate seek: decode from the key frame to the target and present the target only.
+     * when paused, the video thread presents 1 frame then pauses itself, see onSeekFinished().
+     * resume before setting the target because pause(false) cancels pausing after seek
+     */
+    const bool paused_seek = (isPaused() || pause_after_seek) && video_thread;
+    if (paused_seek) {
+        pause(false);
+        video_thread->pause(false);
+    }
+    // a preview presents the key frame without sync
+    const bool accurate = !preview && demuxer->seekTarget() == AVDemuxer::SeekTarget_AnyFrame;
+    const qreal target = accurate ? qreal(pos)/1000.0 : 0;
+    if (audio_thread && accurate)
+        audio_thread->setSeekTarget(target);
+    if (video_thread && (accurate || paused_seek || preview))
+        video_thread->setSeekTarget(target, paused_seek);
+    {
+        // wait for the current read. packets staged before the seek are dropped
+        QMutexLocker lock(&read_mutex);
+        Q_UNUSED(lock);
+        demuxer->seek(pos);
+        clearStaging();
+    }
+    if (recorder)
+        recorder->discontinue();
+    if (jitter_enabled) {
+        QMutexLocker lock(&staging_mutex);
+        const bool changed = !buffering;
+        buffering = true;
+        // a slot may call prefetchBytes() and lock staging_mutex
+        lock.unlock();
+        if (changed)
+            emit bufferingChanged(true);
+    }
     // TODO: why queue may not empty?
     if (audio_thread) {
         audio_thread->packetQueue()->clear();
@@ -147,20 +323,7 @@ void AVDemuxThread::seek(qint64 pos)
     //     subtitle_thread->packetQueue()->clear();
     //    subtitle_thread->packetQueue()->put(Packet());
     //}
-    seeking = false;
-    seek_cond.wakeAll();
-    if (isPaused()) {
-        pause(false);
-        AVThread *avthread = video_thread;
-        if (!avthread)
-            avthread = audio_thread;
-        avthread->pause(false);
-        QEventLoop loop;
-        QTimer::singleShot(40, &loop, SLOT(quit()));
-        loop.exec();
-        pause(true);
-        avthread->pause(true);
-    }
+    pause_after_seek = paused_seek;
 }
 
 bool AVDemuxThread::isPaused() const
@@ -173,11 +336,150 @@ bool AVDemuxThread::isEnd() const
     return end;
 }
 
+void AVDemuxThread::setKeyFrameOnly(bool only, qreal minInterval)
+{
+    key_frame_interval = minInterval;
+    if (key_frame_only == only)
+        return;
+    key_frame_only = only;
+    if (!isRunning())
+        applyKeyFrameOnly();
+    // the queued audio is out of date
+    if (only && audio_thread)
+        audio_thread->packetQueue()->clear();
+    cond.wakeAll();
+}
+
+bool AVDemuxThread::isKeyFrameOnly() const
+{
+    return key_frame_only;
+}
+
+void AVDemuxThread::applyKeyFrameOnly()
+{
+    if (key_frame_only_applied == key_frame_only || !demuxer)
+        return;
+    key_frame_only_applied = key_frame_only;
+    last_key_pts = -1;
+    // skip_frame is for the packets already in the queue
+    applyStreamDiscard();
+    if (video_thread)
+        video_thread->scheduleTask(new SkipFrameTask(video_thread, key_frame_only ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT));
+    qDebug("demux thread key frame only: %d", key_frame_only);
+}
+
+void AVDemuxThread::setPrefetchLimit(qint64 bytes, qreal seconds)
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    prefetch_bytes = bytes;
+    prefetch_seconds = seconds;
+    staging_space_cond.wakeAll();
+}
+
+qint64 AVDemuxThread::prefetchBytes() const
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    return prefetch_bytes;
+}
+
+qreal AVDemuxThread::prefetchDuration() const
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    return prefetch_seconds;
+}
+
+qreal AVDemuxThread::lastPts() const
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    return last_pts;
+}
+
+void AVDemuxThread::dropTo(qreal pts)
+{
+    {
+        QMutexLocker lock(&staging_mutex);
+        Q_UNUSED(lock);
+        drop_pts = pts;
+    }
+    if (audio_thread)
+        audio_thread->packetQueue()->clear();
+    if (video_thread)
+        video_thread->packetQueue()->clear();
+}
+
+void AVDemuxThread::setJitterBufferEnabled(bool enabled)
+{
+    QMutexLocker lock(&staging_mutex);
+    if (jitter_enabled == enabled)
+        return;
+    jitter_enabled = enabled;
+    last_transit = -1e10;
+    const bool changed = !enabled && buffering;
+    if (changed)
+        buffering = false;
+    staging_data_cond.wakeAll();
+    staging_space_cond.wakeAll();
+    // a slot may call prefetchBytes() and lock staging_mutex
+    lock.unlock();
+    if (changed)
+        emit bufferingChanged(false);
+}
+
+bool AVDemuxThread::isJitterBufferEnabled() const
+{
+    return jitter_enabled;
+}
+
+void AVDemuxThread::setJitterBufferRange(int floorMs, int ceilingMs)
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    jitter_floor = qreal(qMax(floorMs, 0))/1000.0;
+    jitter_ceiling = qMax(jitter_floor, qreal(ceilingMs)/1000.0);
+    jitter_target = qBound(jitter_floor, kJitterTargetFactor*jitter, jitter_ceiling);
+    staging_space_cond.wakeAll();
+}
+
+void AVDemuxThread::setStatistics(Statistics *s)
+{
+    statistics = s;
+}
+
+void AVDemuxThread::setRecorder(StreamRecorder *r)
+{
+    recorder = r;
+}
+
+void AVDemuxThread::applyStreamDiscard()
+{
+    if (!demuxer)
+        return;
+    /*
+     * keep only the streams with an avthread, so the packets of subtitles, other audio tracks and
+     * the video of an audio only player are neither parsed, copied nor queued. audio is not read
+     * in key frame only mode
+     */
+    QList<int> streams;
+    if (audio_stream >= 0 && audio_thread && !key_frame_only)
+        streams.append(audio_stream);
+    if (video_stream >= 0 && video_thread)
+        streams.append(video_stream);
+    // not in the middle of av_read_frame()
+    QMutexLocker lock(&read_mutex);
+    Q_UNUSED(lock);
+    demuxer->discardStreamsExcept(streams, key_frame_only);
+}
+
 //No more data to put. So stop blocking the queue to take the reset elements
 void AVDemuxThread::stop()
 {
     qDebug("void AVDemuxThread::stop()");
     end = true;
+    staging_data_cond.wakeAll();
     //this will not affect the pause state if we pause the output
     //TODO: why remove blockFull(false) can not play another file?
     if (audio_thread) {
@@ -197,6 +499,7 @@ void AVDemuxThread::stop()
 void AVDemuxThread::pause(bool p)
 {
     qDebug("demux thread pause %d", p);
+    pause_after_seek = false;
     if (paused == p)
         return;
     paused = p;
@@ -204,6 +507,14 @@ void AVDemuxThread::pause(bool p)
         cond.wakeAll();
 }
 
+void AVDemuxThread::onSeekFinished()
+{
+    if (!pause_after_seek)
+        return;
+    pause_after_seek = false;
+    pause(true);
+}
+
 void AVDemuxThread::notifyEnd()
 {
     pause(false);
@@ -246,6 +557,27 @@ void AVDemuxThread::run()
 
     audio_stream = demuxer->audioStream();
     video_stream = demuxer->videoStream();
+    // the demuxer may be reloaded with default discard flags
+    applyStreamDiscard();
+    key_frame_only_applied = false;
+    clearStaging();
+    {
+        QMutexLocker lock(&staging_mutex);
+        // the arrival jitter is measured on the stream whose queue is dispatched
+        jitter_stream = video_thread ? video_stream : audio_stream;
+        jitter = 0;
+        jitter_target = jitter_floor;
+        underruns = overflows = 0;
+        overflowing = false;
+        arrival_timer.start();
+        // fill the buffer before the first packet
+        buffering = jitter_enabled;
+        lock.unlock();
+        if (buffering)
+            emit bufferingChanged(true);
+    }
+    stop_read = false;
+    read_thread->start();
     int index = 0;
     Packet pkt;
     pause(false);
@@ -261,10 +593,17 @@ void AVDemuxThread::run()
         vqueue->setBlocking(true);
     }
     while (!end) {
+        applyKeyFrameOnly();
+        processNextSeek();
         if (tryPause())
             continue; //the queue is empty and will block
         QMutexLocker locker(&buffer_mutex);
         Q_UNUSED(locker);
+        if (preview_done) {
+            // wait for the next request or the end of scrubbing
+            seek_cond.wait(&buffer_mutex, kSeekInterval);
+            continue;
+        }
         if (end) {
 #if CORRECT_END
             if ((audio_thread && audio_thread->isRunning())
@@ -276,17 +615,42 @@ void AVDemuxThread::run()
 #endif //CORRECT_END
                 break;
         }
-        if (seeking) {
-            qDebug("Demuxer is seeking... wait for seek end");
-            if (!seek_cond.wait(&buffer_mutex, 200)) { //will return the same state(i.e. lock)
-                qWarning("seek timed out");
+        if (!waitForJitterBuffer())
+            continue;
+        if (!takePacket(&pkt, &index, kSeekInterval)) {
+            continue;
+        }
+        // live catch up. resume at a point decodable without the dropped packets
+        if (!pkt.isEnd()) {
+            QMutexLocker lock(&staging_mutex);
+            Q_UNUSED(lock);
+            if (drop_pts >= 0) {
+                const bool resume = vqueue ? index == video_stream && pkt.hasKeyFrame : index == audio_stream;
+                if (!resume || pkt.pts < drop_pts)
+                    continue;
+                qDebug("live catch up: resume at %f", pkt.pts);
+                drop_pts = -1;
             }
         }
-        if (!demuxer->readFrame()) {
+        // trick play. some demuxers ignore AVStream.discard
+        if (key_frame_only && !preview && !pkt.isEnd()) {
+            if (index != video_stream || !pkt.hasKeyFrame)
+                continue;
+            if (last_key_pts >= 0 && qAbs(pkt.pts - last_key_pts) < key_frame_interval)
+                continue;
+            last_key_pts = pkt.pts;
+        }
+        // the packets are played as is, so they are recorded as is
+        if (recorder && !preview && !pkt.isEnd())
+            recorder->writePacket(pkt, index);
+        // key frame only preview when scrubbing
+        if (preview && !pkt.isEnd()) {
+            if (index != video_stream || !pkt.hasKeyFrame || !vqueue)
+                continue;
+            preview_done = true;
+            vqueue->put(pkt);
             continue;
         }
-        index = demuxer->stream();
-        pkt = *demuxer->packet(); //TODO: how to avoid additional copy?
         //connect to stop is ok too
         if (pkt.isEnd()) {
             qDebug("read end packet %d A:%d V:%d", index, audio_stream, video_stream);
@@ -321,7 +685,6 @@ void AVDemuxThread::run()
          * stream data: aaaaaaavvvvvvvaaaaaaaavvvvvvvvvaaaaaa, it happens
          * stream data: aavavvavvavavavavavavavavvvaavavavava, it's ok
          */
-        //TODO: use cache queue, take from cache queue if not empty?
         if (index == audio_stream) {
             /* if vqueue if not blocked and full, and aqueue is empty, then put to
              * vqueue will block demuex thread
@@ -333,14 +696,23 @@ void AVDemuxThread::run()
             }
         } else if (index == video_stream) {
             if (vqueue) {
+                // no audio is queued in trick play
                 if (aqueue)
-                    vqueue->blockFull(aqueue->isEnough());
+                    vqueue->blockFull(key_frame_only || aqueue->isEnough());
                 vqueue->put(pkt); //affect audio_thread
             }
         } else { //subtitle
             continue;
         }
     }
+    {
+        QMutexLocker lock(&staging_mutex);
+        Q_UNUSED(lock);
+        stop_read = true;
+        staging_space_cond.wakeAll();
+    }
+    read_thread->wait();
+    clearStaging();
     //flush. seeking will be omitted when stopped
     if (aqueue)
         aqueue->put(Packet());
@@ -350,13 +722,165 @@ void AVDemuxThread::run()
     qDebug("Demux thread stops running....");
 }
 
+void AVDemuxThread::readPackets()
+{
+    qDebug("demux io thread start running...");
+    while (true) {
+        {
+            QMutexLocker lock(&staging_mutex);
+            Q_UNUSED(lock);
+            // after the end packet, wait for a seek
+            while (!stop_read && (read_end || isStagingFull())) {
+                // reading stops at the ceiling. count once until the buffer is drained
+                if (jitter_enabled && !read_end && !overflowing) {
+                    overflowing = true;
+                    ++overflows;
+                }
+                staging_space_cond.wait(&staging_mutex);
+            }
+            overflowing = false;
+            if (stop_read)
+                break;
+        }
+        QMutexLocker lock(&read_mutex);
+        Q_UNUSED(lock);
+        if (!demuxer->readFrame())
+            continue;
+        StagedPacket staged;
+        staged.stream = demuxer->stream();
+        staged.packet = *demuxer->packet(); //TODO: how to avoid additional copy?
+        QMutexLocker staging_lock(&staging_mutex);
+        Q_UNUSED(staging_lock);
+        read_end = staged.packet.isEnd();
+        if (!read_end && (staged.stream == audio_stream || staged.stream == video_stream))
+            last_pts = staged.packet.pts;
+        if (!read_end)
+            measureJitter(staged.stream, staged.packet.pts);
+        staging_bytes += staged.packet.data.size();
+        staging.enqueue(staged);
+        staging_data_cond.wakeAll();
+    }
+    qDebug("demux io thread stops running....");
+}
+
+bool AVDemuxThread::isStagingFull() const
+{
+    if (staging.isEmpty())
+        return false;
+    if (staging_bytes >= prefetch_bytes)
+        return true;
+    const qreal seconds = jitter_enabled ? qMin(prefetch_seconds, jitter_ceiling) : prefetch_seconds;
+    return stagedDuration() >= seconds;
+}
+
+qreal AVDemuxThread::stagedDuration() const
+{
+    if (staging.isEmpty())
+        return 0;
+    const qreal first = staging.head().packet.pts;
+    const qreal last = staging.last().packet.pts;
+    if (first < 0 || last < first)
+        return 0;
+    return last - first;
+}
+
+/*
+ * transit time of a packet is its arrival time minus pts. a constant network delay does not change
+ * it, so the difference of 2 transits is the jitter of the later one. it's smoothed like the
+ * interarrival jitter of rtp(rfc 3550), and the target depth is a few jitters
+ */
+void AVDemuxThread::measureJitter(int stream, qreal pts)
+{
+    if (!jitter_enabled || stream != jitter_stream || pts < 0)
+        return;
+    const qreal transit = qreal(arrival_timer.elapsed())/1000.0 - pts;
+    if (last_transit > -1e9) {
+        jitter += (qAbs(transit - last_transit) - jitter)*kJitterGain;
+        jitter_target = qBound(jitter_floor, kJitterTargetFactor*jitter, jitter_ceiling);
+    }
+    last_transit = transit;
+}
+
+void AVDemuxThread::updateJitterStatistics()
+{
+    if (!statistics)
+        return;
+    Statistics::JitterBuffer jb;
+    jb.depth = stagedDuration()*1000.0;
+    jb.target = jitter_target*1000.0;
+    jb.jitter = jitter*1000.0;
+    jb.underruns = underruns;
+    jb.overflows = overflows;
+    statistics->setJitterBuffer(jb);
+}
+
+bool AVDemuxThread::waitForJitterBuffer()
+{
+    QMutexLocker lock(&staging_mutex);
+    if (!jitter_enabled)
+        return true;
+    updateJitterStatistics();
+    // bufferingChanged() is emitted after unlock. a slot may lock staging_mutex
+    if (!buffering) {
+        // underrun: nothing to dispatch and the decoder has nothing to decode
+        AVThread *thread = video_thread ? video_thread : audio_thread;
+        if (!staging.isEmpty() || read_end || !thread || !thread->packetQueue()->isEmpty())
+            return true;
+        ++underruns;
+        buffering = true;
+        qDebug("jitter buffer underrun %d. target: %d ms", underruns, int(jitter_target*1000.0));
+        lock.unlock();
+        emit bufferingChanged(true);
+        lock.relock();
+    }
+    if (!end && !read_end && !isStagingFull() && stagedDuration() < jitter_target) {
+        // seek, pause and stop are checked by the caller
+        staging_data_cond.wait(&staging_mutex, kSeekInterval);
+        return false;
+    }
+    buffering = false;
+    lock.unlock();
+    emit bufferingChanged(false);
+    return true;
+}
+
+bool AVDemuxThread::takePacket(Packet *pkt, int *stream, int timeout)
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    if (staging.isEmpty() && !end)
+        staging_data_cond.wait(&staging_mutex, timeout);
+    if (staging.isEmpty())
+        return false;
+    const StagedPacket staged(staging.dequeue());
+    staging_bytes -= staged.packet.data.size();
+    staging_space_cond.wakeAll();
+    *pkt = staged.packet;
+    *stream = staged.stream;
+    return true;
+}
+
+void AVDemuxThread::clearStaging()
+{
+    QMutexLocker lock(&staging_mutex);
+    Q_UNUSED(lock);
+    staging.clear();
+    staging_bytes = 0;
+    read_end = false;
+    last_pts = -1;
+    drop_pts = -1;
+    last_transit = -1e10;
+    staging_space_cond.wakeAll();
+}
+
 bool AVDemuxThread::tryPause()
 {
     if (!paused)
         return false;
     QMutexLocker lock(&buffer_mutex);
     Q_UNUSED(lock);
-    cond.wait(&buffer_mutex);
+    // timeout: a seek request or the end of scrubbing may be missed by wakeAll()
+    cond.wait(&buffer_mutex, kSeekInterval);
     return true;
 }
 
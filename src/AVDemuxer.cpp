@@ -21,15 +21,17 @@
 
 #include <QtAV/AVDemuxer.h>
 #include <QtAV/AVError.h>
+#include <QtAV/KeyFrameIndex.h>
+#include <QtAV/MediaIO.h>
 #include <QtAV/Packet.h>
+#include <QtAV/ProbeCache.h>
 #include <QtAV/QtAV_Compat.h>
+#include <QtCore/QFileInfo>
 #include <QtCore/QThread>
 #include <QtCore/QCoreApplication>
 
 namespace QtAV {
 
-const qint64 kSeekInterval = 168; //ms
-
 class AVDemuxer::InterruptHandler : public AVIOInterruptCB
 {
 public:
@@ -135,6 +137,15 @@ AVDemuxer::AVDemuxer(const QString& fileName, QObject *parent)
     , mSeekUnit(SeekByTime)
     , mSeekTarget(SeekTarget_AnyFrame)
     , mpDict(0)
+    , mIndexEnabled(false)
+    , mIndexCacheDir(KeyFrameIndex::defaultCacheDir())
+    , mpIndexer(0)
+    , mProbeCache(false)
+    , mpDevice(0)
+    , mpIO(0)
+    , mIOBufferSize(32*1024)
+    , mMMap(false)
+    , mLowLatency(false)
 {
     mpInterrup = new InterruptHandler(this);
     if (!_file_name.isEmpty())
@@ -152,6 +163,10 @@ AVDemuxer::~AVDemuxer()
         av_dict_free(&mpDict);
     }
     delete mpInterrup;
+    if (mpIndexer) {
+        delete mpIndexer;
+        mpIndexer = 0;
+    }
 }
 
 bool AVDemuxer::readFrame()
@@ -205,6 +220,9 @@ bool AVDemuxer::readFrame()
     pkt->isCorrupt = !!(packet.flags & AV_PKT_FLAG_CORRUPT);
     pkt->data = QByteArray((const char*)packet.data, packet.size);
     pkt->duration = packet.duration;
+    pkt->position = packet.pos;
+    pkt->stream_pts = packet.pts;
+    pkt->stream_dts = packet.dts;
     //if (packet.dts == AV_NOPTS_VALUE && )
     if (packet.dts != AV_NOPTS_VALUE) //has B-frames
         pkt->pts = packet.dts;
@@ -259,12 +277,19 @@ bool AVDemuxer::close()
     video_streams.clear();
     subtitle_streams.clear();
     mpInterrup->setStatus(0);
+    if (mpIndexer)
+        mpIndexer->cancel();
     //av_close_input_file(format_context); //deprecated
     if (format_context) {
         qDebug("closing format_context");
         avformat_close_input(&format_context); //libavf > 53.10.0
         format_context = 0;
     }
+    // custom io is not closed by avformat_close_input()
+    if (mpIO) {
+        delete mpIO;
+        mpIO = 0;
+    }
     return true;
 }
 
@@ -306,17 +331,7 @@ bool AVDemuxer::seek(qint64 pos)
         qWarning("Invalid seek position %lld %.2f. valid range [0, %lld]", upos, double(upos)/double(durationUs()), durationUs());
         return false;
     }
-    if (seek_timer.isValid()) {
-        //why sometimes seek_timer.elapsed() < 0
-        if (!seek_timer.hasExpired(kSeekInterval)) {
-            qDebug("seek too frequent. ignore");
-            return false;
-        }
-        seek_timer.restart();
-    } else {
-        seek_timer.start();
-    }
-
+    // frequent seeks are coalesced by AVDemuxThread
     QMutexLocker lock(&mutex);
     Q_UNUSED(lock);
 #if 0
@@ -337,7 +352,16 @@ bool AVDemuxer::seek(qint64 pos)
      */
     int seek_flag = (backward ? 0 : AVSEEK_FLAG_BACKWARD); //AVSEEK_FLAG_ANY
     //bool seek_bytes = !!(format_context->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", format_context->iformat->name);
-    int ret = av_seek_frame(format_context, -1, upos, seek_flag);
+    int ret = -1;
+    KeyFrameIndex::Entry key;
+    if (mIndexEnabled && mpIndexer && mpIndexer->isReady() && mpIndexer->index().find(upos, &key)) {
+        qDebug("[AVDemuxer] seek to key frame %lld at %lld bytes, pts: %lld", key.frame, key.position, key.pts);
+        ret = av_seek_frame(format_context, -1, key.position, AVSEEK_FLAG_BYTE);
+        if (ret < 0)
+            qWarning("[AVDemuxer] byte seek error: %s", av_err2str(ret));
+    }
+    if (ret < 0)
+        ret = av_seek_frame(format_context, -1, upos, seek_flag);
     //avformat_seek_file()
 #endif
     if (ret < 0) {
@@ -405,18 +429,59 @@ bool AVDemuxer::loadFile(const QString &fileName)
     if (!format_context)
         format_context = avformat_alloc_context();
     format_context->flags |= AVFMT_FLAG_GENPTS;
+    if (mLowLatency) {
+        // ffplay -probesize 32 -analyzeduration 0 -fflags nobuffer. still enough for most live streams
+        format_context->probesize = 32*1024;
+        format_context->max_analyze_duration = AV_TIME_BASE/2;
+#ifdef AVFMT_FLAG_NOBUFFER
+        format_context->flags |= AVFMT_FLAG_NOBUFFER;
+#endif //AVFMT_FLAG_NOBUFFER
+    }
 
     //install interrupt callback
     format_context->interrupt_callback = *mpInterrup;
 
+    if (mpDevice) {
+        mpIO = new QIODeviceIO(mpDevice, 64*mIOBufferSize);
+        // the interrupt callback is not called in a blocking read of the device
+        mpIO->setTimeout(mpInterrup->getTimeout());
+        if (!mpIO->open(mIOBufferSize)) {
+            AVError err(AVError::OpenError);
+            emit error(err);
+            qWarning("Can't open the io device");
+            return false;
+        }
+        format_context->pb = mpIO->avioContext();
+        format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    } else if (mMMap && QFileInfo(_file_name).isFile()) {
+        mpIO = new MMapIO(_file_name, 64*mIOBufferSize);
+        if (mpIO->open(mIOBufferSize)) {
+            format_context->pb = mpIO->avioContext();
+            format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+        } else {
+            qDebug("mmap error. use the file protocol");
+            delete mpIO;
+            mpIO = 0;
+        }
+    }
+
+    // the result of the previous open. skip the format probing
+    ProbeInfo probe;
+    const bool probe_cached = mProbeCache && ProbeCache::instance().find(_file_name, &probe);
+    AVInputFormat *ifmt = probe_cached ? av_find_input_format(probe.formatName().constData()) : 0;
+
     qDebug("avformat_open_input: format_context:'%p', url:'%s'...",format_context, qPrintable(_file_name));
 
     mpInterrup->begin(InterruptHandler::Open);
-    int ret = avformat_open_input(&format_context, qPrintable(_file_name), NULL, mOptions.isEmpty() ? NULL : &mpDict);
+    int ret = avformat_open_input(&format_context, qPrintable(_file_name), ifmt, mOptions.isEmpty() ? NULL : &mpDict);
     mpInterrup->end();
 
     qDebug("avformat_open_input: url:'%s' ret:%d",qPrintable(_file_name), ret);
 
+    if (ret < 0 && probe_cached && !mpInterrup->getStatus()) {
+        qDebug("open with the cached format error. probe again");
+        return reloadWithoutProbeCache(fileName);
+    }
     if (ret < 0) {
     //if (avformat_open_input(&format_context, qPrintable(filename), NULL, NULL)) {
         AVError err(AVError::OpenError, ret);
@@ -427,24 +492,80 @@ bool AVDemuxer::loadFile(const QString &fileName)
     //deprecated
     //if(av_find_stream_info(format_context)<0) {
     //TODO: avformat_find_stream_info is too slow, only useful for some video format
+    if (probe_cached)
+        probe.apply(format_context);
     mpInterrup->begin(InterruptHandler::FindStreamInfo);
     ret = avformat_find_stream_info(format_context, NULL);
     mpInterrup->end();
+    if (probe_cached && !mpInterrup->getStatus() && (ret < 0 || !probe.matches(format_context))) {
+        qDebug("streams do not match the probe cache. probe again");
+        return reloadWithoutProbeCache(fileName);
+    }
     if (ret < 0) {
         AVError err(AVError::FindStreamInfoError, ret);
         emit error(err);
         qWarning("Can't find stream info: %s", qPrintable(err.string()));
         return false;
     }
+    if (mProbeCache && !probe_cached)
+        ProbeCache::instance().insert(_file_name, format_context);
 
     if (!prepareStreams()) {
         return false;
     }
 
     started_ = false;
+    startKeyFrameIndexer();
     return true;
 }
 
+bool AVDemuxer::moveFrom(AVDemuxer *other)
+{
+    if (!other || other == this || !other->format_context) {
+        qWarning("AVDemuxer::moveFrom: nothing is loaded");
+        return false;
+    }
+    close();
+    {
+        QMutexLocker lock(&other->mutex);
+        Q_UNUSED(lock);
+        format_context = other->format_context;
+        other->format_context = 0;
+        _file_name = other->_file_name;
+        // the custom io used by format_context
+        mpIO = other->mpIO;
+        other->mpIO = 0;
+        mpDevice = other->mpDevice;
+    }
+    other->close();
+    format_context->interrupt_callback = *mpInterrup;
+    if (!prepareStreams())
+        return false;
+    started_ = false;
+    startKeyFrameIndexer();
+    return true;
+}
+
+bool AVDemuxer::reloadWithoutProbeCache(const QString &fileName)
+{
+    ProbeCache::instance().remove(_file_name);
+    close();
+    // avformat_open_input() takes the used options from the dictionary
+    setOptions(mOptions);
+    return loadFile(fileName);
+}
+
+void AVDemuxer::startKeyFrameIndexer()
+{
+    if (!mIndexEnabled || !QFileInfo(_file_name).isFile())
+        return;
+    if (!mpIndexer)
+        mpIndexer = new KeyFrameIndexer();
+    mpIndexer->setFile(_file_name);
+    mpIndexer->setCacheDir(mIndexCacheDir);
+    mpIndexer->start(QThread::LowPriority);
+}
+
 bool AVDemuxer::prepareStreams()
 {
     if (!findStreams())
@@ -543,6 +664,18 @@ bool AVDemuxer::setStream(StreamType st, int stream)
     return true;
 }
 
+void AVDemuxer::discardStreamsExcept(const QList<int> &streams, bool keyFrameOnly)
+{
+    if (!format_context)
+        return;
+    for (unsigned int i = 0; i < format_context->nb_streams; ++i) {
+        AVDiscard discard = AVDISCARD_ALL;
+        if (streams.contains((int)i))
+            discard = keyFrameOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+        format_context->streams[i]->discard = discard;
+    }
+}
+
 AVFormatContext* AVDemuxer::formatContext()
 {
     return format_context;
@@ -885,6 +1018,8 @@ qint64 AVDemuxer::getInterruptTimeout() const
 void AVDemuxer::setInterruptTimeout(qint64 timeout)
 {
     mpInterrup->setTimeout(timeout);
+    if (mpIO)
+        mpIO->setTimeout(timeout);
 }
 
 /**
@@ -902,6 +1037,9 @@ int AVDemuxer::getInterruptStatus() const{
  */
 void AVDemuxer::setInterruptStatus(int interrupt){
     mpInterrup->setStatus(interrupt);
+    // a blocking read of the custom io does not call the interrupt callback
+    if (mpIO)
+        mpIO->setInterrupted(interrupt > 0);
 }
 
 void AVDemuxer::setOptions(const QHash<QByteArray, QByteArray> &dict)
@@ -926,4 +1064,76 @@ QHash<QByteArray, QByteArray> AVDemuxer::options() const
     return mOptions;
 }
 
+void AVDemuxer::setKeyFrameIndexEnabled(bool enabled)
+{
+    mIndexEnabled = enabled;
+    if (!enabled && mpIndexer)
+        mpIndexer->cancel();
+}
+
+bool AVDemuxer::isKeyFrameIndexEnabled() const
+{
+    return mIndexEnabled;
+}
+
+void AVDemuxer::setProbeCacheEnabled(bool enabled)
+{
+    mProbeCache = enabled;
+}
+
+bool AVDemuxer::isProbeCacheEnabled() const
+{
+    return mProbeCache;
+}
+
+void AVDemuxer::setIODevice(QIODevice *device)
+{
+    mpDevice = device;
+}
+
+QIODevice* AVDemuxer::ioDevice() const
+{
+    return mpDevice;
+}
+
+void AVDemuxer::setIOBufferSize(int bytes)
+{
+    mIOBufferSize = qMax(bytes, 4096);
+}
+
+int AVDemuxer::ioBufferSize() const
+{
+    return mIOBufferSize;
+}
+
+void AVDemuxer::setMMapEnabled(bool enabled)
+{
+    mMMap = enabled;
+}
+
+bool AVDemuxer::isMMapEnabled() const
+{
+    return mMMap;
+}
+
+void AVDemuxer::setLowLatency(bool value)
+{
+    mLowLatency = value;
+}
+
+bool AVDemuxer::isLowLatency() const
+{
+    return mLowLatency;
+}
+
+void AVDemuxer::setKeyFrameIndexCacheDir(const QString &dir)
+{
+    mIndexCacheDir = dir;
+}
+
+QString AVDemuxer::keyFrameIndexCacheDir() const
+{
+    return mIndexCacheDir;
+}
+
 } //namespace QtAV
@@ -110,6 +110,9 @@ QString AVError::string() const
     case ResampleError:
         errStr = "Resample error";
         break;
+    case WriteError:
+        errStr = "Write error";
+        break;
     default:
         errStr = "Unknow error";
         break;
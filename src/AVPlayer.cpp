@@ -49,15 +49,29 @@
 #include <QtAV/VideoCapture.h>
 #include <QtAV/AudioOutputTypes.h>
 #include <QtAV/FilterManager.h>
+#include <QtAV/GOPCache.h>
+#include <QtAV/AVPreloader.h>
+#include <QtAV/ImageConverterTypes.h>
+#include <QtAV/StreamRecorder.h>
+#include <QtAV/FrameExporter.h>
+#include <QtAV/FrameSink.h>
 
 namespace QtAV {
 
 static const int kPosistionCheckMS = 500;
 static const qint64 kSeekMS = 10000;
+static const int kFrameCachePollMS = 10;
+// max key frames per second in trick play
+static const qreal kKeyFrameOnlyFPS = 8.0;
+// live mode. latency check interval, playback speed to catch up and the latency to drop packets
+static const int kLatencyCheckMS = 100;
+static const qreal kCatchUpSpeed = 1.25;
+static const qreal kDropLatencyFactor = 4.0;
 
 AVPlayer::AVPlayer(QObject *parent) :
     QObject(parent)
   , loaded(false)
+  , io_device(0)
   , _renderer(0)
   , _audio(0)
   , audio_dec(0)
@@ -65,11 +79,35 @@ AVPlayer::AVPlayer(QObject *parent) :
   , audio_thread(0)
   , video_thread(0)
   , video_capture(0)
+  , stream_recorder(0)
+  , frame_exporter(0)
   , mSpeed(1.0)
   , ao_enable(true)
+  , mLoudnessMeter(false)
   , mBrightness(0)
   , mContrast(0)
   , mSaturation(0)
+  , audio_only(false)
+  , cache_conv(0)
+  , cache_pts(-1)
+  , cache_steps(0)
+  , cache_timer_id(-1)
+  , cache_limit(256)
+  , reverse(false)
+  , key_frame_only_speed(4.0)
+  , key_frame_only(false)
+  , key_frame_only_clock(AVClock::AudioClock)
+  , live_mode(false)
+  , latency_target(300)
+  , live_timer_id(-1)
+  , catch_up_speed(1.0)
+  , next_loader(0)
+  , async_loader(0)
+  , loading(false)
+  , play_after_load(false)
+  , async_loaded(false)
+  , preloaded_audio_dec(0)
+  , preloaded_video_dec(0)
 {
     formatCtx = 0;
     last_position = 0;
@@ -92,17 +130,27 @@ AVPlayer::AVPlayer(QObject *parent) :
      * If close the _renderer widget, the the _renderer may destroy before waking up.
      */
     connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(aboutToQuitApp()));
+    // frameSinkUninstalled() is emitted from the video thread
+    qRegisterMetaType<QtAV::FrameSink*>("QtAV::FrameSink*");
     clock = new AVClock(AVClock::AudioClock);
     //clock->setClockType(AVClock::ExternalClock);
     connect(&demuxer, SIGNAL(started()), clock, SLOT(start()));
     connect(&demuxer, SIGNAL(error(QtAV::AVError)), this, SIGNAL(error(QtAV::AVError)));
+    demuxer.setSeekTarget(AVDemuxer::SeekTarget_KeyFrame);
 
     demuxer_thread = new AVDemuxThread(this);
     demuxer_thread->setDemuxer(&demuxer);
     //use direct connection otherwise replay may stop immediatly because slot stop() is called after play()
     connect(demuxer_thread, SIGNAL(finished()), this, SLOT(stopFromDemuxerThread()), Qt::DirectConnection);
+    demuxer_thread->setStatistics(&mStatistics);
+    connect(demuxer_thread, SIGNAL(bufferingChanged(bool)), this, SLOT(onBufferingChanged(bool)));
 
     video_capture = new VideoCapture(this);
+    stream_recorder = new StreamRecorder(this);
+    demuxer_thread->setRecorder(stream_recorder);
+    frame_exporter = new FrameExporter(this);
+    gop_cache = new GOPCache();
+    gop_cache->setMemoryLimit(qint64(cache_limit)*1024LL*1024LL);
 
     vcodec_ids
 #if QTAV_HAVE(DXVA)
@@ -120,6 +168,17 @@ AVPlayer::AVPlayer(QObject *parent) :
 AVPlayer::~AVPlayer()
 {
     stop();
+    discardPreloader(next_loader);
+    discardPreloader(async_loader);
+    if (gop_cache) {
+        gop_cache->cancel();
+        delete gop_cache;
+        gop_cache = 0;
+    }
+    if (cache_conv) {
+        delete cache_conv;
+        cache_conv = 0;
+    }
     if (_audio) {
         delete _audio;
         _audio = 0;
@@ -154,6 +213,14 @@ AVPlayer::~AVPlayer()
         delete demuxer_thread;
         demuxer_thread = 0;
     }
+    if (stream_recorder) {
+        delete stream_recorder;
+        stream_recorder = 0;
+    }
+    if (frame_exporter) {
+        delete frame_exporter;
+        frame_exporter = 0;
+    }
 }
 
 AVClock* AVPlayer::masterClock()
@@ -310,13 +377,120 @@ void AVPlayer::setSpeed(qreal speed)
     if (speed == mSpeed)
         return;
     mSpeed = speed;
+    applySpeed();
+    updateKeyFrameOnly();
+    emit speedChanged(mSpeed);
+}
+
+void AVPlayer::applySpeed()
+{
+    const qreal s = mSpeed*catch_up_speed;
     //TODO: check clock type?
     if (_audio && _audio->isAvailable()) {
-        qDebug("set speed %.2f", mSpeed);
-        _audio->setSpeed(mSpeed);
+        qDebug("set speed %.2f", s);
+        _audio->setSpeed(s);
     }
-    masterClock()->setSpeed(mSpeed);
-    emit speedChanged(mSpeed);
+    masterClock()->setSpeed(s);
+}
+
+void AVPlayer::setLiveMode(bool value)
+{
+    live_mode = value;
+    demuxer.setLowLatency(value);
+}
+
+bool AVPlayer::isLiveMode() const
+{
+    return live_mode;
+}
+
+void AVPlayer::setLatencyTarget(int ms)
+{
+    latency_target = qMax(ms, 1);
+}
+
+int AVPlayer::latencyTarget() const
+{
+    return latency_target;
+}
+
+int AVPlayer::latency() const
+{
+    const qreal last = demuxer_thread->lastPts();
+    if (!isPlaying() || last < 0)
+        return -1;
+    return qMax<int>(0, (last - clock->value())*1000.0);
+}
+
+void AVPlayer::checkLatency()
+{
+    if (isPaused() || key_frame_only)
+        return;
+    const int ms = latency();
+    if (ms < 0)
+        return;
+    if (ms > kDropLatencyFactor*latency_target) {
+        // far behind, e.g. after a network stall. speeding up takes too long
+        const qreal pts = demuxer_thread->lastPts() - qreal(latency_target)/1000.0;
+        qDebug("live latency %d ms. drop packets to %f", ms, pts);
+        demuxer_thread->dropTo(pts);
+        // audio clock is updated by the audio thread
+        if (clock->clockType() == AVClock::ExternalClock)
+            clock->updateExternalClock(qint64(pts*1000.0));
+        return;
+    }
+    // hysteresis. do not switch the speed for every check
+    qreal s = catch_up_speed;
+    if (ms > latency_target)
+        s = kCatchUpSpeed;
+    else if (ms < latency_target/2)
+        s = 1.0;
+    if (s == catch_up_speed)
+        return;
+    qDebug("live latency %d ms. catch up speed: %.2f", ms, s);
+    catch_up_speed = s;
+    applySpeed();
+}
+
+void AVPlayer::setKeyFrameOnlySpeed(qreal speed)
+{
+    key_frame_only_speed = speed;
+    updateKeyFrameOnly();
+}
+
+qreal AVPlayer::keyFrameOnlySpeed() const
+{
+    return key_frame_only_speed;
+}
+
+void AVPlayer::updateKeyFrameOnly()
+{
+    const bool only = isPlaying() && demuxer.videoCodecContext()
+            && key_frame_only_speed > 0 && mSpeed >= key_frame_only_speed;
+    if (only == key_frame_only) {
+        if (only)
+            demuxer_thread->setKeyFrameOnly(true, mSpeed/kKeyFrameOnlyFPS);
+        return;
+    }
+    key_frame_only = only;
+    const qint64 pos = position();
+    if (only) {
+        qDebug("key frame only at speed %.2f", mSpeed);
+        // no audio to drive the clock
+        key_frame_only_clock = clock->clockType();
+        clock->setClockType(AVClock::ExternalClock);
+        clock->updateExternalClock(pos);
+        clock->pause(isPaused());
+        demuxer_thread->setKeyFrameOnly(true, mSpeed/kKeyFrameOnlyFPS);
+        return;
+    }
+    qDebug("leave key frame only at speed %.2f", mSpeed);
+    demuxer_thread->setKeyFrameOnly(false);
+    clock->setClockType(key_frame_only_clock);
+    clock->updateValue(double(pos)/1000.0);
+    // audio is not queued and the decoder has no reference frames. start from the key frame again
+    if (isPlaying())
+        setPosition(pos);
 }
 
 qreal AVPlayer::speed() const
@@ -324,6 +498,128 @@ qreal AVPlayer::speed() const
     return mSpeed;
 }
 
+void AVPlayer::setLoudnessMeterEnabled(bool enabled)
+{
+    mLoudnessMeter = enabled;
+    if (audio_thread)
+        audio_thread->setLoudnessMeterEnabled(enabled);
+}
+
+bool AVPlayer::isLoudnessMeterEnabled() const
+{
+    return mLoudnessMeter;
+}
+
+void AVPlayer::setKeyFrameIndexEnabled(bool enabled)
+{
+    demuxer.setKeyFrameIndexEnabled(enabled);
+}
+
+bool AVPlayer::isKeyFrameIndexEnabled() const
+{
+    return demuxer.isKeyFrameIndexEnabled();
+}
+
+void AVPlayer::setProbeCacheEnabled(bool enabled)
+{
+    demuxer.setProbeCacheEnabled(enabled);
+}
+
+bool AVPlayer::isProbeCacheEnabled() const
+{
+    return demuxer.isProbeCacheEnabled();
+}
+
+void AVPlayer::setMMapEnabled(bool enabled)
+{
+    demuxer.setMMapEnabled(enabled);
+}
+
+bool AVPlayer::isMMapEnabled() const
+{
+    return demuxer.isMMapEnabled();
+}
+
+void AVPlayer::setPrefetchLimit(qint64 bytes, qreal seconds)
+{
+    demuxer_thread->setPrefetchLimit(bytes, seconds);
+}
+
+qint64 AVPlayer::prefetchBytes() const
+{
+    return demuxer_thread->prefetchBytes();
+}
+
+qreal AVPlayer::prefetchDuration() const
+{
+    return demuxer_thread->prefetchDuration();
+}
+
+void AVPlayer::setJitterBufferEnabled(bool enabled)
+{
+    demuxer_thread->setJitterBufferEnabled(enabled);
+}
+
+bool AVPlayer::isJitterBufferEnabled() const
+{
+    return demuxer_thread->isJitterBufferEnabled();
+}
+
+void AVPlayer::setJitterBufferRange(int floorMs, int ceilingMs)
+{
+    demuxer_thread->setJitterBufferRange(floorMs, ceilingMs);
+}
+
+void AVPlayer::onBufferingChanged(bool buffering)
+{
+    // audio clock stops with the audio. external clock must wait for the buffer
+    if (clock->clockType() == AVClock::ExternalClock && !isPaused())
+        clock->pause(buffering);
+    emit bufferingChanged(buffering);
+}
+
+void AVPlayer::setAccurateSeek(bool accurate)
+{
+    demuxer.setSeekTarget(accurate ? AVDemuxer::SeekTarget_AnyFrame : AVDemuxer::SeekTarget_KeyFrame);
+}
+
+bool AVPlayer::isAccurateSeek() const
+{
+    return demuxer.seekTarget() == AVDemuxer::SeekTarget_AnyFrame;
+}
+
+void AVPlayer::setReversePlayback(bool r)
+{
+    if (!r) {
+        reverse = false;
+        return;
+    }
+    if (!enterFrameCache())
+        return;
+    reverse = true;
+    cache_steps = 0;
+    qreal fps = demuxer.frameRate();
+    if (fps <= 0)
+        fps = 25;
+    startFrameCacheTimer(qMax<int>(kFrameCachePollMS, 1000.0/(fps*mSpeed)));
+}
+
+bool AVPlayer::isReversePlayback() const
+{
+    return reverse;
+}
+
+void AVPlayer::setFrameCacheLimit(int mb)
+{
+    cache_limit = mb;
+    gop_cache->setMemoryLimit(qint64(mb)*1024LL*1024LL);
+}
+
+int AVPlayer::frameCacheLimit() const
+{
+    return cache_limit;
+}
+
 Statistics& AVPlayer::statistics()
 {
     return mStatistics;
@@ -395,6 +691,53 @@ bool AVPlayer::uninstallFilter(Filter *filter)
     return true;
 }
 
+bool AVPlayer::installFrameSink(FrameSink *sink)
+{
+    if (!sink || frame_sinks.contains(sink))
+        return false;
+    frame_sinks.append(sink);
+    if (video_thread)
+        video_thread->installFrameSink(sink);
+    return true;
+}
+
+bool AVPlayer::uninstallFrameSink(FrameSink *sink)
+{
+    if (!frame_sinks.removeOne(sink))
+        return false;
+    if (!video_thread) {
+        emit frameSinkUninstalled(sink);
+        return true;
+    }
+    class UninstallSinkTask : public QRunnable {
+    public:
+        UninstallSinkTask(AVPlayer *player, VideoThread *thread, FrameSink *sink):
+            QRunnable()
+          , mpPlayer(player)
+          , mpThread(thread)
+          , mpSink(sink)
+        {
+            setAutoDelete(true);
+        }
+        virtual void run() {
+            mpThread->uninstallFrameSink(mpSink);
+            QMetaObject::invokeMethod(mpPlayer, "frameSinkUninstalled", Qt::QueuedConnection, Q_ARG(QtAV::FrameSink*, mpSink));
+        }
+    private:
+        AVPlayer *mpPlayer;
+        VideoThread *mpThread;
+        FrameSink *mpSink;
+    };
+    // the video thread may be putting a frame in the sink
+    if (video_thread->isRunning()) {
+        video_thread->scheduleTask(new UninstallSinkTask(this, video_thread, sink));
+    } else {
+        video_thread->uninstallFrameSink(sink);
+        emit frameSinkUninstalled(sink);
+    }
+    return true;
+}
+
 void AVPlayer::setPriority(const QVector<VideoDecoderId> &ids)
 {
     vcodec_ids = ids;
@@ -441,6 +784,14 @@ void AVPlayer::setFile(const QString &path)
     demuxer.setAutoResetStream(reset_state);
     this->path = path;
     loaded = false; //
+    async_loaded = false;
+    io_device = 0;
+    // superseded
+    if (async_loader && async_loader->file() != path) {
+        discardPreloader(async_loader);
+        play_after_load = false;
+        setLoading(false);
+    }
     //qApp->activeWindow()->setWindowTitle(path); //crash on linux
 }
 
@@ -449,11 +800,52 @@ QString AVPlayer::file() const
     return path;
 }
 
+void AVPlayer::setIODevice(QIODevice *device)
+{
+    // a unique name. the player is reloaded if the device changes
+    setFile(device ? QString("QIODevice:%1").arg(quintptr(device)) : QString());
+    io_device = device;
+}
+
+QIODevice* AVPlayer::ioDevice() const
+{
+    return io_device;
+}
+
 VideoCapture* AVPlayer::videoCapture()
 {
     return video_capture;
 }
 
+bool AVPlayer::startRecording(const QString &fileName, const QString &format)
+{
+    if (!isPlaying()) {
+        qWarning("AVPlayer: can not record. not playing");
+        return false;
+    }
+    return stream_recorder->start(&demuxer, fileName, format);
+}
+
+void AVPlayer::stopRecording()
+{
+    stream_recorder->stop();
+}
+
+bool AVPlayer::isRecording() const
+{
+    return stream_recorder->isRecording();
+}
+
+StreamRecorder* AVPlayer::recorder()
+{
+    return stream_recorder;
+}
+
+FrameExporter* AVPlayer::frameExporter()
+{
+    return frame_exporter;
+}
+
 bool AVPlayer::captureVideo()
 {
     if (!video_capture || !video_thread)
@@ -490,6 +882,8 @@ void AVPlayer::togglePause()
 
 void AVPlayer::pause(bool p)
 {
+    if (!p)
+        leaveFrameCache(true);
     //pause thread. check pause state?
     demuxer_thread->pause(p);
     if (audio_thread)
@@ -518,6 +912,125 @@ bool AVPlayer::load(const QString &path, bool reload)
     return load(reload);
 }
 
+void AVPlayer::setNextFile(const QString &path)
+{
+    if (path == next_file)
+        return;
+    next_file = path;
+    discardPreloader(next_loader);
+    if (next_file.isEmpty())
+        return;
+    next_loader = createPreloader(next_file);
+    next_loader->start(QThread::LowPriority);
+}
+
+QString AVPlayer::nextFile() const
+{
+    return next_file;
+}
+
+AVPreloader* AVPlayer::createPreloader(const QString &path)
+{
+    AVPreloader *loader = new AVPreloader(path);
+    loader->setFormatOptions(demuxer.options());
+    loader->demuxer()->setIODevice(path == this->path ? io_device : 0);
+    loader->demuxer()->setProbeCacheEnabled(demuxer.isProbeCacheEnabled());
+    loader->demuxer()->setMMapEnabled(demuxer.isMMapEnabled());
+    // smaller probesize and analyzeduration, low delay decoder
+    loader->demuxer()->setLowLatency(demuxer.isLowLatency());
+    loader->setAudioCodecOptions(audio_codec_opt);
+    loader->setVideoCodecOptions(video_codec_opt);
+    loader->setVideoDecoders(vcodec_ids);
+    return loader;
+}
+
+void AVPlayer::discardPreloader(AVPreloader *&loader)
+{
+    if (!loader)
+        return;
+    loader->disconnect(this);
+    loader->cancel();
+    // the thread may block in io. do not wait
+    connect(loader, SIGNAL(finished()), loader, SLOT(deleteLater()));
+    if (!loader->isRunning())
+        loader->deleteLater();
+    loader = 0;
+}
+
+void AVPlayer::loadAsync(const QString &path)
+{
+    setFile(path);
+    loadAsync();
+}
+
+void AVPlayer::loadAsync()
+{
+    if (path.isEmpty()) {
+        qDebug("No file to load...");
+        return;
+    }
+    discardPreloader(async_loader);
+    play_after_load = false;
+    async_loaded = false;
+    async_loader = createPreloader(path);
+    connect(async_loader, SIGNAL(finished()), this, SLOT(onAsyncLoadFinished()));
+    setLoading(true);
+    async_loader->start();
+}
+
+bool AVPlayer::isLoading() const
+{
+    return loading;
+}
+
+void AVPlayer::setLoading(bool value)
+{
+    if (loading == value)
+        return;
+    loading = value;
+    emit loadingChanged(loading);
+}
+
+void AVPlayer::onAsyncLoadFinished()
+{
+    if (!async_loader || sender() != async_loader)
+        return;
+    if (!async_loader->isReady()) {
+        const AVError e(async_loader->error());
+        discardPreloader(async_loader);
+        play_after_load = false;
+        setLoading(false);
+        qWarning("async load error: %s", qPrintable(e.string()));
+        emit error(e);
+        return;
+    }
+    const bool play_now = play_after_load;
+    play_after_load = false;
+    // if playing, the next play() uses the loader
+    if (!isPlaying()) {
+        // fast. the input and decoders are ready
+        if (!load(true)) { // error() is emitted by the demuxer
+            setLoading(false);
+            return;
+        }
+        async_loaded = true;
+    }
+    setLoading(false);
+    emit loaded();
+    if (play_now)
+        play();
+}
+
+void AVPlayer::playNextFile()
+{
+    if (next_file.isEmpty() || isPlaying())
+        return;
+    qDebug("play the next file %s", qPrintable(next_file));
+    const QString file(next_file);
+    next_file.clear();
+    play(file); //the preloader is used in load()
+}
+
 bool AVPlayer::load(bool reload)
 {
     loaded = false;
@@ -525,6 +1038,18 @@ bool AVPlayer::load(bool reload)
         qDebug("No file to load...");
         return false;
     }
+    // the file loaded in a thread by loadAsync() or setNextFile()
+    AVPreloader **loader = 0;
+    if (async_loader && async_loader->file() == path && async_loader->isFinished()) {
+        loader = &async_loader;
+    } else if (next_loader && next_loader->file() == path) {
+        // it's started earlier, so waiting is faster than loading again
+        next_loader->wait();
+        loader = &next_loader;
+        if (next_file == path)
+            next_file.clear();
+    }
+    AVPreloader *preloader = loader && (*loader)->isReady() ? *loader : 0;
     // release codec ctx
     if (audio_dec) {
         audio_dec->setCodecContext(0);
@@ -533,6 +1058,7 @@ bool AVPlayer::load(bool reload)
         video_dec->setCodecContext(0);
     }
     qDebug("loading: %s ...", path.toUtf8().constData());
+    demuxer.setIODevice(io_device);
     if (reload || !demuxer.isLoaded(path)) {
         //close decoders here to make sure open and close in the same thread
         if (audio_dec && audio_dec->isOpen()) {
@@ -541,12 +1067,20 @@ bool AVPlayer::load(bool reload)
         if (video_dec && video_dec->isOpen()) {
             video_dec->close();
         }
-        if (!demuxer.loadFile(path)) {
+        if (preloader && demuxer.moveFrom(preloader->demuxer())) {
+            qDebug("use the preloaded file");
+            preloaded_audio_dec = preloader->takeAudioDecoder();
+            preloaded_video_dec = preloader->takeVideoDecoder();
+        } else if (!demuxer.loadFile(path)) {
+            if (loader)
+                discardPreloader(*loader);
             return false;
         }
     } else {
         demuxer.prepareStreams();
     }
+    if (loader)
+        discardPreloader(*loader);
     loaded = true;
     formatCtx = demuxer.formatContext();
 
@@ -562,7 +1096,7 @@ bool AVPlayer::load(bool reload)
     }
 
     // TODO: what about other proctols? some vob duration() == 0
-    if (path.startsWith("file:") || QFile(path).exists() && duration() > 0) {
+    if (path.startsWith("file:") || (QFile(path).exists() || io_device) && duration() > 0) {
         media_end_pos = duration();
     } else {
         media_end_pos = std::numeric_limits<qint64>::max();
@@ -580,13 +1114,30 @@ bool AVPlayer::load(bool reload)
             audio_thread = 0;//shared ptr?
         }
     }
-    if (!setupVideoThread()) {
+    // the demux thread discards the stream without video thread
+    if ((audio_only && audio_thread) || !setupVideoThread()) {
         demuxer_thread->setVideoThread(0); //set 0 before delete. ptr is used in demux thread when set 0
         if (video_thread) {
             qDebug("release video thread.");
             delete video_thread;
             video_thread = 0;//shared ptr?
         }
+        if (audio_only && video_dec) {
+            video_dec->close();
+            delete video_dec;
+            video_dec = 0;
+        }
+    }
+    // not used, e.g. the stream to play is not the default one
+    if (preloaded_audio_dec) {
+        preloaded_audio_dec->close();
+        delete preloaded_audio_dec;
+        preloaded_audio_dec = 0;
+    }
+    if (preloaded_video_dec) {
+        preloaded_video_dec->close();
+        delete preloaded_video_dec;
+        preloaded_video_dec = 0;
     }
     if (!audio_thread && !video_thread) {
         qWarning("load failed");
@@ -688,6 +1239,7 @@ void AVPlayer::setPosition(qint64 position)
     if (position < 0)
         position += mediaStopPosition();
     qDebug("seek to %lld ms (%f%%)", position, double(position)/double(duration())*100.0);
+    leaveFrameCache(false);
     masterClock()->updateValue(double(position)/1000.0); //what is duration == 0
     masterClock()->updateExternalClock(position); //in msec. ignore usec part using t/1000
     demuxer_thread->seek(position);
@@ -745,6 +1297,27 @@ bool AVPlayer::setVideoStream(int n, bool now)
     return isPlaying();
 }
 
+void AVPlayer::setAudioOnly(bool value)
+{
+    if (audio_only == value)
+        return;
+    audio_only = value;
+    // the threads are set up for the old mode by load() and loadAsync(). reload at the next play()
+    loaded = false;
+    async_loaded = false;
+    if (!isPlaying())
+        return;
+    // reload and play at the current position
+    last_position = -1;
+    demuxer.setAutoResetStream(false);
+    play();
+}
+
+bool AVPlayer::isAudioOnly() const
+{
+    return audio_only;
+}
+
 bool AVPlayer::setSubtitleStream(int n, bool now)
 {
     demuxer.setAutoResetStream(false);
@@ -784,6 +1357,10 @@ int AVPlayer::subtitleStreamCount() const
 //FIXME: why no demuxer will not get an eof if replaying by seek(0)?
 void AVPlayer::play()
 {
+    if (async_loader && async_loader->file() == path && async_loader->isRunning()) {
+        play_after_load = true;
+        return;
+    }
     //FIXME: bad delay after play from here
     bool start_last = last_position == -1;
     if (isPlaying()) {
@@ -825,10 +1402,12 @@ void AVPlayer::play()
         qDebug("seek(%f)", last_position);
         demuxer.seek(last_position); //FIXME: now assume it is seekable. for unseekable, setFile() again
 #else
-        if (!load(true)) {
+        // loaded by loadAsync() and not played
+        if (!async_loaded && !load(true)) {
             mStatistics.reset();
             return;
         }
+        async_loaded = false;
         initStatistics();
 
 #endif //EOF_ISSUE_SOLVED
@@ -860,6 +1439,7 @@ void AVPlayer::play()
         last_position = mediaStartPosition();
     if (last_position > 0)
         seek(last_position); //just use demuxer.startTime()/duration()?
+    updateKeyFrameOnly();
 
     emit started(); //we called stop(), so must emit started()
 }
@@ -867,8 +1447,15 @@ void AVPlayer::play()
 void AVPlayer::stopFromDemuxerThread()
 {
     reset_state = false;
+    // the next file has other streams
+    stream_recorder->stop();
+    // the video thread is finished. write the manifest
+    frame_exporter->stop();
     qDebug("demuxer thread emit finished. avplayer emit stopped()");
     emit stopped();
+    // called in demux thread
+    if (demuxer.atEnd() && !next_file.isEmpty())
+        QMetaObject::invokeMethod(this, "playNextFile", Qt::QueuedConnection);
 }
 
 void AVPlayer::aboutToQuitApp()
@@ -886,6 +1473,9 @@ void AVPlayer::aboutToQuitApp()
 void AVPlayer::startNotifyTimer()
 {
     timer_id = startTimer(kPosistionCheckMS);
+    // stopped by itself when not playing
+    if (live_mode && live_timer_id < 0)
+        live_timer_id = startTimer(kLatencyCheckMS);
 }
 
 void AVPlayer::stopNotifyTimer()
@@ -895,6 +1485,14 @@ void AVPlayer::stopNotifyTimer()
 
 void AVPlayer::stop()
 {
+    leaveFrameCache(false);
+    gop_cache->cancel();
+    gop_cache->clear();
+    if (key_frame_only) {
+        key_frame_only = false;
+        demuxer_thread->setKeyFrameOnly(false);
+        clock->setClockType(key_frame_only_clock);
+    }
     // check timer_id, <0 return?
     if (reset_state) {
         /*
@@ -958,6 +1556,23 @@ void AVPlayer::stop()
 
 void AVPlayer::timerEvent(QTimerEvent *te)
 {
+    if (te->timerId() == cache_timer_id) {
+        presentCachedFrame();
+        return;
+    }
+    if (te->timerId() == live_timer_id) {
+        if (!isPlaying() || !live_mode) {
+            killTimer(live_timer_id);
+            live_timer_id = -1;
+            if (catch_up_speed != 1.0) {
+                catch_up_speed = 1.0;
+                applySpeed();
+            }
+            return;
+        }
+        checkLatency();
+        return;
+    }
     if (te->timerId() == timer_id) {
         if (stopPosition() == std::numeric_limits<qint64>::max()) {
             // not seekable. network stream
@@ -1005,6 +1620,12 @@ void AVPlayer::timerEvent(QTimerEvent *te)
 //FIXME: If not playing, it will just play but not play one frame.
 void AVPlayer::playNextFrame()
 {
+    if (cache_pts >= 0) {
+        reverse = false;
+        cache_steps++;
+        startFrameCacheTimer(kFrameCachePollMS);
+        return;
+    }
     if (!isPlaying()) {
         play();
     }
@@ -1018,6 +1639,95 @@ void AVPlayer::playNextFrame()
     demuxer_thread->pause(true);
 }
 
+void AVPlayer::playPreviousFrame()
+{
+    if (!enterFrameCache())
+        return;
+    reverse = false;
+    cache_steps--;
+    startFrameCacheTimer(kFrameCachePollMS);
+}
+
+bool AVPlayer::enterFrameCache()
+{
+    if (cache_pts >= 0)
+        return true;
+    if (!isPlaying() || !demuxer.videoCodecContext()) {
+        qWarning("no video is playing. can not use the frame cache");
+        return false;
+    }
+    if (!isPaused())
+        pause(true);
+    if (gop_cache->file() != path || !gop_cache->isRunning()) {
+        gop_cache->setFile(path);
+        gop_cache->start();
+    }
+    cache_pts = clock->videoPts();
+    cache_steps = 0;
+    return true;
+}
+
+void AVPlayer::leaveFrameCache(bool seek)
+{
+    if (cache_timer_id >= 0) {
+        killTimer(cache_timer_id);
+        cache_timer_id = -1;
+    }
+    reverse = false;
+    cache_steps = 0;
+    if (cache_pts < 0)
+        return;
+    const qint64 pos = cache_pts*1000.0;
+    cache_pts = -1;
+    // present the frame at pos and keep paused. see AVDemuxThread::seek()
+    if (seek)
+        setPosition(pos);
+}
+
+void AVPlayer::startFrameCacheTimer(int ms)
+{
+    if (cache_timer_id >= 0)
+        killTimer(cache_timer_id);
+    cache_timer_id = startTimer(ms);
+}
+
+void AVPlayer::presentCachedFrame()
+{
+    if (cache_pts < 0 || (!reverse && cache_steps == 0)) {
+        killTimer(cache_timer_id);
+        cache_timer_id = -1;
+        return;
+    }
+    const bool backward = reverse || cache_steps < 0;
+    VideoFrame frame;
+    qreal pts = 0;
+    if (backward ? !gop_cache->frameBefore(cache_pts, &frame, &pts) : !gop_cache->frameAfter(cache_pts, &frame, &pts)) {
+        // not decoded yet, or no more frames
+        if (backward && cache_pts*1000.0 <= mediaStartPosition()) {
+            reverse = false;
+            cache_steps = 0;
+        }
+        return;
+    }
+    if (!reverse)
+        cache_steps += backward ? 1 : -1;
+    cache_pts = pts;
+    if (!cache_conv)
+        cache_conv = ImageConverterFactory::create(ImageConverterId_FF);
+    // the cached frame is shared. convert a copy
+    frame = frame.clone();
+    cache_conv->setInFormat(frame.pixelFormatFFmpeg());
+    cache_conv->setInSize(frame.width(), frame.height());
+    cache_conv->setOutSize(frame.width(), frame.height());
+    frame.setImageConverter(cache_conv);
+    frame.convertTo(VideoFormat::Format_RGB32);
+    mpVOSet->sendVideoFrame(frame);
+    clock->updateValue(pts);
+    clock->updateExternalClock(pts*1000.0);
+    clock->updateVideoPts(pts);
+    emit positionChanged(pts*1000.0);
+}
+
 void AVPlayer::seek(qreal r)
 {
     seek(qint64(r*double(duration())));
@@ -1170,13 +1880,21 @@ bool AVPlayer::setupAudioThread()
         return false;
     }
     qDebug("has audio");
-    if (!audio_dec) {
-        audio_dec = new AudioDecoder();
-    }
-    audio_dec->setCodecContext(aCodecCtx);
-    audio_dec->setOptions(audio_codec_opt);
-    if (!audio_dec->open()) {
-        return false;
+    if (preloaded_audio_dec && preloaded_audio_dec->codecContext() == aCodecCtx) {
+        // already opened
+        if (audio_dec)
+            delete audio_dec;
+        audio_dec = preloaded_audio_dec;
+        preloaded_audio_dec = 0;
+    } else {
+        if (!audio_dec) {
+            audio_dec = new AudioDecoder();
+        }
+        audio_dec->setCodecContext(aCodecCtx);
+        audio_dec->setOptions(audio_codec_opt);
+        if (!audio_dec->open()) {
+            return false;
+        }
     }
     //TODO: setAudioOutput() like vo
     if (!_audio && ao_enable) {
@@ -1193,16 +1911,23 @@ bool AVPlayer::setupAudioThread()
         //masterClock()->setClockType(AVClock::ExternalClock);
         //return;
     } else {
-        _audio->audioFormat().setSampleFormat(AudioFormat::SampleFormat_Float);
-        _audio->audioFormat().setSampleRate(aCodecCtx->sample_rate);
+        AudioFormat af(_audio->audioFormat());
+        af.setSampleFormat(AudioFormat::SampleFormat_Float);
+        af.setSampleRate(aCodecCtx->sample_rate);
         // 5, 6, 7 may not play
         if (aCodecCtx->channels > 2)
-            _audio->audioFormat().setChannelLayoutFFmpeg(AV_CH_LAYOUT_STEREO);
+            af.setChannelLayoutFFmpeg(AV_CH_LAYOUT_STEREO);
         else
-            _audio->audioFormat().setChannels(aCodecCtx->channels);
+            af.setChannels(aCodecCtx->channels);
         //_audio->audioFormat().setChannels(aCodecCtx->channels);
-        if (!_audio->open()) {
-            //return; //audio not ready
+        // no gap between files of the same format
+        if (!_audio->isAvailable() || af != _audio->audioFormat()) {
+            if (_audio->isAvailable())
+                _audio->close();
+            _audio->setAudioFormat(af);
+            if (!_audio->open()) {
+                //return; //audio not ready
+            }
         }
     }
     if (_audio)
@@ -1216,9 +1941,9 @@ bool AVPlayer::setupAudioThread()
         qDebug("new audio thread");
         audio_thread = new AudioThread(this);
         audio_thread->setClock(clock);
-        audio_thread->setDecoder(audio_dec);
         audio_thread->setStatistics(&mStatistics);
         audio_thread->setOutputSet(mpAOSet);
+        audio_thread->setLoudnessMeterEnabled(mLoudnessMeter);
         qDebug("demux thread setAudioThread");
         demuxer_thread->setAudioThread(audio_thread);
         //reconnect if disconnected
@@ -1230,9 +1955,15 @@ bool AVPlayer::setupAudioThread()
             }
         }
     }
+    audio_thread->setDecoder(audio_dec); //may be a preloaded one
     setAudioOutput(_audio);
     int queue_min = 0.61803*qMax<qreal>(24.0, mStatistics.video_only.fps_guess);
     int queue_max = int(1.61803*(qreal)queue_min); //about 1 second
+    if (live_mode) {
+        // about latencyTarget()
+        queue_min = 1;
+        queue_max = qMax<int>(4, qMax<qreal>(24.0, mStatistics.video_only.fps_guess)*latency_target/1000);
+    }
     audio_thread->packetQueue()->setThreshold(queue_min);
     audio_thread->packetQueue()->setCapacity(queue_max);
     return true;
@@ -1253,13 +1984,24 @@ bool AVPlayer::setupVideoThread()
         delete video_dec;
         video_dec = 0;
     }
+    // preloaded before live mode is enabled: the decoder may delay frames
+    if (preloaded_video_dec && preloaded_video_dec->codecContext() == vCodecCtx
+            && (!live_mode || (vCodecCtx->flags & CODEC_FLAG_LOW_DELAY))) {
+        video_dec = preloaded_video_dec;
+        preloaded_video_dec = 0;
+    }
     foreach(VideoDecoderId vid, vcodec_ids) {
+        if (video_dec)
+            break;
         qDebug("**********trying video decoder: %s...", VideoDecoderFactory::name(vid).c_str());
         VideoDecoder *vd = VideoDecoderFactory::create(vid);
         if (!vd) {
             continue;
         }
         //vd->isAvailable() //TODO: the value is wrong now
+        // output a frame as soon as decoded
+        if (live_mode)
+            vCodecCtx->flags |= CODEC_FLAG_LOW_DELAY;
         vd->setCodecContext(vCodecCtx);
         vd->setOptions(video_codec_opt);
         if (vd->prepare() && vd->open()) {
@@ -1279,8 +2021,13 @@ bool AVPlayer::setupVideoThread()
         video_thread->setClock(clock);
         video_thread->setStatistics(&mStatistics);
         video_thread->setVideoCapture(video_capture);
+        video_thread->setFrameExporter(frame_exporter);
+        foreach (FrameSink *sink, frame_sinks) {
+            video_thread->installFrameSink(sink);
+        }
         video_thread->setOutputSet(mpVOSet);
         demuxer_thread->setVideoThread(video_thread);
+        connect(video_thread, SIGNAL(seekFinished(qreal)), this, SIGNAL(seekFinished()));
 
         QList<Filter*> filters = FilterManager::instance().videoFilters(this);
         if (filters.size() > 0) {
@@ -1290,11 +2037,16 @@ bool AVPlayer::setupVideoThread()
         }
     }
     video_thread->setDecoder(video_dec);
+    video_thread->setStreamIndex(demuxer.videoStream());
     video_thread->setBrightness(mBrightness);
     video_thread->setContrast(mContrast);
     video_thread->setSaturation(mSaturation);
     int queue_min = 0.61803*qMax<qreal>(24.0, mStatistics.video_only.fps_guess);
     int queue_max = int(1.61803*(qreal)queue_min); //about 1 second
+    if (live_mode) {
+        queue_min = 1;
+        queue_max = qMax<int>(2, qMax<qreal>(24.0, mStatistics.video_only.fps_guess)*latency_target/1000);
+    }
     video_thread->packetQueue()->setThreshold(queue_min);
     video_thread->packetQueue()->setCapacity(queue_max);
     return true;
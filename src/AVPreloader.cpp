@@ -0,0 +1,176 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include <QtAV/AVPreloader.h>
+#include <QtAV/AudioDecoder.h>
+#include <QtAV/VideoDecoder.h>
+#include <QtAV/QtAV_Compat.h>
+
+namespace QtAV {
+
+AVPreloader::AVPreloader(const QString &file, QObject *parent)
+    : QThread(parent)
+    , cancelled(false)
+    , ready(false)
+    , media_file(file)
+    , audio_dec(0)
+    , video_dec(0)
+{
+    vcodec_ids << VideoDecoderId_FFmpeg;
+    // errors are emitted in this thread
+    connect(&dmx, SIGNAL(error(QtAV::AVError)), this, SLOT(setError(QtAV::AVError)), Qt::DirectConnection);
+}
+
+AVPreloader::~AVPreloader()
+{
+    cancel();
+    wait();
+    if (audio_dec) {
+        audio_dec->close();
+        delete audio_dec;
+        audio_dec = 0;
+    }
+    if (video_dec) {
+        video_dec->close();
+        delete video_dec;
+        video_dec = 0;
+    }
+}
+
+QString AVPreloader::file() const
+{
+    return media_file;
+}
+
+void AVPreloader::setFormatOptions(const QHash<QByteArray, QByteArray> &dict)
+{
+    dmx.setOptions(dict);
+}
+
+void AVPreloader::setAudioCodecOptions(const QHash<QByteArray, QByteArray> &dict)
+{
+    audio_codec_opt = dict;
+}
+
+void AVPreloader::setVideoCodecOptions(const QHash<QByteArray, QByteArray> &dict)
+{
+    video_codec_opt = dict;
+}
+
+void AVPreloader::setVideoDecoders(const QVector<VideoDecoderId> &ids)
+{
+    vcodec_ids = ids;
+}
+
+void AVPreloader::cancel()
+{
+    cancelled = true;
+    dmx.setInterruptStatus(1);
+}
+
+bool AVPreloader::isCancelled() const
+{
+    return cancelled;
+}
+
+bool AVPreloader::isReady() const
+{
+    return ready && !cancelled && isFinished();
+}
+
+AVError AVPreloader::error() const
+{
+    return err;
+}
+
+AVDemuxer* AVPreloader::demuxer()
+{
+    return &dmx;
+}
+
+AudioDecoder* AVPreloader::takeAudioDecoder()
+{
+    AudioDecoder *dec = audio_dec;
+    audio_dec = 0;
+    return dec;
+}
+
+VideoDecoder* AVPreloader::takeVideoDecoder()
+{
+    VideoDecoder *dec = video_dec;
+    video_dec = 0;
+    return dec;
+}
+
+void AVPreloader::setError(const AVError &e)
+{
+    err = e;
+}
+
+void AVPreloader::run()
+{
+    ready = false;
+    qDebug("preloading %s", qPrintable(media_file));
+    // loadFile() resets the interrupt status
+    if (cancelled || !dmx.loadFile(media_file) || cancelled) {
+        if (err.error() == AVError::NoError)
+            err.setError(AVError::OpenError);
+        return;
+    }
+    AVCodecContext *aCodecCtx = dmx.audioCodecContext();
+    if (aCodecCtx) {
+        audio_dec = new AudioDecoder();
+        audio_dec->setCodecContext(aCodecCtx);
+        audio_dec->setOptions(audio_codec_opt);
+        if (!audio_dec->open()) {
+            delete audio_dec;
+            audio_dec = 0;
+        }
+    }
+    AVCodecContext *vCodecCtx = dmx.videoCodecContext();
+    if (vCodecCtx) {
+        // live mode. output a frame as soon as decoded
+        if (dmx.isLowLatency())
+            vCodecCtx->flags |= CODEC_FLAG_LOW_DELAY;
+        foreach(VideoDecoderId vid, vcodec_ids) {
+            if (cancelled)
+                break;
+            VideoDecoder *vd = VideoDecoderFactory::create(vid);
+            if (!vd)
+                continue;
+            vd->setCodecContext(vCodecCtx);
+            vd->setOptions(video_codec_opt);
+            if (vd->prepare() && vd->open()) {
+                video_dec = vd;
+                break;
+            }
+            delete vd;
+        }
+    }
+    if (!audio_dec && !video_dec) {
+        qWarning("preload %s: no decoder can be used", qPrintable(media_file));
+        err.setError(AVError::OpenCodecError);
+        return;
+    }
+    ready = !cancelled;
+    qDebug("preloaded %s. audio: %p, video: %p", qPrintable(media_file), audio_dec, video_dec);
+}
+
+} //namespace QtAV
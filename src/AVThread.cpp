@@ -133,10 +133,48 @@ void AVThread::pause(bool p)
     if (!d.paused) {
         qDebug("wake up paused thread");
         d.next_pause = false;
+        // resumed by user before the seek target is presented
+        d.pause_after_seek = d.pending_pause_after_seek = false;
         d.cond.wakeAll();
     }
 }
 
+void AVThread::setSeekTarget(qreal pts, bool pauseAfterSeek)
+{
+    DPTR_D(AVThread);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.pending_seek_target = pts;
+    d.pending_pause_after_seek = pauseAfterSeek;
+}
+
+void AVThread::takeSeekTarget()
+{
+    DPTR_D(AVThread);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.seek_target = d.pending_seek_target;
+    d.pause_after_seek = d.pending_pause_after_seek;
+    d.pending_seek_target = -1;
+    d.pending_pause_after_seek = false;
+}
+
+void AVThread::finishSeek(qreal pts)
+{
+    DPTR_D(AVThread);
+    bool pause_after_seek = false;
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.seek_target = -1;
+        pause_after_seek = d.pause_after_seek;
+        d.pause_after_seek = false;
+    }
+    if (pause_after_seek)
+        d.paused = true;
+    emit seekFinished(pts);
+}
+
 void AVThread::nextAndPause()
 {
     DPTR_D(AVThread);
@@ -218,6 +256,8 @@ void AVThread::resetState()
     pause(false);
     d.stop = false;
     d.demux_end = false;
+    d.seek_target = d.pending_seek_target = -1;
+    d.pause_after_seek = d.pending_pause_after_seek = false;
     d.packets.setBlocking(true);
     d.packets.clear();
     //not neccesary context is managed by filters.
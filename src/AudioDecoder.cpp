@@ -24,15 +24,222 @@
 #include <QtAV/QtAV_Compat.h>
 #include <QtAV/AudioResampler.h>
 #include <QtAV/AudioResamplerTypes.h>
+#include <string.h>
+
+#if !QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QTAV_CONVERT_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define QTAV_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+#endif //!QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
 
 namespace QtAV {
 
+#if !QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
+/*
+ * Sample format to interleaved float kernels, used when no resample library is available.
+ * A kernel is selected once in prepare() from the codec's sample format.
+ * TODO: runtime cpu detection. now sse2/neon is chosen at compile time
+ */
+
+typedef void (*ConvertToFloatFunc)(float *dst, const quint8 *const *src, int samples, int channels);
+
+namespace {
+static const float kInt8_inv = 1.0f/128.0f;
+static const float kInt16_inv = 1.0f/32768.0f;
+static const float kInt32_inv = 1.0f/2147483648.0f;
+
+// convert n continuous samples to float
+struct U8ToFloat {
+    typedef quint8 sample_type;
+    static void run(float *dst, const quint8 *src, int n) {
+        int i = 0;
+#if QTAV_CONVERT_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i k80 = _mm_set1_epi16(0x80);
+        const __m128 k = _mm_set1_ps(kInt8_inv);
+        for (; i + 16 <= n; i += 16) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+            const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(x, zero), k80);
+            const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(x, zero), k80);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), k));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), k));
+            _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), k));
+            _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), k));
+        }
+#elif QTAV_CONVERT_NEON
+        const int16x8_t k80 = vdupq_n_s16(0x80);
+        for (; i + 8 <= n; i += 8) {
+            const int16x8_t x = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src + i))), k80);
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), kInt8_inv));
+            vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), kInt8_inv));
+        }
+#endif
+        for (; i < n; ++i)
+            dst[i] = float(int(src[i]) - 0x80) * kInt8_inv;
+    }
+};
+
+struct S16ToFloat {
+    typedef qint16 sample_type;
+    static void run(float *dst, const qint16 *src, int n) {
+        int i = 0;
+#if QTAV_CONVERT_SSE2
+        const __m128 k = _mm_set1_ps(kInt16_inv);
+        for (; i + 8 <= n; i += 8) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), k));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), k));
+        }
+#elif QTAV_CONVERT_NEON
+        for (; i + 8 <= n; i += 8) {
+            const int16x8_t x = vld1q_s16(src + i);
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), kInt16_inv));
+            vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), kInt16_inv));
+        }
+#endif
+        for (; i < n; ++i)
+            dst[i] = float(src[i]) * kInt16_inv;
+    }
+};
+
+struct S32ToFloat {
+    typedef qint32 sample_type;
+    static void run(float *dst, const qint32 *src, int n) {
+        int i = 0;
+#if QTAV_CONVERT_SSE2
+        const __m128 k = _mm_set1_ps(kInt32_inv);
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src + i))), k));
+        }
+#elif QTAV_CONVERT_NEON
+        for (; i + 4 <= n; i += 4) {
+            vst1q_f32(dst + i, vcvtq_n_f32_s32(vld1q_s32(src + i), 31));
+        }
+#endif
+        for (; i < n; ++i)
+            dst[i] = float(src[i]) * kInt32_inv;
+    }
+};
+
+struct FloatToFloat {
+    typedef float sample_type;
+    static void run(float *dst, const float *src, int n) {
+        memcpy(dst, src, n*sizeof(float));
+    }
+};
+
+struct DoubleToFloat {
+    typedef double sample_type;
+    static void run(float *dst, const double *src, int n) {
+        int i = 0;
+#if QTAV_CONVERT_SSE2
+        for (; i + 4 <= n; i += 4) {
+            const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+            const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+            _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+        }
+#endif
+        for (; i < n; ++i)
+            dst[i] = float(src[i]);
+    }
+};
+
+// dst[2*i] = l[i], dst[2*i+1] = r[i]
+static void interleave2(float *dst, const float *l, const float *r, int n)
+{
+    int i = 0;
+#if QTAV_CONVERT_SSE2
+    for (; i + 4 <= n; i += 4) {
+        const __m128 a = _mm_loadu_ps(l + i);
+        const __m128 b = _mm_loadu_ps(r + i);
+        _mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(a, b));
+        _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(a, b));
+    }
+#elif QTAV_CONVERT_NEON
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v;
+        v.val[0] = vld1q_f32(l + i);
+        v.val[1] = vld1q_f32(r + i);
+        vst2q_f32(dst + 2*i, v);
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[2*i] = l[i];
+        dst[2*i + 1] = r[i];
+    }
+}
+
+template<class C>
+void convertPacked(float *dst, const quint8 *const *src, int samples, int channels)
+{
+    C::run(dst, (const typename C::sample_type*)src[0], samples*channels);
+}
+
+template<class C>
+void convertPlanar(float *dst, const quint8 *const *src, int samples, int channels)
+{
+    typedef typename C::sample_type T;
+    if (channels == 1) {
+        C::run(dst, (const T*)src[0], samples);
+        return;
+    }
+    // convert a block of each plane into a small buffer in cache, then interleave
+    enum { kBlock = 256 };
+    float buf[2][kBlock];
+    for (int pos = 0; pos < samples; pos += kBlock) {
+        const int n = qMin<int>(kBlock, samples - pos);
+        float *out = dst + pos*channels;
+        if (channels == 2) {
+            C::run(buf[0], (const T*)src[0] + pos, n);
+            C::run(buf[1], (const T*)src[1] + pos, n);
+            interleave2(out, buf[0], buf[1], n);
+            continue;
+        }
+        for (int ch = 0; ch < channels; ++ch) {
+            C::run(buf[0], (const T*)src[ch] + pos, n);
+            float *o = out + ch;
+            for (int i = 0; i < n; ++i)
+                o[i*channels] = buf[0][i];
+        }
+    }
+}
+
+// index is AVSampleFormat
+static const ConvertToFloatFunc kConvertToFloat[] = {
+    convertPacked<U8ToFloat>,      //AV_SAMPLE_FMT_U8
+    convertPacked<S16ToFloat>,     //AV_SAMPLE_FMT_S16
+    convertPacked<S32ToFloat>,     //AV_SAMPLE_FMT_S32
+    convertPacked<FloatToFloat>,   //AV_SAMPLE_FMT_FLT
+    convertPacked<DoubleToFloat>,  //AV_SAMPLE_FMT_DBL
+    convertPlanar<U8ToFloat>,      //AV_SAMPLE_FMT_U8P
+    convertPlanar<S16ToFloat>,     //AV_SAMPLE_FMT_S16P
+    convertPlanar<S32ToFloat>,     //AV_SAMPLE_FMT_S32P
+    convertPlanar<FloatToFloat>,   //AV_SAMPLE_FMT_FLTP
+    convertPlanar<DoubleToFloat>   //AV_SAMPLE_FMT_DBLP
+};
+
+static ConvertToFloatFunc convertToFloatFunc(int fmt)
+{
+    if (fmt < 0 || fmt >= int(sizeof(kConvertToFloat)/sizeof(kConvertToFloat[0])))
+        return 0;
+    return kConvertToFloat[fmt];
+}
+} //namespace
+#endif //!QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
+
 class AudioDecoderPrivate : public AVDecoderPrivate
 {
 public:
     AudioDecoderPrivate()
         : AVDecoderPrivate()
       , resampler(0)
+#if !QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
+      , convert(0)
+#endif
     {
         resampler = AudioResamplerFactory::create(AudioResamplerId_FF);
         if (!resampler)
@@ -48,6 +255,9 @@ public:
     }
 
     AudioResampler *resampler;
+#if !QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
+    ConvertToFloatFunc convert;
+#endif
 };
 
 AudioDecoder::AudioDecoder()
@@ -60,6 +270,11 @@ bool AudioDecoder::prepare()
     DPTR_D(AudioDecoder);
     if (!d.codec_ctx)
         return false;
+#if !QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
+    d.convert = convertToFloatFunc(d.codec_ctx->sample_fmt);
+    if (!d.convert)
+        qWarning("Unsupported audio format: %d", d.codec_ctx->sample_fmt);
+#endif
     if (!d.resampler)
         return true;
     d.resampler->setInChannelLayout(d.codec_ctx->channel_layout);
@@ -96,114 +311,17 @@ bool AudioDecoder::decode(const QByteArray &encoded)
         return true;
     }
 #if !QTAV_HAVE(SWRESAMPLE) && !QTAV_HAVE(AVRESAMPLE)
-    int samples_with_channels = d.frame->nb_samples * d.codec_ctx->channels;
-    int samples_with_channels_half = samples_with_channels/2;
-    d.decoded.resize(samples_with_channels * sizeof(float));
-    float *decoded_data = (float*)d.decoded.data();
-    static const float kInt8_inv = 1.0f/128.0f;
-    static const float kInt16_inv = 1.0f/32768.0f;
-    static const float kInt32_inv = 1.0f/2147483648.0f;
-    //TODO: hwa
-    //https://code.google.com/p/lavfilters/source/browse/decoder/LAVAudio/LAVAudio.cpp
-    switch (d.codec_ctx->sample_fmt) {
-    case AV_SAMPLE_FMT_U8:
-    {
-        uint8_t *data = (uint8_t*)*d.frame->data;
-        for (int i = 0; i < samples_with_channels_half; i++) {
-            decoded_data[i] = (data[i] - 0x7F) * kInt8_inv;
-            decoded_data[samples_with_channels - i] = (data[samples_with_channels - i] - 0x7F) * kInt8_inv;
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_S16:
-    {
-        int16_t *data = (int16_t*)*d.frame->data;
-        for (int i = 0; i < samples_with_channels_half; i++) {
-            decoded_data[i] = data[i] * kInt16_inv;
-            decoded_data[samples_with_channels - i] = data[samples_with_channels - i] * kInt16_inv;
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_S32:
-    {
-        int32_t *data = (int32_t*)*d.frame->data;
-        for (int i = 0; i < samples_with_channels_half; i++) {
-            decoded_data[i] = data[i] * kInt32_inv;
-            decoded_data[samples_with_channels - i] = data[samples_with_channels - i] * kInt32_inv;
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_FLT:
-        memcpy(decoded_data, *d.frame->data, d.decoded.size());
-        break;
-    case AV_SAMPLE_FMT_DBL:
-    {
-        double *data = (double*)*d.frame->data;
-        for (int i = 0; i < samples_with_channels_half; i++) {
-            decoded_data[i] = data[i];
-            decoded_data[samples_with_channels - i] = data[samples_with_channels - i];
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_U8P:
-    {
-        uint8_t **data = (uint8_t**)d.frame->extended_data;
-        for (int i = 0; i < d.frame->nb_samples; ++i) {
-            for (int ch = 0; ch < d.codec_ctx->channels; ++ch) {
-                *decoded_data++ = (data[ch][i] - 0x7F) * kInt8_inv;
-            }
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_S16P:
-    {
-        uint16_t **data = (uint16_t**)d.frame->extended_data;
-        for (int i = 0; i < d.frame->nb_samples; ++i) {
-            for (int ch = 0; ch < d.codec_ctx->channels; ++ch) {
-                *decoded_data++ = data[ch][i] * kInt16_inv;
-            }
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_S32P:
-    {
-        uint32_t **data = (uint32_t**)d.frame->extended_data;
-        for (int i = 0; i < d.frame->nb_samples; ++i) {
-            for (int ch = 0; ch < d.codec_ctx->channels; ++ch) {
-                *decoded_data++ = data[ch][i] * kInt32_inv;
-            }
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_FLTP:
-    {
-        float **data = (float**)d.frame->extended_data;
-        for (int i = 0; i < d.frame->nb_samples; ++i) {
-            for (int ch = 0; ch < d.codec_ctx->channels; ++ch) {
-                *decoded_data++ = data[ch][i];
-            }
-        }
-    }
-        break;
-    case AV_SAMPLE_FMT_DBLP:
-    {
-        double **data = (double**)d.frame->extended_data;
-        for (int i = 0; i < d.frame->nb_samples; ++i) {
-            for (int ch = 0; ch < d.codec_ctx->channels; ++ch) {
-                *decoded_data++ = data[ch][i];
-            }
-        }
-    }
-        break;
-    default:
+    if (!d.convert) {
         static bool sWarn_a_fmt = true; //FIXME: no warning when replay. warn only once
         if (sWarn_a_fmt) {
             qWarning("Unsupported audio format: %d", d.codec_ctx->sample_fmt);
             sWarn_a_fmt = false;
         }
         d.decoded.clear();
-        break;
+        return false;
     }
+    d.decoded.resize(d.frame->nb_samples * d.codec_ctx->channels * sizeof(float));
+    d.convert((float*)d.decoded.data(), (const quint8* const*)d.frame->extended_data, d.frame->nb_samples, d.codec_ctx->channels);
 #else
     d.resampler->setInSampesPerChannel(d.frame->nb_samples);
     if (!d.resampler->convert((const quint8**)d.frame->extended_data)) {
@@ -0,0 +1,51 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/AudioFilter.h"
+#include "private/Filter_p.h"
+
+namespace QtAV {
+
+AudioFilter::AudioFilter()
+    :Filter()
+{
+}
+
+AudioFilter::AudioFilter(FilterPrivate &d)
+    :Filter(d)
+{
+}
+
+AudioFilter::~AudioFilter()
+{
+}
+
+AudioFormat::SampleFormat AudioFilter::requiredSampleFormat() const
+{
+    return AudioFormat::SampleFormat_Unknown;
+}
+
+int AudioFilter::requiredChannels() const
+{
+    return 0;
+}
+
+} //namespace QtAV
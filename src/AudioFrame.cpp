@@ -18,19 +18,49 @@
     License along with this library; if not, write to the Free Software
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ******************************************************************************/
-
 #include "QtAV/AudioFrame.h"
 #include "private/Frame_p.h"
+#include <string.h>
 
 namespace QtAV {
 
+const int AudioFrame::kAlignment = 32;
+
 class AudioFramePrivate : public FramePrivate
 {
 public:
-    AudioFramePrivate()
+    AudioFramePrivate(const AudioFormat& fmt = AudioFormat())
         : FramePrivate()
-    {}
+        , format(fmt)
+        , samples_per_channel(0)
+        , offset(-1)
+        , stride(0)
+    {
+        const int nb_planes = format.isPlanar() ? qMax(format.channels(), 1) : 1;
+        planes.resize(nb_planes);
+        line_sizes.resize(nb_planes);
+    }
     ~AudioFramePrivate() {}
+
+    int planeSize() const {
+        if (format.isPlanar())
+            return samples_per_channel*format.bytesPerSample();
+        return samples_per_channel*format.bytesPerFrame();
+    }
+    // planes are continuous in data, start from offset and each plane's size is padded to stride
+    void setupPlanes(int stride) {
+        uchar *base = (uchar*)data.constData() + offset;
+        for (int i = 0; i < planes.size(); ++i) {
+            planes[i] = base + i*stride;
+            line_sizes[i] = planeSize();
+        }
+    }
+
+    AudioFormat format;
+    int samples_per_channel;
+    // offset of the first plane in data. -1: planes are not in data(set by user)
+    int offset;
+    int stride;
 };
 
 AudioFrame::AudioFrame():
@@ -38,6 +68,26 @@ AudioFrame::AudioFrame():
 {
 }
 
+AudioFrame::AudioFrame(const AudioFormat &format):
+    Frame(*new AudioFramePrivate(format))
+{
+}
+
+AudioFrame::AudioFrame(const QByteArray &data, const AudioFormat &format):
+    Frame(*new AudioFramePrivate(format))
+{
+    Q_D(AudioFrame);
+    if (!format.isValid() || format.bytesPerFrame() <= 0) {
+        qWarning("AudioFrame: invalid audio format");
+        return;
+    }
+    d->data = data;
+    d->samples_per_channel = data.size()/format.bytesPerFrame();
+    d->offset = 0;
+    d->stride = d->planeSize();
+    d->setupPlanes(d->stride);
+}
+
 /*!
     Constructs a shallow copy of \a other.  Since AudioFrame is
     explicitly shared, these two instances will reflect the same frame.
@@ -63,4 +113,245 @@ AudioFrame::~AudioFrame()
 {
 }
 
+bool AudioFrame::isValid() const
+{
+    Q_D(const AudioFrame);
+    return d->format.isValid() && d->samples_per_channel > 0 && d->planes[0];
+}
+
+AudioFrame AudioFrame::clone() const
+{
+    Q_D(const AudioFrame);
+    AudioFrame f(d->format);
+    f.setSamplesPerChannel(d->samples_per_channel);
+    if (!isValid())
+        return f;
+    f.allocate();
+    for (int i = 0; i < planeCount(); ++i) {
+        memcpy(f.bits(i), bits(i), bytesPerLine(i));
+    }
+    f.d_ptr->metadata = d->metadata;
+    return f;
+}
+
+int AudioFrame::allocate()
+{
+    Q_D(AudioFrame);
+    if (!d->format.isValid() || d->samples_per_channel <= 0) {
+        qWarning("AudioFrame::allocate: format and samples per channel must be set");
+        return 0;
+    }
+    const int stride = (d->planeSize() + kAlignment - 1) & ~(kAlignment - 1);
+    const int size = stride*planeCount();
+    d->data.resize(size + kAlignment);
+    const quintptr addr = (quintptr)d->data.constData();
+    d->offset = int(((addr + kAlignment - 1) & ~quintptr(kAlignment - 1)) - addr);
+    d->stride = stride;
+    d->setupPlanes(stride);
+    return size;
+}
+
+AudioFormat AudioFrame::format() const
+{
+    return d_func()->format;
+}
+
+int AudioFrame::channelCount() const
+{
+    return d_func()->format.channels();
+}
+
+int AudioFrame::samplesPerChannel() const
+{
+    return d_func()->samples_per_channel;
+}
+
+void AudioFrame::setSamplesPerChannel(int samples)
+{
+    Q_D(AudioFrame);
+    d->samples_per_channel = samples;
+    for (int i = 0; i < d->line_sizes.size(); ++i) {
+        d->line_sizes[i] = d->planeSize();
+    }
+}
+
+qreal AudioFrame::duration() const
+{
+    Q_D(const AudioFrame);
+    if (d->format.sampleRate() <= 0)
+        return 0;
+    return qreal(d->samples_per_channel)/qreal(d->format.sampleRate());
+}
+
+uchar* AudioFrame::writableBits(int plane)
+{
+    Q_D(AudioFrame);
+    // planes point to an implicitly shared QByteArray, e.g. decoder's output. detach it before writing
+    if (d->offset >= 0 && !d->data.isDetached()) {
+        d->data.detach();
+        d->setupPlanes(d->stride);
+    }
+    return bits(plane);
+}
+
+namespace {
+// sample helpers for format conversion. float is used as the intermediate type
+template<typename T> inline float toFloat(T v);
+template<> inline float toFloat<quint8>(quint8 v) { return float(int(v) - 0x80)*(1.0f/128.0f); }
+template<> inline float toFloat<qint16>(qint16 v) { return float(v)*(1.0f/32768.0f); }
+template<> inline float toFloat<qint32>(qint32 v) { return float(v)*(1.0f/2147483648.0f); }
+template<> inline float toFloat<float>(float v) { return v; }
+template<> inline float toFloat<double>(double v) { return float(v); }
+
+template<typename T> inline T fromFloat(float v);
+template<> inline quint8 fromFloat<quint8>(float v) { return quint8(qBound(0, int(v*128.0f) + 0x80, 0xff)); }
+template<> inline qint16 fromFloat<qint16>(float v) { return qint16(qBound(-32768, int(v*32768.0f), 32767)); }
+template<> inline qint32 fromFloat<qint32>(float v) { return qint32(qBound(-2147483648.0, double(v)*2147483648.0, 2147483647.0)); }
+template<> inline float fromFloat<float>(float v) { return v; }
+template<> inline double fromFloat<double>(float v) { return double(v); }
+
+// read channel c of all samples into dst
+template<typename T>
+void readChannel(const AudioFrame& f, int c, float *dst)
+{
+    const int n = f.samplesPerChannel();
+    if (f.format().isPlanar()) {
+        const T *src = f.constSamples<T>(c);
+        for (int i = 0; i < n; ++i)
+            dst[i] = toFloat<T>(src[i]);
+        return;
+    }
+    const int channels = f.channelCount();
+    const T *src = f.constSamples<T>(0) + c;
+    for (int i = 0; i < n; ++i)
+        dst[i] = toFloat<T>(src[i*channels]);
+}
+
+template<typename T>
+void writeChannel(AudioFrame& f, int c, const float *src)
+{
+    const int n = f.samplesPerChannel();
+    if (f.format().isPlanar()) {
+        T *dst = f.samples<T>(c);
+        for (int i = 0; i < n; ++i)
+            dst[i] = fromFloat<T>(src[i]);
+        return;
+    }
+    const int channels = f.channelCount();
+    T *dst = f.samples<T>(0) + c;
+    for (int i = 0; i < n; ++i)
+        dst[i*channels] = fromFloat<T>(src[i]);
+}
+
+void readChannel(const AudioFrame& f, int c, float *dst)
+{
+    switch (f.format().sampleFormat()) {
+    case AudioFormat::SampleFormat_Unsigned8:
+    case AudioFormat::SampleFormat_Unsigned8Planar:
+        readChannel<quint8>(f, c, dst);
+        break;
+    case AudioFormat::SampleFormat_Signed16:
+    case AudioFormat::SampleFormat_Signed16Planar:
+        readChannel<qint16>(f, c, dst);
+        break;
+    case AudioFormat::SampleFormat_Signed32:
+    case AudioFormat::SampleFormat_Signed32Planar:
+        readChannel<qint32>(f, c, dst);
+        break;
+    case AudioFormat::SampleFormat_Float:
+    case AudioFormat::SampleFormat_FloatPlanar:
+        readChannel<float>(f, c, dst);
+        break;
+    case AudioFormat::SampleFormat_Double:
+    case AudioFormat::SampleFormat_DoublePlanar:
+        readChannel<double>(f, c, dst);
+        break;
+    default:
+        break;
+    }
+}
+
+void writeChannel(AudioFrame& f, int c, const float *src)
+{
+    switch (f.format().sampleFormat()) {
+    case AudioFormat::SampleFormat_Unsigned8:
+    case AudioFormat::SampleFormat_Unsigned8Planar:
+        writeChannel<quint8>(f, c, src);
+        break;
+    case AudioFormat::SampleFormat_Signed16:
+    case AudioFormat::SampleFormat_Signed16Planar:
+        writeChannel<qint16>(f, c, src);
+        break;
+    case AudioFormat::SampleFormat_Signed32:
+    case AudioFormat::SampleFormat_Signed32Planar:
+        writeChannel<qint32>(f, c, src);
+        break;
+    case AudioFormat::SampleFormat_Float:
+    case AudioFormat::SampleFormat_FloatPlanar:
+        writeChannel<float>(f, c, src);
+        break;
+    case AudioFormat::SampleFormat_Double:
+    case AudioFormat::SampleFormat_DoublePlanar:
+        writeChannel<double>(f, c, src);
+        break;
+    default:
+        break;
+    }
+}
+} //namespace
+
+AudioFrame AudioFrame::to(const AudioFormat &fmt) const
+{
+    Q_D(const AudioFrame);
+    if (fmt.sampleFormat() == d->format.sampleFormat() && fmt.channels() == d->format.channels())
+        return *this;
+    if (!isValid() || !fmt.isValid()) {
+        qWarning("AudioFrame::to: invalid frame or format");
+        return AudioFrame();
+    }
+    AudioFormat af(fmt);
+    af.setSampleRate(d->format.sampleRate());
+    AudioFrame f(af);
+    f.setSamplesPerChannel(d->samples_per_channel);
+    f.allocate();
+    f.d_ptr->metadata = d->metadata;
+    const int in_channels = channelCount();
+    const int out_channels = f.channelCount();
+    QVector<float> buf(d->samples_per_channel);
+    QVector<float> mix;
+    for (int c = 0; c < out_channels; ++c) {
+        if (in_channels <= out_channels) {
+            // upmix: duplicate the input channels
+            readChannel(*this, c % in_channels, buf.data());
+        } else {
+            // downmix: average the input channels mapped to c
+            mix.fill(0, d->samples_per_channel);
+            int n = 0;
+            for (int ic = c; ic < in_channels; ic += out_channels, ++n) {
+                readChannel(*this, ic, buf.data());
+                for (int i = 0; i < buf.size(); ++i)
+                    mix[i] += buf[i];
+            }
+            const float k = 1.0f/float(n);
+            for (int i = 0; i < buf.size(); ++i)
+                buf[i] = mix[i]*k;
+        }
+        writeChannel(f, c, buf.constData());
+    }
+    return f;
+}
+
+QByteArray AudioFrame::samplesData() const
+{
+    Q_D(const AudioFrame);
+    if (d->offset == 0 && planeCount() == 1 && d->data.size() == d->planeSize())
+        return d->data;
+    QByteArray data;
+    data.reserve(d->planeSize()*planeCount());
+    for (int i = 0; i < planeCount(); ++i) {
+        data.append((const char*)bits(i), bytesPerLine(i));
+    }
+    return data;
+}
+
 } //namespace QtAV
@@ -0,0 +1,481 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/AudioOutputMixer.h"
+#include "QtAV/AudioOutputTypes.h"
+#include "private/AudioOutput_p.h"
+#include "prepost.h"
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QTAV_MIX_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define QTAV_MIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace QtAV {
+
+extern AudioOutputId AudioOutputId_Mixer;
+FACTORY_REGISTER_ID_AUTO(AudioOutput, Mixer, "Mixer")
+
+void RegisterAudioOutputMixer_Man()
+{
+    FACTORY_REGISTER_ID_MAN(AudioOutput, Mixer, "Mixer")
+}
+
+/*
+ * bus[i] += src[i]*gain[i%4]. n is the number of floats. gain has 4 elements so that
+ * stereo(l, r, l, r) and mono(g, g, g, g) use the same kernel
+ */
+static void mixAdd(float *bus, const float *src, int n, const float gain[4])
+{
+    int i = 0;
+#if QTAV_MIX_SSE
+    const __m128 g = _mm_loadu_ps(gain);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(bus + i, _mm_add_ps(_mm_loadu_ps(bus + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    }
+#elif QTAV_MIX_NEON
+    const float32x4_t g = vld1q_f32(gain);
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(bus + i, vmlaq_f32(vld1q_f32(bus + i), vld1q_f32(src + i), g));
+    }
+#endif
+    for (; i < n; ++i)
+        bus[i] += src[i]*gain[i%4];
+}
+
+static void clip(float *bus, int n)
+{
+    int i = 0;
+#if QTAV_MIX_SSE
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(bus + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus + i), lo), hi));
+    }
+#elif QTAV_MIX_NEON
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(bus + i, vminq_f32(vmaxq_f32(vld1q_f32(bus + i), lo), hi));
+    }
+#endif
+    for (; i < n; ++i)
+        bus[i] = qBound(-1.0f, bus[i], 1.0f);
+}
+
+class AudioMixerPrivate : public DPtrPrivate<AudioMixer>
+{
+public:
+    AudioMixerPrivate()
+        : stop(false)
+        , device_id(0)
+        , device(0)
+        , period(1024)
+    {
+#if QTAV_HAVE(PORTAUDIO)
+        device_id = AudioOutputId_PortAudio;
+#elif QTAV_HAVE(OPENAL)
+        device_id = AudioOutputId_OpenAL;
+#endif
+        format.setSampleFormat(AudioFormat::SampleFormat_Float);
+        format.setSampleRate(48000);
+        format.setChannels(2);
+    }
+    ~AudioMixerPrivate() {
+        if (device) {
+            delete device;
+            device = 0;
+        }
+    }
+    bool openDevice() {
+        if (!device) {
+            device = AudioOutputFactory::create(device_id);
+            if (!device) {
+                qWarning("AudioMixer: can not create audio output %d", device_id);
+                return false;
+            }
+        }
+        device->setAudioFormat(format);
+        if (!device->open()) {
+            qWarning("AudioMixer: failed to open audio output %s", AudioOutputFactory::name(device_id).c_str());
+            return false;
+        }
+        return true;
+    }
+
+    volatile bool stop;
+    AudioOutputId device_id;
+    AudioOutput *device;
+    AudioFormat format;
+    int period;
+    QList<AudioOutputMixer*> sources;
+    mutable QMutex mutex;
+    QWaitCondition cond; //wait for sources
+};
+
+AudioMixer& AudioMixer::instance()
+{
+    static AudioMixer mixer;
+    return mixer;
+}
+
+AudioMixer::AudioMixer(QObject *parent)
+    :QThread(parent)
+{
+}
+
+AudioMixer::~AudioMixer()
+{
+    stop();
+}
+
+void AudioMixer::setDevice(AudioOutputId id)
+{
+    DPTR_D(AudioMixer);
+    if (id == AudioOutputId_Mixer) {
+        qWarning("AudioMixer: mixer can not be used as the device");
+        return;
+    }
+    if (isRunning()) {
+        qWarning("AudioMixer: can not change device while mixing");
+        return;
+    }
+    if (d.device_id == id)
+        return;
+    d.device_id = id;
+    if (d.device) {
+        delete d.device;
+        d.device = 0;
+    }
+}
+
+AudioOutputId AudioMixer::device() const
+{
+    return d_func().device_id;
+}
+
+void AudioMixer::setSampleRate(int rate)
+{
+    DPTR_D(AudioMixer);
+    if (isRunning()) {
+        qWarning("AudioMixer: can not change format while mixing");
+        return;
+    }
+    d.format.setSampleRate(rate);
+}
+
+void AudioMixer::setChannels(int channels)
+{
+    DPTR_D(AudioMixer);
+    if (isRunning()) {
+        qWarning("AudioMixer: can not change format while mixing");
+        return;
+    }
+    d.format.setChannels(channels);
+}
+
+const AudioFormat& AudioMixer::audioFormat() const
+{
+    return d_func().format;
+}
+
+void AudioMixer::setPeriodSize(int samples)
+{
+    DPTR_D(AudioMixer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.period = qMax(64, samples);
+}
+
+int AudioMixer::periodSize() const
+{
+    DPTR_D(const AudioMixer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.period;
+}
+
+int AudioMixer::sourceCount() const
+{
+    DPTR_D(const AudioMixer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.sources.size();
+}
+
+void AudioMixer::stop()
+{
+    DPTR_D(AudioMixer);
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.stop = true;
+        d.cond.wakeAll();
+    }
+    if (isRunning())
+        wait();
+    if (d.device && d.device->isAvailable())
+        d.device->close();
+}
+
+bool AudioMixer::addSource(AudioOutputMixer *source)
+{
+    DPTR_D(AudioMixer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (!d.sources.contains(source))
+        d.sources.append(source);
+    if (!isRunning()) {
+        if (!d.openDevice()) {
+            // still mix to keep the sources running. the thread sleeps instead of writing
+            qWarning("AudioMixer: no device. audio will not be played");
+        }
+        d.stop = false;
+        start();
+    }
+    d.cond.wakeAll();
+    return true;
+}
+
+void AudioMixer::removeSource(AudioOutputMixer *source)
+{
+    DPTR_D(AudioMixer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.sources.removeAll(source);
+}
+
+void AudioMixer::run()
+{
+    DPTR_D(AudioMixer);
+    const int channels = d.format.channels();
+    const qreal period_duration = qreal(d.period)/qreal(d.format.sampleRate());
+    QVector<float> bus;
+    QVector<float> buf;
+    while (!d.stop) {
+        int period = 0;
+        {
+            QMutexLocker lock(&d.mutex);
+            Q_UNUSED(lock);
+            if (d.sources.isEmpty()) {
+                d.cond.wait(&d.mutex, 100);
+                continue;
+            }
+            period = d.period;
+            bus.fill(0, period*channels);
+            buf.resize(period*channels);
+            foreach (AudioOutputMixer *source, d.sources) {
+                // read even if muted to keep the source's clock running
+                const int n = source->read(buf.data(), period);
+                if (n <= 0 || source->isMute())
+                    continue;
+                const qreal gain = source->gain();
+                float g[4];
+                if (channels == 2) {
+                    const qreal pan = source->pan();
+                    g[0] = g[2] = gain*qMin<qreal>(1.0, 1.0 - pan);
+                    g[1] = g[3] = gain*qMin<qreal>(1.0, 1.0 + pan);
+                } else {
+                    g[0] = g[1] = g[2] = g[3] = gain;
+                }
+                mixAdd(bus.data(), buf.constData(), n*channels, g);
+            }
+        }
+        clip(bus.data(), bus.size());
+        if (d.device && d.device->isAvailable()) {
+            // blocks until the device can accept more data
+            d.device->receiveData(QByteArray((const char*)bus.constData(), bus.size()*sizeof(float)));
+        } else {
+            msleep((unsigned long)(period_duration*1000.0));
+        }
+    }
+    qDebug("AudioMixer thread stops running...");
+}
+
+class AudioOutputMixerPrivate : public AudioOutputPrivate
+{
+public:
+    AudioOutputMixerPrivate()
+        : AudioOutputPrivate()
+        , mixer(0)
+        , gain(1.0)
+        , pan(0)
+        , played(0)
+        , closing(false)
+    {
+        max_channels = 8;
+    }
+    AudioMixer *mixer;
+    qreal gain, pan;
+    qint64 played; //samples per channel mixed
+    bool closing;
+    QByteArray fifo; //float interleaved in bus format
+    mutable QMutex fifo_mutex;
+    QWaitCondition fifo_cond;
+};
+
+AudioOutputMixer::AudioOutputMixer()
+    :AudioOutput(*new AudioOutputMixerPrivate())
+{
+    d_func().available = false;
+}
+
+AudioOutputMixer::~AudioOutputMixer()
+{
+    close();
+}
+
+void AudioOutputMixer::setMixer(AudioMixer *mixer)
+{
+    DPTR_D(AudioOutputMixer);
+    if (isAvailable()) {
+        qWarning("AudioOutputMixer: close before changing the mixer");
+        return;
+    }
+    d.mixer = mixer;
+}
+
+AudioMixer* AudioOutputMixer::mixer() const
+{
+    DPTR_D(const AudioOutputMixer);
+    return d.mixer ? d.mixer : &AudioMixer::instance();
+}
+
+bool AudioOutputMixer::open()
+{
+    DPTR_D(AudioOutputMixer);
+    AudioMixer *m = mixer();
+    // the player resamples to the bus format. AVPlayer changes the format before each open()
+    setAudioFormat(m->audioFormat());
+    if (isAvailable())
+        return true;
+    {
+        QMutexLocker lock(&d.fifo_mutex);
+        Q_UNUSED(lock);
+        d.fifo.clear();
+        d.played = 0;
+        d.closing = false;
+    }
+    d.available = m->addSource(this);
+    return d.available;
+}
+
+bool AudioOutputMixer::close()
+{
+    DPTR_D(AudioOutputMixer);
+    if (!isAvailable())
+        return true;
+    d.available = false;
+    {
+        QMutexLocker lock(&d.fifo_mutex);
+        Q_UNUSED(lock);
+        d.closing = true;
+        d.fifo_cond.wakeAll();
+    }
+    mixer()->removeSource(this);
+    return true;
+}
+
+void AudioOutputMixer::setGain(qreal gain)
+{
+    d_func().gain = qMax<qreal>(gain, 0);
+}
+
+qreal AudioOutputMixer::gain() const
+{
+    return d_func().gain;
+}
+
+void AudioOutputMixer::setPan(qreal pan)
+{
+    d_func().pan = qBound<qreal>(-1.0, pan, 1.0);
+}
+
+qreal AudioOutputMixer::pan() const
+{
+    return d_func().pan;
+}
+
+qreal AudioOutputMixer::bufferedDuration() const
+{
+    DPTR_D(const AudioOutputMixer);
+    QMutexLocker lock(&d.fifo_mutex);
+    Q_UNUSED(lock);
+    if (audioFormat().bytesPerFrame() <= 0 || audioFormat().sampleRate() <= 0)
+        return 0;
+    return qreal(d.fifo.size()/audioFormat().bytesPerFrame())/qreal(audioFormat().sampleRate());
+}
+
+qreal AudioOutputMixer::playedDuration() const
+{
+    DPTR_D(const AudioOutputMixer);
+    QMutexLocker lock(&d.fifo_mutex);
+    Q_UNUSED(lock);
+    if (audioFormat().sampleRate() <= 0)
+        return 0;
+    return qreal(d.played)/qreal(audioFormat().sampleRate());
+}
+
+bool AudioOutputMixer::write()
+{
+    DPTR_D(AudioOutputMixer);
+    if (d.data.isEmpty())
+        return false;
+    // keep about 3 periods queued, like the buffers of a device
+    const int max_size = 3*mixer()->periodSize()*audioFormat().bytesPerFrame();
+    QMutexLocker lock(&d.fifo_mutex);
+    Q_UNUSED(lock);
+    while (d.fifo.size() >= max_size && !d.closing) {
+        d.fifo_cond.wait(&d.fifo_mutex, 100);
+    }
+    if (d.closing)
+        return false;
+    d.fifo.append(d.data);
+    return true;
+}
+
+int AudioOutputMixer::read(float *dst, int samples)
+{
+    DPTR_D(AudioOutputMixer);
+    QMutexLocker lock(&d.fifo_mutex);
+    Q_UNUSED(lock);
+    const int bpf = audioFormat().bytesPerFrame();
+    if (bpf <= 0)
+        return 0;
+    const int n = qMin(samples, d.fifo.size()/bpf);
+    if (n <= 0)
+        return 0;
+    memcpy(dst, d.fifo.constData(), n*bpf);
+    d.fifo.remove(0, n*bpf);
+    d.played += n;
+    d.fifo_cond.wakeAll();
+    return n;
+}
+
+} //namespace QtAV
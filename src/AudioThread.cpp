@@ -24,9 +24,13 @@
 #include <QtAV/AudioDecoder.h>
 #include <QtAV/Packet.h>
 #include <QtAV/AudioFormat.h>
+#include <QtAV/AudioFrame.h>
+#include <QtAV/AudioFilter.h>
 #include <QtAV/AudioOutput.h>
 #include <QtAV/AudioResampler.h>
 #include <QtAV/AVClock.h>
+#include <QtAV/LoudnessMeter.h>
+#include <QtAV/Statistics.h>
 #include <QtAV/OutputSet.h>
 #include <QtAV/QtAV_Compat.h>
 #include <QtCore/QCoreApplication>
@@ -36,13 +40,99 @@ namespace QtAV {
 class AudioThreadPrivate : public AVThreadPrivate
 {
 public:
+    AudioThreadPrivate()
+        : AVThreadPrivate()
+        , meter_enabled(false)
+        , meter_reset(false)
+    {}
     void init() {
         resample = false;
         last_pts = 0;
     }
 
+    /*
+     * Filters which accept any format run first on the decoded frame. Then the filters are
+     * grouped by their required format, and the group which requires the output format runs
+     * last. So a frame is converted at most once per group.
+     */
+    void orderFilters(const AudioFormat& fmt) {
+        ordered_filters.clear();
+        QList<AudioFilter*> rest;
+        foreach (Filter *filter, filters) {
+            if (!filter->isEnabled())
+                continue;
+            AudioFilter *af = dynamic_cast<AudioFilter*>(filter);
+            if (!af || (af->requiredSampleFormat() == AudioFormat::SampleFormat_Unknown && af->requiredChannels() <= 0))
+                ordered_filters.append(filter);
+            else
+                rest.append(af);
+        }
+        QList<Filter*> last;
+        while (!rest.isEmpty()) {
+            const AudioFormat::SampleFormat sf = rest.first()->requiredSampleFormat();
+            const int channels = rest.first()->requiredChannels();
+            QList<Filter*> group;
+            for (int i = 0; i < rest.size();) {
+                if (rest[i]->requiredSampleFormat() == sf && rest[i]->requiredChannels() == channels) {
+                    group.append(rest.takeAt(i));
+                } else {
+                    ++i;
+                }
+            }
+            if ((sf == AudioFormat::SampleFormat_Unknown || sf == fmt.sampleFormat())
+                    && (channels <= 0 || channels == fmt.channels()))
+                last += group;
+            else
+                ordered_filters.append(group);
+        }
+        ordered_filters.append(last);
+    }
+    // the order is rebuilt only if the filters, their enabled state or the format changed
+    void updateFilterOrder(const AudioFormat& fmt) {
+        QList<bool> enabled;
+        foreach (Filter *filter, filters) {
+            enabled.append(filter->isEnabled());
+        }
+        if (filters == ordered_source && enabled == ordered_enabled && fmt == ordered_format)
+            return;
+        ordered_source = filters;
+        ordered_enabled = enabled;
+        ordered_format = fmt;
+        orderFilters(fmt);
+    }
+    // run the filters in place and return the samples in the same format as data
+    QByteArray applyFilters(const QByteArray& data, const AudioFormat& fmt) {
+        updateFilterOrder(fmt);
+        if (ordered_filters.isEmpty())
+            return data;
+        AudioFrame frame(data, fmt);
+        if (!frame.isValid())
+            return data;
+        foreach (Filter *filter, ordered_filters) {
+            AudioFilter *af = dynamic_cast<AudioFilter*>(filter);
+            if (af) {
+                AudioFormat wanted(frame.format());
+                if (af->requiredSampleFormat() != AudioFormat::SampleFormat_Unknown)
+                    wanted.setSampleFormat(af->requiredSampleFormat());
+                if (af->requiredChannels() > 0)
+                    wanted.setChannels(af->requiredChannels());
+                frame = frame.to(wanted); //no copy if format does not change
+            }
+            filter->process(filter_context, statistics, &frame);
+        }
+        return frame.to(fmt).samplesData();
+    }
+
     bool resample;
     qreal last_pts; //used when audio output is not available, to calculate the aproximate sleeping time
+    QList<Filter*> ordered_filters;
+    // what ordered_filters is built from
+    QList<Filter*> ordered_source;
+    QList<bool> ordered_enabled;
+    AudioFormat ordered_format;
+    volatile bool meter_enabled;
+    volatile bool meter_reset;
+    LoudnessMeter meter;
 };
 
 AudioThread::AudioThread(QObject *parent)
@@ -50,6 +140,21 @@ AudioThread::AudioThread(QObject *parent)
 {
 }
 
+void AudioThread::setLoudnessMeterEnabled(bool enabled)
+{
+    DPTR_D(AudioThread);
+    if (d.meter_enabled == enabled)
+        return;
+    //reset in audio thread
+    d.meter_reset = enabled;
+    d.meter_enabled = enabled;
+}
+
+bool AudioThread::isLoudnessMeterEnabled() const
+{
+    return d_func().meter_enabled;
+}
+
 /*
  *TODO:
  * if output is null or dummy, the use duration to wait
@@ -95,6 +200,9 @@ void AudioThread::run()
         if (!pkt.isValid()) {
             qDebug("Invalid packet! flush audio codec context!!!!!!!! audio queue size=%d", d.packets.size());
             dec->flush();
+            //seeking. integrated loudness and true peak are kept
+            d.meter.resetWindow();
+            takeSeekTarget();
             continue;
         }
         if (is_external_clock) {
@@ -182,12 +290,50 @@ void AudioThread::run()
             continue;
         }
         QByteArray decoded(dec->data());
+        if (d.seek_target >= 0) {
+            // accurate seek. drop the samples before the target
+            const AudioFormat &fmt = dec->resampler()->outAudioFormat();
+            const qreal rate = qreal(fmt.bytesPerSecond())/dec->resampler()->speed();
+            int skip = 0;
+            if (d.seek_target > pkt.pts && fmt.bytesPerFrame() > 0)
+                skip = qMin(decoded.size(), int((d.seek_target - pkt.pts)*rate)/fmt.bytesPerFrame()*fmt.bytesPerFrame());
+            if (skip > 0) {
+                decoded.remove(0, skip);
+                pkt.pts += qreal(skip)/rate;
+                if (!is_external_clock)
+                    d.clock->updateValue(pkt.pts);
+            }
+            if (!decoded.isEmpty())
+                d.seek_target = -1;
+        }
+        if (!d.filters.isEmpty() && !decoded.isEmpty()) {
+            decoded = d.applyFilters(decoded, dec->resampler()->outAudioFormat());
+        }
+        if (d.meter_enabled && d.statistics) {
+            const AudioFormat &fmt = dec->resampler()->outAudioFormat();
+            if (fmt.sampleFormat() == AudioFormat::SampleFormat_Float && fmt.bytesPerFrame() > 0) {
+                if (d.meter_reset || d.meter.sampleRate() != fmt.sampleRate() || d.meter.channels() != fmt.channels()) {
+                    d.meter.setAudioFormat(fmt.sampleRate(), fmt.channels());
+                    d.meter_reset = false;
+                }
+                d.meter.process((const float*)decoded.constData(), decoded.size()/fmt.bytesPerFrame());
+                // the ui reads it in another thread
+                Statistics::AudioOnly::Loudness loudness;
+                loudness.momentary = d.meter.momentaryLoudness();
+                loudness.short_term = d.meter.shortTermLoudness();
+                loudness.integrated = d.meter.integratedLoudness();
+                loudness.true_peak = d.meter.truePeak();
+                loudness.rms = d.meter.rms();
+                d.statistics->audio_only.setLoudness(loudness);
+            }
+        }
         int decodedSize = decoded.size();
         int decodedPos = 0;
         qreal delay =0;
         //AudioFormat.durationForBytes() calculates int type internally. not accurate
-        AudioFormat &af = dec->resampler()->inAudioFormat();
-        qreal byte_rate = af.bytesPerSecond();
+        //decoded data is in resampler's output format. 1 second output is speed() seconds of the stream
+        AudioFormat &af = dec->resampler()->outAudioFormat();
+        qreal byte_rate = qreal(af.bytesPerSecond())/dec->resampler()->speed();
         while (decodedSize > 0) {
             if (d.stop) {
                 qDebug("audio thread stop after decode()");
@@ -200,7 +346,7 @@ void AudioThread::run()
             d.clock->updateDelay(delay += chunk_delay);
             QByteArray decodedChunk(chunk, 0); //volume == 0 || mute
             if (has_ao) {
-                //TODO: volume filter and other filters!!!
+                //TODO: volume filter
                 if (!ao->isMute()) {
                     decodedChunk = QByteArray::fromRawData(decoded.constData() + decodedPos, chunk);
                     qreal vol = ao->volume();
@@ -0,0 +1,673 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include <QtAV/AudioWaveform.h>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/AudioDecoder.h>
+#include <QtAV/AudioFormat.h>
+#include <QtAV/AudioResampler.h>
+#include <QtAV/Packet.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/qmath.h>
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#include <QtGui/QDesktopServices>
+#else
+#include <QtCore/QStandardPaths>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QTAV_WAVEFORM_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define QTAV_WAVEFORM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace QtAV {
+
+static const quint32 kCacheMagic = 0x51574146; //QWAF
+static const quint32 kCacheVersion = 1;
+static const qint64 kMinRangeDuration = 60000; //ms. shorter range is not worth a demuxer
+static const int kMaxReadErrors = 64;
+
+/*
+ * reduce n floats. min/max are updated. return the sum of squares.
+ * the sum of a block is accumulated in float lanes then added to a double, n is at most a bucket
+ */
+static double reduce(const float *p, int n, float *pmin, float *pmax)
+{
+    float mn = *pmin, mx = *pmax;
+    double sum = 0;
+    int i = 0;
+#if QTAV_WAVEFORM_SSE
+    if (n >= 8) {
+        __m128 vmin = _mm_set1_ps(mn), vmax = _mm_set1_ps(mx);
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+        for (; i + 8 <= n; i += 8) {
+            const __m128 a = _mm_loadu_ps(p + i);
+            const __m128 b = _mm_loadu_ps(p + i + 4);
+            vmin = _mm_min_ps(vmin, _mm_min_ps(a, b));
+            vmax = _mm_max_ps(vmax, _mm_max_ps(a, b));
+            s0 = _mm_add_ps(s0, _mm_mul_ps(a, a));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(b, b));
+        }
+        float t[4];
+        _mm_storeu_ps(t, vmin);
+        mn = qMin(qMin(t[0], t[1]), qMin(t[2], t[3]));
+        _mm_storeu_ps(t, vmax);
+        mx = qMax(qMax(t[0], t[1]), qMax(t[2], t[3]));
+        _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+        sum = (double)t[0] + t[1] + t[2] + t[3];
+    }
+#elif QTAV_WAVEFORM_NEON
+    if (n >= 8) {
+        float32x4_t vmin = vdupq_n_f32(mn), vmax = vdupq_n_f32(mx);
+        float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+        for (; i + 8 <= n; i += 8) {
+            const float32x4_t a = vld1q_f32(p + i);
+            const float32x4_t b = vld1q_f32(p + i + 4);
+            vmin = vminq_f32(vmin, vminq_f32(a, b));
+            vmax = vmaxq_f32(vmax, vmaxq_f32(a, b));
+            s0 = vmlaq_f32(s0, a, a);
+            s1 = vmlaq_f32(s1, b, b);
+        }
+        float t[4];
+        vst1q_f32(t, vmin);
+        mn = qMin(qMin(t[0], t[1]), qMin(t[2], t[3]));
+        vst1q_f32(t, vmax);
+        mx = qMax(qMax(t[0], t[1]), qMax(t[2], t[3]));
+        vst1q_f32(t, vaddq_f32(s0, s1));
+        sum = (double)t[0] + t[1] + t[2] + t[3];
+    }
+#endif
+    for (; i < n; ++i) {
+        const float v = p[i];
+        mn = qMin(mn, v);
+        mx = qMax(mx, v);
+        sum += v*v;
+    }
+    *pmin = mn;
+    *pmax = mx;
+    return sum;
+}
+
+// partial result of a bucket. a bucket on the boundary of 2 ranges is filled by 2 workers
+struct Accumulator {
+    Accumulator() : min(1.0f), max(-1.0f), sum(0), count(0) {}
+    void merge(const Accumulator& other) {
+        if (!other.count)
+            return;
+        min = qMin(min, other.min);
+        max = qMax(max, other.max);
+        sum += other.sum;
+        count += other.count;
+    }
+    float min, max;
+    double sum;
+    qint64 count; //values, i.e. samples*channels
+};
+
+class AudioWaveformPrivate : public DPtrPrivate<AudioWaveform>
+{
+public:
+    AudioWaveformPrivate()
+        : bucket_size(256)
+        , sample_rate(0)
+        , channels(0)
+        , samples(0)
+        , ready(false)
+        , cancelled(false)
+        , running(false)
+        , pending(0)
+        , total_samples(0)
+        , failed(false)
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+        cache_dir = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#else
+        cache_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#endif
+        if (cache_dir.isEmpty())
+            cache_dir = qApp->applicationDirPath() + "/cache";
+        cache_dir += "/waveform";
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+    }
+    QString cacheFile() const {
+        if (cache_dir.isEmpty())
+            return QString();
+        QFileInfo fi(file);
+        if (!fi.isFile())
+            return QString();
+        QByteArray key = fi.absoluteFilePath().toUtf8();
+        key += '/' + QByteArray::number(fi.size());
+        key += '/' + QByteArray::number(fi.lastModified().toMSecsSinceEpoch());
+        key += '/' + QByteArray::number(bucket_size);
+        return cache_dir + "/" + QCryptographicHash::hash(key, QCryptographicHash::Md5).toHex() + ".wf";
+    }
+    bool loadCache() {
+        QFile f(cacheFile());
+        if (f.fileName().isEmpty() || !f.open(QIODevice::ReadOnly))
+            return false;
+        QDataStream ds(&f);
+        quint32 magic = 0, version = 0, count = 0;
+        qint32 rate = 0, chs = 0, bs = 0;
+        qint64 n = 0;
+        ds >> magic >> version;
+        if (magic != kCacheMagic || version != kCacheVersion)
+            return false;
+        ds >> rate >> chs >> bs >> n >> count;
+        if (ds.status() != QDataStream::Ok || bs != bucket_size || rate <= 0 || chs <= 0)
+            return false;
+        // min, max: [-1, 1] => qint16. rms: [0, 1] => quint16
+        QVector<AudioWaveform::Peak> base(count);
+        for (quint32 i = 0; i < count; ++i) {
+            qint16 mn, mx;
+            quint16 rms;
+            ds >> mn >> mx >> rms;
+            base[i].min = float(mn)/32767.0f;
+            base[i].max = float(mx)/32767.0f;
+            base[i].rms = float(rms)/65535.0f;
+        }
+        if (ds.status() != QDataStream::Ok) {
+            qWarning("AudioWaveform: corrupt cache '%s'", qPrintable(f.fileName()));
+            return false;
+        }
+        sample_rate = rate;
+        channels = chs;
+        samples = n;
+        buildLevels(base);
+        return true;
+    }
+    void saveCache() {
+        const QString path(cacheFile());
+        if (path.isEmpty() || levels.isEmpty())
+            return;
+        if (!QDir().mkpath(cache_dir)) {
+            qWarning("AudioWaveform: failed to create cache dir '%s'", qPrintable(cache_dir));
+            return;
+        }
+        QFile f(path);
+        if (!f.open(QIODevice::WriteOnly)) {
+            qWarning("AudioWaveform: failed to write cache '%s'", qPrintable(path));
+            return;
+        }
+        const QVector<AudioWaveform::Peak>& base = levels.first();
+        QDataStream ds(&f);
+        ds << kCacheMagic << kCacheVersion << qint32(sample_rate) << qint32(channels)
+           << qint32(bucket_size) << qint64(samples) << quint32(base.size());
+        for (int i = 0; i < base.size(); ++i) {
+            ds << qint16(qBound(-1.0f, base[i].min, 1.0f)*32767.0f)
+               << qint16(qBound(-1.0f, base[i].max, 1.0f)*32767.0f)
+               << quint16(qBound(0.0f, base[i].rms, 1.0f)*65535.0f);
+        }
+    }
+    // level n+1 is 2 buckets of level n merged
+    void buildLevels(const QVector<AudioWaveform::Peak>& base) {
+        levels.clear();
+        levels.append(base);
+        while (levels.last().size() > 1) {
+            const QVector<AudioWaveform::Peak>& src = levels.last();
+            QVector<AudioWaveform::Peak> dst((src.size() + 1)/2);
+            for (int i = 0; i < dst.size(); ++i) {
+                const AudioWaveform::Peak& a = src[2*i];
+                if (2*i + 1 >= src.size()) {
+                    dst[i] = a;
+                    continue;
+                }
+                const AudioWaveform::Peak& b = src[2*i + 1];
+                dst[i].min = qMin(a.min, b.min);
+                dst[i].max = qMax(a.max, b.max);
+                dst[i].rms = qSqrt((a.rms*a.rms + b.rms*b.rms)*0.5f);
+            }
+            levels.append(dst);
+        }
+    }
+    // called by the last worker
+    void finish() {
+        qint64 last = buckets.size();
+        while (last > 0 && !buckets[last - 1].count)
+            --last;
+        QVector<AudioWaveform::Peak> base(last);
+        for (int i = 0; i < last; ++i) {
+            const Accumulator& a = buckets[i];
+            if (!a.count) {
+                base[i].min = base[i].max = base[i].rms = 0;
+                continue;
+            }
+            base[i].min = a.min;
+            base[i].max = a.max;
+            base[i].rms = qSqrt(a.sum/double(a.count));
+        }
+        buckets.clear();
+        buildLevels(base);
+        saveCache();
+    }
+
+    QString file;
+    QString cache_dir;
+    int bucket_size;
+    int sample_rate;
+    int channels;
+    qint64 samples;
+    QVector<QVector<AudioWaveform::Peak> > levels;
+    bool ready;
+
+    QThreadPool pool;
+    volatile bool cancelled;
+    // protected by mutex
+    QMutex mutex;
+    bool running;
+    int pending;
+    qint64 total_samples; //0 if unknown
+    QVector<qint64> done; //samples done by each worker
+    QVector<Accumulator> buckets;
+    bool failed;
+};
+
+class WaveformTask : public QRunnable
+{
+public:
+    WaveformTask(AudioWaveform *wf, int index, qint64 start = 0, qint64 end = -1)
+        : wf(wf)
+        , index(index)
+        , start_ms(start)
+        , end_ms(end)
+        , first_bucket(0)
+        , end_pos(0)
+    {
+        setAutoDelete(true);
+    }
+    virtual void run() {
+        AVError e;
+        if (!decode(&e)) {
+            AudioWaveformPrivate& d = wf->d_func();
+            QMutexLocker lock(&d.mutex);
+            Q_UNUSED(lock);
+            d.failed = true;
+            if (!d.cancelled)
+                QMetaObject::invokeMethod(wf, "error", Qt::QueuedConnection, Q_ARG(QtAV::AVError, e));
+        }
+        done();
+    }
+
+private:
+    // the 1st worker splits the file into ranges and starts the others
+    void split(AVDemuxer& demuxer) {
+        AudioWaveformPrivate& d = wf->d_func();
+        const qint64 duration = demuxer.duration();
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        if (duration > 0) {
+            d.total_samples = duration*qint64(d.sample_rate)/1000LL;
+            d.buckets.resize(d.total_samples/d.bucket_size + 1);
+        }
+        int n = 1;
+        if (duration > 0 && demuxer.isSeekable() && QFileInfo(d.file).isFile())
+            n = qBound<qint64>(1, duration/kMinRangeDuration, d.pool.maxThreadCount());
+        d.done.resize(n);
+        if (n == 1)
+            return;
+        const qint64 range = duration/n;
+        end_ms = range;
+        for (int i = 1; i < n; ++i) {
+            d.pending++;
+            d.pool.start(new WaveformTask(wf, i, range*i, i == n - 1 ? -1 : range*(i + 1)));
+        }
+    }
+    bool decode(AVError *e) {
+        AudioWaveformPrivate& d = wf->d_func();
+        AVDemuxer demuxer;
+        if (!demuxer.loadFile(d.file)) {
+            *e = AVError(AVError::OpenError);
+            return false;
+        }
+        const int stream = demuxer.audioStream();
+        AVCodecContext *codec_ctx = demuxer.audioCodecContext();
+        if (stream < 0 || !codec_ctx) {
+            *e = AVError(AVError::StreamNotFound);
+            return false;
+        }
+        demuxer.discardStreamsExcept(QList<int>() << stream);
+        AudioDecoder dec;
+        dec.setCodecContext(codec_ctx);
+        if (!dec.open()) {
+            *e = AVError(AVError::OpenCodecError);
+            return false;
+        }
+        const int rate = codec_ctx->sample_rate;
+        const int chs = codec_ctx->channels;
+        if (rate <= 0 || chs <= 0) {
+            *e = AVError(AVError::OpenCodecError);
+            return false;
+        }
+        AudioFormat fmt;
+        fmt.setSampleFormat(AudioFormat::SampleFormat_Float);
+        fmt.setSampleRate(rate);
+        fmt.setChannels(chs);
+        if (dec.resampler()) {
+            dec.resampler()->setOutAudioFormat(fmt);
+            dec.resampler()->inAudioFormat().setSampleFormatFFmpeg(codec_ctx->sample_fmt);
+            dec.resampler()->inAudioFormat().setSampleRate(rate);
+            dec.resampler()->inAudioFormat().setChannels(chs);
+            dec.resampler()->inAudioFormat().setChannelLayoutFFmpeg(codec_ctx->channel_layout);
+        }
+        dec.prepare();
+        if (index == 0) {
+            d.sample_rate = rate;
+            d.channels = chs;
+            split(demuxer);
+        } else if (start_ms > 0 && !demuxer.seek(start_ms)) {
+            *e = AVError(AVError::SeekError);
+            return false;
+        }
+        const qreal start_time = qMax<qint64>(0, demuxer.startTimeUs())/qreal(AV_TIME_BASE);
+        const qint64 s0 = start_ms*qint64(rate)/1000LL;
+        const qint64 s1 = end_ms < 0 ? Q_INT64_C(0x7fffffffffffffff) : end_ms*qint64(rate)/1000LL;
+        qint64 pos = -1;
+        int errors = 0;
+        QElapsedTimer timer;
+        timer.start();
+        while (!d.cancelled && pos < s1) {
+            if (!demuxer.readFrame()) {
+                if (demuxer.atEnd() || ++errors > kMaxReadErrors)
+                    break;
+                continue;
+            }
+            errors = 0;
+            Packet *pkt = demuxer.packet();
+            if (pkt->isEnd())
+                break;
+            if (demuxer.stream() != stream)
+                continue;
+            // follow the decoded samples, resync only if the timestamps jump
+            const qint64 pts_pos = qint64((pkt->pts - start_time)*qreal(rate) + 0.5);
+            if (pos < 0 || qAbs(pts_pos - pos) > rate/10)
+                pos = pts_pos;
+            QByteArray data(pkt->data);
+            while (!data.isEmpty() && !d.cancelled) {
+                if (!dec.decode(data))
+                    break;
+                const QByteArray decoded(dec.data());
+                const int n = decoded.size()/(chs*sizeof(float));
+                accumulate((const float*)decoded.constData(), n, chs, pos, s0, s1);
+                pos += n;
+                const int undecoded = dec.undecodedSize();
+                if (undecoded <= 0)
+                    break;
+                data.remove(0, data.size() - undecoded);
+            }
+            if (timer.elapsed() > 500) {
+                timer.restart();
+                reportProgress(qMax<qint64>(0, qMin(pos, s1) - s0));
+            }
+        }
+        return true;
+    }
+    void accumulate(const float *data, int n, int chs, qint64 pos, qint64 s0, qint64 s1) {
+        if (pos < s0) {
+            const qint64 skip = qMin<qint64>(n, s0 - pos);
+            data += skip*chs;
+            n -= skip;
+            pos += skip;
+        }
+        n = qMin<qint64>(n, s1 - pos);
+        const int bs = wf->d_func().bucket_size;
+        while (n > 0) {
+            const qint64 b = pos/bs;
+            const int count = qMin<qint64>(n, bs - pos%bs);
+            if (buckets.isEmpty())
+                first_bucket = b;
+            int i = b - first_bucket;
+            if (i < 0) { //timestamps jump back
+                buckets.insert(0, -i, Accumulator());
+                first_bucket = b;
+                i = 0;
+            }
+            if (i >= buckets.size())
+                buckets.resize(i + 1);
+            Accumulator& a = buckets[i];
+            a.sum += reduce(data, count*chs, &a.min, &a.max);
+            a.count += count*chs;
+            data += count*chs;
+            n -= count;
+            pos += count;
+        }
+        end_pos = qMax(end_pos, pos);
+    }
+    void reportProgress(qint64 samples) {
+        AudioWaveformPrivate& d = wf->d_func();
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.done[index] = samples;
+        if (d.total_samples <= 0 || d.cancelled)
+            return;
+        qint64 s = 0;
+        foreach (qint64 v, d.done) {
+            s += v;
+        }
+        QMetaObject::invokeMethod(wf, "progress", Qt::QueuedConnection
+                                  , Q_ARG(qreal, qMin<qreal>(1.0, qreal(s)/qreal(d.total_samples))));
+    }
+    // merge the buckets. the last worker builds the levels
+    void done() {
+        AudioWaveformPrivate& d = wf->d_func();
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        if (!buckets.isEmpty()) {
+            const int end = first_bucket + buckets.size();
+            if (end > d.buckets.size())
+                d.buckets.resize(end);
+            for (int i = 0; i < buckets.size(); ++i) {
+                d.buckets[first_bucket + i].merge(buckets[i]);
+            }
+            buckets.clear();
+        }
+        d.samples = qMax(d.samples, end_pos);
+        if (--d.pending > 0)
+            return;
+        if (!d.cancelled && !d.failed) {
+            d.finish();
+            d.ready = true;
+            QMetaObject::invokeMethod(wf, "progress", Qt::QueuedConnection, Q_ARG(qreal, 1.0));
+            QMetaObject::invokeMethod(wf, "ready", Qt::QueuedConnection);
+        }
+        d.buckets.clear();
+        d.running = false;
+    }
+
+    AudioWaveform *wf;
+    int index;
+    qint64 start_ms, end_ms;
+    QVector<Accumulator> buckets;
+    qint64 first_bucket;
+    qint64 end_pos;
+};
+
+AudioWaveform::AudioWaveform(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<QtAV::AVError>("QtAV::AVError");
+}
+
+AudioWaveform::~AudioWaveform()
+{
+    cancel();
+}
+
+void AudioWaveform::setFile(const QString &file)
+{
+    DPTR_D(AudioWaveform);
+    if (d.file == file)
+        return;
+    cancel();
+    d.file = file;
+    d.ready = false;
+    d.levels.clear();
+}
+
+QString AudioWaveform::file() const
+{
+    return d_func().file;
+}
+
+void AudioWaveform::setCacheDir(const QString &dir)
+{
+    d_func().cache_dir = dir;
+}
+
+QString AudioWaveform::cacheDir() const
+{
+    return d_func().cache_dir;
+}
+
+void AudioWaveform::setBucketSize(int samples)
+{
+    if (samples <= 0) {
+        qWarning("AudioWaveform: invalid bucket size %d", samples);
+        return;
+    }
+    d_func().bucket_size = samples;
+}
+
+void AudioWaveform::setThreadCount(int count)
+{
+    d_func().pool.setMaxThreadCount(qMax(1, count));
+}
+
+int AudioWaveform::threadCount() const
+{
+    return d_func().pool.maxThreadCount();
+}
+
+bool AudioWaveform::start()
+{
+    DPTR_D(AudioWaveform);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.running) {
+        qWarning("AudioWaveform is running");
+        return false;
+    }
+    d.ready = false;
+    d.levels.clear();
+    d.samples = 0;
+    if (d.loadCache()) {
+        qDebug("AudioWaveform: cache loaded for %s", qPrintable(d.file));
+        d.ready = true;
+        QMetaObject::invokeMethod(this, "progress", Qt::QueuedConnection, Q_ARG(qreal, 1.0));
+        QMetaObject::invokeMethod(this, "ready", Qt::QueuedConnection);
+        return true;
+    }
+    d.cancelled = false;
+    d.failed = false;
+    d.running = true;
+    d.pending = 1;
+    d.total_samples = 0;
+    d.done.clear();
+    d.buckets.clear();
+    d.pool.start(new WaveformTask(this, 0));
+    return true;
+}
+
+void AudioWaveform::cancel()
+{
+    DPTR_D(AudioWaveform);
+    d.cancelled = true;
+    d.pool.waitForDone();
+}
+
+bool AudioWaveform::isRunning() const
+{
+    DPTR_D(const AudioWaveform);
+    QMutexLocker lock(const_cast<QMutex*>(&d.mutex));
+    Q_UNUSED(lock);
+    return d.running;
+}
+
+bool AudioWaveform::isReady() const
+{
+    return d_func().ready;
+}
+
+int AudioWaveform::sampleRate() const
+{
+    return d_func().sample_rate;
+}
+
+int AudioWaveform::channels() const
+{
+    return d_func().channels;
+}
+
+qint64 AudioWaveform::samples() const
+{
+    return d_func().samples;
+}
+
+qint64 AudioWaveform::duration() const
+{
+    DPTR_D(const AudioWaveform);
+    if (d.sample_rate <= 0)
+        return 0;
+    return d.samples*1000LL/qint64(d.sample_rate);
+}
+
+int AudioWaveform::levelCount() const
+{
+    DPTR_D(const AudioWaveform);
+    return d.ready ? d.levels.size() : 0;
+}
+
+int AudioWaveform::bucketSize(int level) const
+{
+    return d_func().bucket_size << level;
+}
+
+QVector<AudioWaveform::Peak> AudioWaveform::peaks(int level) const
+{
+    DPTR_D(const AudioWaveform);
+    if (!d.ready || level < 0 || level >= d.levels.size())
+        return QVector<Peak>();
+    return d.levels[level];
+}
+
+int AudioWaveform::levelForBuckets(int count) const
+{
+    DPTR_D(const AudioWaveform);
+    if (!d.ready)
+        return 0;
+    int level = 0;
+    while (level + 1 < d.levels.size() && d.levels[level + 1].size() >= count)
+        ++level;
+    return level;
+}
+
+} //namespace QtAV
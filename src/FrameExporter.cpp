@@ -0,0 +1,464 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/FrameExporter.h>
+#include <QtAV/FrameUtils.h>
+#include <QtAV/ImageConverter.h>
+#include <QtAV/JpegEncoder.h>
+#include <QtAV/VideoFrame.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+#include <QtGui/QImage>
+
+namespace QtAV {
+
+// luma thumbnail compared for scene changes
+static const int kSceneWidth = 64;
+static const int kSceneHeight = 36;
+
+class ExportTask
+{
+public:
+    ExportTask() : index(0), pts(0), bytes(0) {}
+    int index;
+    qreal pts;
+    qint64 bytes;
+    VideoFrame frame;
+};
+
+class ExportResult
+{
+public:
+    ExportResult() : pts(0), ok(false) {}
+    qreal pts;
+    QString file; //relative to the output dir
+    bool ok;
+};
+
+// runs the pending tasks in the pool
+class ExportWorker : public QRunnable
+{
+public:
+    ExportWorker(FrameExporter *e) : exporter(e) {
+        setAutoDelete(true);
+    }
+    virtual void run();
+private:
+    FrameExporter *exporter;
+};
+
+class FrameExporterPrivate : public DPtrPrivate<FrameExporter>
+{
+public:
+    FrameExporterPrivate()
+        : mode(FrameExporter::EveryNthFrame)
+        , interval(1)
+        , scene_threshold(30)
+        , format(FrameExporter::Jpeg)
+        , quality(-1)
+        , prefix("frame_")
+        , memory_budget(256*1024*1024)
+        , unthrottled(true)
+        , running(false)
+        , frame_count(0)
+        , next_index(0)
+        , scene_conv(0)
+        , in_flight(0)
+        , workers(0)
+        , manifest_index(0)
+        , exported(0)
+    {
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+    }
+    ~FrameExporterPrivate() {
+        if (scene_conv) {
+            delete scene_conv;
+            scene_conv = 0;
+        }
+    }
+    // called in the video thread. the thumbnail is kept if it's a new scene
+    bool isSceneChange(const VideoFrame& frame);
+    QString fileName(int index) const;
+    bool write(const VideoFrame& frame, const QString& path, JpegEncoder *encoder);
+    // called with mutex locked. write the manifest lines in index order
+    void finishTask(int index, const ExportResult& result);
+
+    FrameExporter::Mode mode;
+    int interval;
+    int scene_threshold;
+    FrameExporter::Format format;
+    int quality;
+    QSize output_size;
+    QString prefix;
+    qint64 memory_budget;
+    bool unthrottled;
+    volatile bool running;
+    QString dir;
+    // used in the video thread
+    int frame_count;
+    int next_index;
+    ImageConverter *scene_conv;
+    QByteArray last_thumb;
+    // protected by mutex
+    QMutex mutex;
+    QWaitCondition cond;
+    QQueue<ExportTask> pending;
+    qint64 in_flight; //bytes of the frames in pending and being encoded
+    int workers;
+    QMap<int, ExportResult> done; //finished out of order
+    int manifest_index;
+    int exported;
+    QFile manifest;
+    QThreadPool pool;
+};
+
+bool FrameExporterPrivate::isSceneChange(const VideoFrame &frame)
+{
+    const VideoFrame gray(convertFrame(frame, QTAV_PIX_FMT_C(GRAY8), QSize(kSceneWidth, kSceneHeight), scene_conv));
+    if (!gray.isValid())
+        return false;
+    const quint8 *luma = gray.bits(0);
+    const int stride = gray.bytesPerLine(0);
+    QByteArray thumb(kSceneWidth*kSceneHeight, 0);
+    for (int y = 0; y < kSceneHeight; ++y)
+        memcpy(thumb.data() + y*kSceneWidth, luma + y*stride, kSceneWidth);
+    if (last_thumb.isEmpty()) {
+        last_thumb = thumb;
+        return true;
+    }
+    const uchar *a = (const uchar*)thumb.constData();
+    const uchar *b = (const uchar*)last_thumb.constData();
+    qint64 diff = 0;
+    for (int i = 0; i < thumb.size(); ++i)
+        diff += qAbs(int(a[i]) - int(b[i]));
+    if (diff < qint64(scene_threshold)*thumb.size())
+        return false;
+    last_thumb = thumb;
+    return true;
+}
+
+QString FrameExporterPrivate::fileName(int index) const
+{
+    static const char* ext[] = { "jpg", "png", "yuv" };
+    return QString("%1%2.%3").arg(prefix).arg(index, 6, 10, QChar('0')).arg(ext[format]);
+}
+
+bool FrameExporterPrivate::write(const VideoFrame &frame, const QString &path, JpegEncoder *encoder)
+{
+    const QSize size(scaledFrameSize(frame.size(), output_size));
+    ImageConverter *&conv = encoder->converter();
+    QFile file(path);
+    if (format == FrameExporter::Jpeg) {
+        VideoFrame f(frame);
+        if (size != frame.size())
+            f = convertFrame(frame, QTAV_PIX_FMT_C(YUVJ420P), size, conv);
+        const QByteArray data(encoder->encode(f, quality));
+        return !data.isEmpty() && file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+    }
+    if (format == FrameExporter::Png) {
+        const VideoFrame f(convertFrame(frame, QTAV_PIX_FMT_C(RGB32), size, conv));
+        if (!f.isValid())
+            return false;
+        const QImage image(f.bits(0), f.width(), f.height(), f.bytesPerLine(0), QImage::Format_RGB32);
+        return image.save(path, "PNG", quality);
+    }
+    VideoFrame f(frame);
+    if (size != frame.size() || frame.pixelFormatFFmpeg() != QTAV_PIX_FMT_C(YUV420P))
+        f = convertFrame(frame, QTAV_PIX_FMT_C(YUV420P), size, conv);
+    if (!f.isValid() || !file.open(QIODevice::WriteOnly))
+        return false;
+    for (int p = 0; p < 3; ++p) {
+        const int w = p == 0 ? f.width() : (f.width() + 1)/2;
+        const int h = p == 0 ? f.height() : (f.height() + 1)/2;
+        const uchar *src = f.bits(p);
+        for (int y = 0; y < h; ++y) {
+            if (file.write((const char*)src, w) != w)
+                return false;
+            src += f.bytesPerLine(p);
+        }
+    }
+    return true;
+}
+
+void FrameExporterPrivate::finishTask(int index, const ExportResult &result)
+{
+    done.insert(index, result);
+    while (done.contains(manifest_index)) {
+        const ExportResult r(done.take(manifest_index));
+        if (r.ok) {
+            ++exported;
+            manifest.write(QString("%1,%2,%3\n").arg(manifest_index).arg(r.pts, 0, 'f', 6).arg(r.file).toUtf8());
+        } else {
+            qWarning("FrameExporter: failed to write frame %d", manifest_index);
+        }
+        ++manifest_index;
+    }
+}
+
+void ExportWorker::run()
+{
+    FrameExporterPrivate &d = exporter->d_func();
+    JpegEncoder encoder;
+    forever {
+        ExportTask task;
+        {
+            QMutexLocker lock(&d.mutex);
+            Q_UNUSED(lock);
+            if (d.pending.isEmpty()) {
+                d.workers--;
+                d.cond.wakeAll();
+                return;
+            }
+            task = d.pending.dequeue();
+        }
+        ExportResult result;
+        result.pts = task.pts;
+        result.file = d.fileName(task.index);
+        result.ok = d.write(task.frame, d.dir + "/" + result.file, &encoder);
+        task.frame = VideoFrame();
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.in_flight -= task.bytes;
+        d.finishTask(task.index, result);
+        d.cond.wakeAll();
+    }
+}
+
+FrameExporter::FrameExporter(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FrameExporter::~FrameExporter()
+{
+    stop();
+}
+
+void FrameExporter::setMode(Mode mode)
+{
+    d_func().mode = mode;
+}
+
+FrameExporter::Mode FrameExporter::mode() const
+{
+    return d_func().mode;
+}
+
+void FrameExporter::setInterval(int n)
+{
+    d_func().interval = qMax(n, 1);
+}
+
+int FrameExporter::interval() const
+{
+    return d_func().interval;
+}
+
+void FrameExporter::setSceneThreshold(int threshold)
+{
+    d_func().scene_threshold = qBound(0, threshold, 255);
+}
+
+int FrameExporter::sceneThreshold() const
+{
+    return d_func().scene_threshold;
+}
+
+void FrameExporter::setFormat(Format format)
+{
+    d_func().format = format;
+}
+
+FrameExporter::Format FrameExporter::format() const
+{
+    return d_func().format;
+}
+
+void FrameExporter::setQuality(int quality)
+{
+    d_func().quality = quality;
+}
+
+int FrameExporter::quality() const
+{
+    return d_func().quality;
+}
+
+void FrameExporter::setOutputSize(const QSize &size)
+{
+    d_func().output_size = size;
+}
+
+QSize FrameExporter::outputSize() const
+{
+    return d_func().output_size;
+}
+
+void FrameExporter::setNamePrefix(const QString &prefix)
+{
+    d_func().prefix = prefix;
+}
+
+QString FrameExporter::namePrefix() const
+{
+    return d_func().prefix;
+}
+
+void FrameExporter::setThreadCount(int count)
+{
+    d_func().pool.setMaxThreadCount(qMax(count, 1));
+}
+
+int FrameExporter::threadCount() const
+{
+    return d_func().pool.maxThreadCount();
+}
+
+void FrameExporter::setMemoryBudget(qint64 bytes)
+{
+    DPTR_D(FrameExporter);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.memory_budget = qMax<qint64>(bytes, 0);
+    d.cond.wakeAll();
+}
+
+qint64 FrameExporter::memoryBudget() const
+{
+    return d_func().memory_budget;
+}
+
+void FrameExporter::setUnthrottled(bool value)
+{
+    d_func().unthrottled = value;
+}
+
+bool FrameExporter::isUnthrottled() const
+{
+    return d_func().unthrottled;
+}
+
+bool FrameExporter::start(const QString &dir)
+{
+    DPTR_D(FrameExporter);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.running) {
+        qWarning("FrameExporter: export is running");
+        return false;
+    }
+    if (!QDir(dir).exists() && !QDir().mkpath(dir)) {
+        qWarning("FrameExporter: failed to create dir %s", qPrintable(dir));
+        return false;
+    }
+    d.manifest.setFileName(dir + "/manifest.csv");
+    if (!d.manifest.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning("FrameExporter: failed to open %s", qPrintable(d.manifest.fileName()));
+        return false;
+    }
+    d.manifest.write("index,pts,file\n");
+    d.dir = dir;
+    d.frame_count = 0;
+    d.next_index = 0;
+    d.last_thumb.clear();
+    d.in_flight = 0;
+    d.done.clear();
+    d.manifest_index = 0;
+    d.exported = 0;
+    d.running = true;
+    return true;
+}
+
+void FrameExporter::stop()
+{
+    DPTR_D(FrameExporter);
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        if (!d.running)
+            return;
+        d.running = false;
+        d.cond.wakeAll();
+    }
+    // the pending frames are still written
+    d.pool.waitForDone();
+    int count = 0;
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.manifest.close();
+        count = d.exported;
+    }
+    qDebug("FrameExporter: %d frames exported to %s", count, qPrintable(d.dir));
+    QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection, Q_ARG(int, count));
+}
+
+bool FrameExporter::isRunning() const
+{
+    return d_func().running;
+}
+
+int FrameExporter::exportedCount() const
+{
+    return d_func().exported;
+}
+
+void FrameExporter::process(const VideoFrame &frame, qreal pts)
+{
+    DPTR_D(FrameExporter);
+    if (!d.running || !frame.isValid())
+        return;
+    if (d.mode == EveryNthFrame) {
+        if (d.frame_count++ % d.interval)
+            return;
+    } else if (!d.isSceneChange(frame)) {
+        return;
+    }
+    ExportTask task;
+    task.pts = pts;
+    // the decoder reuses the buffer
+    task.frame = frame.clone();
+    task.bytes = task.frame.frameData().size();
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    // at least 1 frame in flight
+    while (d.running && d.in_flight > 0 && d.in_flight + task.bytes > d.memory_budget)
+        d.cond.wait(&d.mutex);
+    if (!d.running)
+        return;
+    task.index = d.next_index++;
+    d.in_flight += task.bytes;
+    d.pending.enqueue(task);
+    if (d.workers < d.pool.maxThreadCount()) {
+        d.workers++;
+        d.pool.start(new ExportWorker(this));
+    }
+}
+
+} //namespace QtAV
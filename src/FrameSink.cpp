@@ -0,0 +1,331 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/FrameSink.h>
+#include <QtAV/FrameUtils.h>
+#include <QtAV/ImageConverter.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+
+class SinkThread : public QThread
+{
+public:
+    SinkThread(FrameSink *s) : sink(s) {}
+protected:
+    virtual void run();
+private:
+    FrameSink *sink;
+};
+
+class FrameSinkPrivate : public DPtrPrivate<FrameSink>
+{
+public:
+    FrameSinkPrivate()
+        : enabled(true)
+        , closed(false)
+        , luma_only(false)
+        , push(false)
+        , queue(4, DropOldest)
+        , conv(0)
+        , thread(0)
+        , thread_done(false)
+    {}
+    ~FrameSinkPrivate() {
+        if (conv) {
+            delete conv;
+            conv = 0;
+        }
+    }
+    // the frame to queue. called in the video thread
+    VideoFrame copyFrame(const VideoFrame& frame);
+    void stopThread();
+    // called with mutex locked. a thread stopped in receive() is reaped and restarted
+    void startThread(FrameSink *sink);
+
+    volatile bool enabled;
+    volatile bool closed;
+    bool luma_only;
+    bool push;
+    QSize output_size;
+    // protected by mutex
+    mutable QMutex mutex;
+    QWaitCondition cond;
+    BoundedQueue<SinkFrame> queue;
+    // used in the video thread
+    ImageConverter *conv;
+    SinkThread *thread;
+    bool thread_done; // protected by mutex. the thread decided to exit
+};
+
+VideoFrame FrameSinkPrivate::copyFrame(const VideoFrame &frame)
+{
+    const int fffmt = luma_only ? QTAV_PIX_FMT_C(GRAY8) : frame.pixelFormatFFmpeg();
+    const QSize size(scaledFrameSize(frame.size(), output_size));
+    if (size == frame.size()) {
+        if (fffmt == frame.pixelFormatFFmpeg())
+            return frame.clone();
+        // plane 0 of planar yuv is luma
+        if (frame.format().isPlanar() && !frame.format().isRGB()) {
+            VideoFrame y(frame.width(), frame.height(), VideoFormat(fffmt));
+            y.setBits(QVector<uchar*>(1, const_cast<uchar*>(frame.bits(0))));
+            y.setBytesPerLine(QVector<int>(1, frame.bytesPerLine(0)));
+            return y.clone();
+        }
+    }
+    // the converter reuses the buffer
+    return convertFrame(frame, fffmt, size, conv).clone();
+}
+
+void FrameSinkPrivate::stopThread()
+{
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        push = false;
+        cond.wakeAll();
+    }
+    // can not wait for itself in receive(). it exits after receive()
+    if (!thread || QThread::currentThread() == thread)
+        return;
+    thread->wait();
+    delete thread;
+    thread = 0;
+}
+
+void FrameSinkPrivate::startThread(FrameSink *sink)
+{
+    if (thread && thread_done) {
+        thread->wait();
+        delete thread;
+        thread = 0;
+    }
+    if (thread)
+        return;
+    thread_done = false;
+    thread = new SinkThread(sink);
+    thread->start();
+}
+
+void SinkThread::run()
+{
+    FrameSinkPrivate &d = sink->d_func();
+    forever {
+        SinkFrame f;
+        {
+            QMutexLocker lock(&d.mutex);
+            Q_UNUSED(lock);
+            while (d.queue.isEmpty() && d.push && !d.closed)
+                d.cond.wait(&d.mutex);
+            if (!d.push || d.closed) {
+                d.thread_done = true;
+                return;
+            }
+            f = d.queue.dequeue();
+            d.cond.wakeAll();
+        }
+        sink->receive(f);
+    }
+}
+
+FrameSink::FrameSink()
+{
+}
+
+FrameSink::~FrameSink()
+{
+    close();
+}
+
+void FrameSink::setEnabled(bool enabled)
+{
+    d_func().enabled = enabled;
+}
+
+bool FrameSink::isEnabled() const
+{
+    return d_func().enabled;
+}
+
+void FrameSink::setCapacity(int frames)
+{
+    DPTR_D(FrameSink);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.queue.setCapacity(frames);
+    while (d.queue.size() > d.queue.capacity())
+        d.queue.dequeue();
+    d.cond.wakeAll();
+}
+
+int FrameSink::capacity() const
+{
+    return d_func().queue.capacity();
+}
+
+void FrameSink::setDropPolicy(DropPolicy policy)
+{
+    d_func().queue.setDropPolicy(policy);
+}
+
+DropPolicy FrameSink::dropPolicy() const
+{
+    return d_func().queue.dropPolicy();
+}
+
+void FrameSink::setOutputSize(const QSize &size)
+{
+    d_func().output_size = size;
+}
+
+QSize FrameSink::outputSize() const
+{
+    return d_func().output_size;
+}
+
+void FrameSink::setLumaOnly(bool value)
+{
+    d_func().luma_only = value;
+}
+
+bool FrameSink::isLumaOnly() const
+{
+    return d_func().luma_only;
+}
+
+void FrameSink::setPushMode(bool push)
+{
+    DPTR_D(FrameSink);
+    if (!push) {
+        d.stopThread();
+        return;
+    }
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.push = true;
+    if (d.closed)
+        return;
+    d.startThread(this);
+}
+
+bool FrameSink::isPushMode() const
+{
+    return d_func().push;
+}
+
+bool FrameSink::take(SinkFrame *frame, int timeout)
+{
+    DPTR_D(FrameSink);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    while (d.queue.isEmpty() && !d.closed) {
+        if (timeout < 0)
+            d.cond.wait(&d.mutex);
+        else if (!d.cond.wait(&d.mutex, timeout))
+            return false;
+    }
+    if (d.queue.isEmpty())
+        return false;
+    *frame = d.queue.dequeue();
+    d.cond.wakeAll();
+    return true;
+}
+
+int FrameSink::queuedCount() const
+{
+    const FrameSinkPrivate &d = d_func();
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.queue.size();
+}
+
+int FrameSink::droppedCount() const
+{
+    return d_func().queue.droppedCount();
+}
+
+void FrameSink::close()
+{
+    DPTR_D(FrameSink);
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.closed = true;
+        d.queue.clear();
+        d.cond.wakeAll();
+    }
+    if (d.thread && QThread::currentThread() != d.thread) {
+        d.thread->wait();
+        delete d.thread;
+        d.thread = 0;
+    }
+}
+
+void FrameSink::open()
+{
+    DPTR_D(FrameSink);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.closed = false;
+    if (d.push)
+        d.startThread(this);
+}
+
+bool FrameSink::isClosed() const
+{
+    return d_func().closed;
+}
+
+void FrameSink::put(const VideoFrame &frame, qreal pts, int stream)
+{
+    DPTR_D(FrameSink);
+    if (!d.enabled || d.closed || !frame.isValid())
+        return;
+    // drop before copying
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        if (d.queue.dropNewest())
+            return;
+    }
+    SinkFrame f;
+    f.frame = d.copyFrame(frame);
+    f.pts = pts;
+    f.stream = stream;
+    if (!f.frame.isValid()) {
+        qWarning("FrameSink: failed to copy the frame");
+        return;
+    }
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.queue.put(f, &d.mutex, &d.cond, &d.closed))
+        d.cond.wakeAll();
+}
+
+void FrameSink::receive(const SinkFrame &frame)
+{
+    Q_UNUSED(frame);
+}
+
+} //namespace QtAV
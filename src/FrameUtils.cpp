@@ -0,0 +1,71 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/FrameUtils.h>
+#include <QtAV/ImageConverter.h>
+#include <QtAV/ImageConverterTypes.h>
+#include <QtAV/VideoFrame.h>
+
+namespace QtAV {
+
+void framePlanes(const VideoFrame& frame, const quint8 *planes[4], int strides[4])
+{
+    for (int p = 0; p < 4; ++p) {
+        planes[p] = p < frame.planeCount() ? frame.bits(p) : 0;
+        strides[p] = p < frame.planeCount() ? frame.bytesPerLine(p) : 0;
+    }
+}
+
+QSize scaledFrameSize(const QSize &size, const QSize &outSize)
+{
+    int w = outSize.width();
+    int h = outSize.height();
+    if (w <= 0 && h <= 0)
+        return size;
+    if (w <= 0)
+        w = size.width()*h/qMax(size.height(), 1);
+    else if (h <= 0)
+        h = size.height()*w/qMax(size.width(), 1);
+    return QSize(qMax(w & ~1, 2), qMax(h & ~1, 2));
+}
+
+VideoFrame convertFrame(const VideoFrame &frame, int fffmt, const QSize &size, ImageConverter *&conv)
+{
+    if (!conv)
+        conv = ImageConverterFactory::create(ImageConverterId_FF);
+    if (!conv)
+        return VideoFrame();
+    const quint8 *planes[4];
+    int strides[4];
+    framePlanes(frame, planes, strides);
+    conv->setInFormat(frame.pixelFormatFFmpeg());
+    conv->setInSize(frame.width(), frame.height());
+    conv->setOutFormat(fffmt);
+    conv->setOutSize(size.width(), size.height());
+    if (!conv->convert(planes, strides))
+        return VideoFrame();
+    VideoFrame f(size.width(), size.height(), VideoFormat(fffmt));
+    f.setBits(conv->outPlanes());
+    f.setBytesPerLine(conv->outLineSizes());
+    return f;
+}
+
+} //namespace QtAV
@@ -0,0 +1,378 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include <QtAV/GOPCache.h>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/Packet.h>
+#include <QtAV/VideoDecoder.h>
+#include <QtAV/VideoDecoderTypes.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QtAlgorithms>
+#include <limits>
+
+namespace QtAV {
+
+static const qreal kEpsilon = 0.0001; //s
+static const int kMaxReadErrors = 64;
+static const int kMaxSeekRetries = 4;
+static const int kMaxDelayedFrames = 32;
+static const int kMaxRequests = 4;
+
+static qint64 frameBytes(const VideoFrame& frame)
+{
+    qint64 bytes = 0;
+    for (int i = 0; i < frame.planeCount(); ++i) {
+        const int h = i == 0 ? frame.height() : frame.format().chromaHeight(frame.height());
+        bytes += frame.bytesPerLine(i) * h;
+    }
+    return bytes;
+}
+
+GOPCache::GOPCache(QObject *parent)
+    : QThread(parent)
+    , cancelled(false)
+    , mem_limit(256LL*1024LL*1024LL)
+    , mem_used(0)
+    , current(0)
+{
+}
+
+GOPCache::~GOPCache()
+{
+    cancel();
+}
+
+void GOPCache::setFile(const QString &file)
+{
+    cancel();
+    clear();
+    media_file = file;
+    cancelled = false;
+}
+
+QString GOPCache::file() const
+{
+    return media_file;
+}
+
+void GOPCache::setMemoryLimit(qint64 bytes)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    mem_limit = bytes;
+    evict();
+}
+
+qint64 GOPCache::memoryLimit() const
+{
+    return mem_limit;
+}
+
+qint64 GOPCache::memoryUsage() const
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    return mem_used;
+}
+
+bool GOPCache::frameBefore(qreal pts, VideoFrame *frame, qreal *framePts)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    current = pts;
+    const int i = findGOP(pts - kEpsilon);
+    if (i < 0) {
+        request(pts - kEpsilon, true);
+        return false;
+    }
+    const GOP &gop = gops.at(i);
+    const int k = qLowerBound(gop.pts, pts - kEpsilon) - gop.pts.constBegin() - 1;
+    if (k < 0) // the beginning of the stream
+        return false;
+    *frame = gop.frames.at(k);
+    *framePts = gop.pts.at(k);
+    if (gop.start > 0 && findGOP(gop.start - kEpsilon) < 0)
+        request(gop.start - kEpsilon, false);
+    return true;
+}
+
+bool GOPCache::frameAfter(qreal pts, VideoFrame *frame, qreal *framePts)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    current = pts;
+    int i = findGOP(pts + kEpsilon);
+    if (i < 0) {
+        request(pts + kEpsilon, true);
+        return false;
+    }
+    int k = qUpperBound(gops.at(i).pts, pts + kEpsilon) - gops.at(i).pts.constBegin();
+    if (k >= gops.at(i).pts.size()) {
+        // the first frame of the next GOP
+        const qreal end = gops.at(i).end;
+        if (end == std::numeric_limits<qreal>::max())
+            return false;
+        i = findGOP(end);
+        if (i < 0) {
+            request(end, true);
+            return false;
+        }
+        if (gops.at(i).pts.isEmpty())
+            return false;
+        k = 0;
+    }
+    *frame = gops.at(i).frames.at(k);
+    *framePts = gops.at(i).pts.at(k);
+    return true;
+}
+
+void GOPCache::clear()
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    gops.clear();
+    requests.clear();
+    mem_used = 0;
+}
+
+void GOPCache::cancel()
+{
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        cancelled = true;
+        cond.wakeAll();
+    }
+    wait();
+}
+
+int GOPCache::findGOP(qreal pts) const
+{
+    for (int i = 0; i < gops.size(); ++i) {
+        if (gops.at(i).start <= pts && pts < gops.at(i).end)
+            return i;
+    }
+    return -1;
+}
+
+void GOPCache::request(qreal pts, bool urgent)
+{
+    for (int i = 0; i < requests.size(); ++i) {
+        if (qAbs(requests.at(i) - pts) < kEpsilon) {
+            if (!urgent)
+                return;
+            requests.removeAt(i);
+            break;
+        }
+    }
+    if (urgent)
+        requests.prepend(pts);
+    else
+        requests.append(pts);
+    while (requests.size() > kMaxRequests)
+        requests.removeLast();
+    cond.wakeAll();
+}
+
+void GOPCache::evict(qint64 reserved)
+{
+    // the GOP farthest from the current position first. the limit wins over the GOPs in use, but
+    // the last one is kept unless a GOP being decoded needs the memory
+    while (mem_used + reserved > mem_limit && gops.size() > (reserved > 0 ? 0 : 1)) {
+        int far = 0;
+        qreal far_distance = -1;
+        for (int i = 0; i < gops.size(); ++i) {
+            const GOP &gop = gops.at(i);
+            qreal distance = 0;
+            if (current < gop.start)
+                distance = gop.start - current;
+            else if (current >= gop.end)
+                distance = current - gop.end;
+            if (distance > far_distance) {
+                far_distance = distance;
+                far = i;
+            }
+        }
+        mem_used -= gops.at(far).bytes;
+        gops.removeAt(far);
+    }
+}
+
+void GOPCache::run()
+{
+    AVDemuxer demuxer;
+    if (!demuxer.loadFile(media_file))
+        return;
+    const int stream = demuxer.videoStream();
+    AVCodecContext *codec_ctx = demuxer.videoCodecContext();
+    if (stream < 0 || !codec_ctx) {
+        qWarning("GOPCache: no video stream");
+        return;
+    }
+    demuxer.discardStreamsExcept(QList<int>() << stream);
+    AVFormatContext *fmt_ctx = demuxer.formatContext();
+    VideoDecoder *dec = VideoDecoderFactory::create(VideoDecoderId_FFmpeg);
+    if (!dec)
+        return;
+    dec->setCodecContext(codec_ctx);
+    if (!dec->open()) {
+        qWarning("GOPCache: failed to open video decoder");
+        delete dec;
+        return;
+    }
+    dec->prepare();
+    while (!cancelled) {
+        qreal pos = 0;
+        qint64 budget = 0; //bytes the GOP being decoded can use
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            while (!cancelled && requests.isEmpty())
+                cond.wait(&mutex);
+            if (cancelled)
+                break;
+            pos = requests.takeFirst();
+            if (findGOP(pos) >= 0)
+                continue;
+            budget = mem_limit - mem_used;
+        }
+        GOP gop;
+        bool front_dropped = false;
+        qreal dropped_end = -1; //pts of the first frame dropped at the end
+        for (int retry = 0; retry < kMaxSeekRetries && !cancelled; ++retry) {
+            // AVDemuxer::seek() may seek forward. we need the key frame before pos
+            const qint64 upos = qMax<qint64>(0, (pos - qreal(retry))*qreal(AV_TIME_BASE));
+            int ret = av_seek_frame(fmt_ctx, -1, upos, AVSEEK_FLAG_BACKWARD);
+            if (ret < 0) {
+                qWarning("GOPCache: seek error: %s", av_err2str(ret));
+                break;
+            }
+            dec->flush();
+            gop = GOP();
+            gop.start = -1;
+            front_dropped = false;
+            dropped_end = -1;
+            QVector<qreal> pkt_pts; //packets of this GOP in decoding order
+            bool gop_end = false, eof = false;
+            int errors = 0, drain = 0;
+            int decoded = 0;
+            while (!cancelled && dropped_end < 0 && !(gop_end && decoded >= pkt_pts.size())) {
+                QByteArray data;
+                if (!eof) {
+                    if (!demuxer.readFrame()) {
+                        if (demuxer.atEnd() || ++errors > kMaxReadErrors)
+                            eof = true;
+                        continue;
+                    }
+                    errors = 0;
+                    const Packet *pkt = demuxer.packet();
+                    if (demuxer.stream() != stream)
+                        continue;
+                    if (gop.start < 0) {
+                        if (!pkt->hasKeyFrame)
+                            continue;
+                        gop.start = pkt->pts;
+                    } else if (!gop_end && pkt->hasKeyFrame && pkt->pts > gop.start) {
+                        gop_end = true;
+                        gop.end = pkt->pts;
+                    }
+                    if (!gop_end)
+                        pkt_pts.append(pkt->pts);
+                    data = pkt->data;
+                } else {
+                    if (gop.start < 0)
+                        break;
+                    if (!gop_end) {
+                        gop_end = true;
+                        gop.end = std::numeric_limits<qreal>::max();
+                    }
+                    // decode an empty packet to get the delayed frames
+                    if (++drain > kMaxDelayedFrames)
+                        break;
+                }
+                dec->resizeVideoFrame(0, 0);
+                if (!dec->decode(data))
+                    continue;
+                VideoFrame frame(dec->frame());
+                if (!frame.isValid() || decoded >= pkt_pts.size())
+                    continue;
+                frame = frame.clone();
+                // frames are in presentation order and packets are in decoding order
+                gop.pts.append(pkt_pts.at(decoded++));
+                gop.frames.append(frame);
+                gop.bytes += frameBytes(frame);
+                if (gop.bytes > budget) {
+                    QMutexLocker lock(&mutex);
+                    Q_UNUSED(lock);
+                    evict(gop.bytes);
+                    budget = mem_limit - mem_used;
+                }
+                // drop the frames farthest from pos. the later frames are farther after dropping the last one
+                while (gop.bytes > budget && gop.frames.size() > 1) {
+                    if (pos - gop.pts.first() > gop.pts.last() - pos) {
+                        gop.bytes -= frameBytes(gop.frames.first());
+                        gop.frames.remove(0);
+                        gop.pts.remove(0);
+                        front_dropped = true;
+                    } else {
+                        gop.bytes -= frameBytes(gop.frames.last());
+                        dropped_end = gop.pts.last();
+                        gop.frames.remove(gop.frames.size() - 1);
+                        gop.pts.remove(gop.pts.size() - 1);
+                    }
+                }
+            }
+            if (gop.start < 0)
+                break;
+            if (gop.start <= pos + kEpsilon)
+                break;
+            if (upos == 0) {
+                // no key frame before pos
+                gop.start = pos;
+                break;
+            }
+        }
+        if (cancelled || gop.start < 0 || gop.frames.isEmpty())
+            continue;
+        // only the kept frames are cached
+        if (front_dropped)
+            gop.start = qMax(gop.start, gop.pts.first());
+        if (dropped_end >= 0)
+            gop.end = dropped_end;
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        for (int i = gops.size() - 1; i >= 0; --i) {
+            if (gops.at(i).start < gop.end && gop.start < gops.at(i).end) {
+                mem_used -= gops.at(i).bytes;
+                gops.removeAt(i);
+            }
+        }
+        int i = 0;
+        while (i < gops.size() && gops.at(i).start < gop.start)
+            ++i;
+        gops.insert(i, gop);
+        mem_used += gop.bytes;
+        evict();
+    }
+    dec->close();
+    delete dec;
+}
+
+} //namespace QtAV
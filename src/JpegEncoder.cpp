@@ -0,0 +1,147 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/JpegEncoder.h>
+#include <QtAV/FrameUtils.h>
+#include <QtAV/ImageConverter.h>
+#include <QtAV/VideoFrame.h>
+#include <QtAV/QtAV_Compat.h>
+
+namespace QtAV {
+
+JpegEncoder::JpegEncoder()
+    : codec_ctx(0)
+    , frame(avcodec_alloc_frame())
+    , conv(0)
+{
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    close();
+    av_free(frame);
+    if (conv) {
+        delete conv;
+        conv = 0;
+    }
+}
+
+bool JpegEncoder::isJpegFormat(int fffmt)
+{
+    return fffmt == QTAV_PIX_FMT_C(YUVJ420P) || fffmt == QTAV_PIX_FMT_C(YUVJ422P) || fffmt == QTAV_PIX_FMT_C(YUVJ444P);
+}
+
+int JpegEncoder::jpegFormat(int fffmt)
+{
+    if (isJpegFormat(fffmt))
+        return fffmt;
+    // keep the chroma resolution
+    if (fffmt == QTAV_PIX_FMT_C(YUV422P))
+        return QTAV_PIX_FMT_C(YUVJ422P);
+    if (fffmt == QTAV_PIX_FMT_C(YUV444P))
+        return QTAV_PIX_FMT_C(YUVJ444P);
+    return QTAV_PIX_FMT_C(YUVJ420P);
+}
+
+ImageConverter*& JpegEncoder::converter()
+{
+    return conv;
+}
+
+void JpegEncoder::close()
+{
+    if (!codec_ctx)
+        return;
+    avcodec_close(codec_ctx);
+    av_free(codec_ctx);
+    codec_ctx = 0;
+}
+
+bool JpegEncoder::open(int width, int height, int fffmt, int quality)
+{
+    if (codec_ctx && codec_ctx->width == width && codec_ctx->height == height
+            && codec_ctx->pix_fmt == fffmt && codec_ctx->global_quality == quality)
+        return true;
+    close();
+    AVCodec *codec = avcodec_find_encoder(CODEC_ID_MJPEG);
+    if (!codec) {
+        qWarning("JpegEncoder: mjpeg encoder not found");
+        return false;
+    }
+    codec_ctx = avcodec_alloc_context3(codec);
+    codec_ctx->width = width;
+    codec_ctx->height = height;
+    codec_ctx->pix_fmt = (AVPixelFormat)fffmt;
+    codec_ctx->time_base.num = 1;
+    codec_ctx->time_base.den = 25;
+    codec_ctx->flags |= CODEC_FLAG_QSCALE;
+    codec_ctx->global_quality = quality;
+    int ret = avcodec_open2(codec_ctx, codec, NULL);
+    if (ret < 0) {
+        qWarning("JpegEncoder: open mjpeg encoder error: %s", av_err2str(ret));
+        av_free(codec_ctx);
+        codec_ctx = 0;
+        return false;
+    }
+    return true;
+}
+
+QByteArray JpegEncoder::encode(const VideoFrame &vf, int quality)
+{
+    if (!vf.isValid())
+        return QByteArray();
+    VideoFrame f(vf);
+    // mpeg range yuv is expanded to the full range of jpeg
+    if (!isJpegFormat(f.pixelFormatFFmpeg()))
+        f = convertFrame(vf, jpegFormat(vf.pixelFormatFFmpeg()), vf.size(), conv);
+    if (!f.isValid())
+        return QByteArray();
+    const int fffmt = f.pixelFormatFFmpeg();
+    const quint8 *planes[4];
+    int strides[4];
+    framePlanes(f, planes, strides);
+    // qscale 2(best)~31
+    const int qscale = quality < 0 ? 3 : 2 + (100 - qBound(0, quality, 100))*29/100;
+    if (!open(vf.width(), vf.height(), fffmt, qscale*FF_QP2LAMBDA))
+        return QByteArray();
+    avcodec_get_frame_defaults(frame);
+    for (int p = 0; p < 4; ++p) {
+        frame->data[p] = (uint8_t*)planes[p];
+        frame->linesize[p] = strides[p];
+    }
+    frame->quality = codec_ctx->global_quality;
+    frame->pts = 0;
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = 0;
+    pkt.size = 0;
+    int got = 0;
+    int ret = avcodec_encode_video2(codec_ctx, &pkt, frame, &got);
+    if (ret < 0 || !got) {
+        qWarning("JpegEncoder: encode error: %s", av_err2str(ret));
+        return QByteArray();
+    }
+    const QByteArray data((const char*)pkt.data, pkt.size);
+    av_free_packet(&pkt);
+    return data;
+}
+
+} //namespace QtAV
@@ -0,0 +1,272 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include <QtAV/KeyFrameIndex.h>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/Packet.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QtAlgorithms>
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#include <QtGui/QDesktopServices>
+#else
+#include <QtCore/QStandardPaths>
+#endif
+
+namespace QtAV {
+
+static const quint32 kCacheMagic = 0x514b4649; //QKFI
+static const quint32 kCacheVersion = 1;
+static const int kMaxReadErrors = 64;
+
+static bool entryLessThan(const KeyFrameIndex::Entry& e1, const KeyFrameIndex::Entry& e2)
+{
+    return e1.pts < e2.pts;
+}
+
+KeyFrameIndex::KeyFrameIndex()
+{
+}
+
+bool KeyFrameIndex::isEmpty() const
+{
+    return entries.isEmpty();
+}
+
+int KeyFrameIndex::size() const
+{
+    return entries.size();
+}
+
+void KeyFrameIndex::clear()
+{
+    entries.clear();
+}
+
+void KeyFrameIndex::append(const Entry &entry)
+{
+    entries.append(entry);
+}
+
+const KeyFrameIndex::Entry& KeyFrameIndex::at(int i) const
+{
+    return entries.at(i);
+}
+
+void KeyFrameIndex::sort()
+{
+    qStableSort(entries.begin(), entries.end(), entryLessThan);
+}
+
+bool KeyFrameIndex::find(qint64 pts, Entry *entry) const
+{
+    Entry e;
+    e.pts = pts;
+    // the 1st entry whose pts > the given pts
+    QVector<Entry>::const_iterator it = qUpperBound(entries.constBegin(), entries.constEnd(), e, entryLessThan);
+    if (it == entries.constBegin())
+        return false;
+    *entry = *(it - 1);
+    return true;
+}
+
+bool KeyFrameIndex::load(const QString &path, int stream)
+{
+    clear();
+    QFile f(path);
+    if (path.isEmpty() || !f.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream ds(&f);
+    quint32 magic = 0, version = 0, count = 0;
+    qint32 s = -1;
+    ds >> magic >> version >> s >> count;
+    if (magic != kCacheMagic || version != kCacheVersion || s != stream || ds.status() != QDataStream::Ok)
+        return false;
+    entries.resize(count);
+    for (quint32 i = 0; i < count; ++i) {
+        ds >> entries[i].pts >> entries[i].position >> entries[i].frame;
+    }
+    if (ds.status() != QDataStream::Ok) {
+        qWarning("KeyFrameIndex: corrupt cache '%s'", qPrintable(path));
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool KeyFrameIndex::save(const QString &path, int stream) const
+{
+    if (path.isEmpty())
+        return false;
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning("KeyFrameIndex: failed to write cache '%s'", qPrintable(path));
+        return false;
+    }
+    QDataStream ds(&f);
+    ds << kCacheMagic << kCacheVersion << qint32(stream) << quint32(entries.size());
+    foreach (const Entry& e, entries) {
+        ds << e.pts << e.position << e.frame;
+    }
+    return ds.status() == QDataStream::Ok;
+}
+
+QString KeyFrameIndex::cacheFile(const QString &mediaFile, const QString &dir)
+{
+    if (dir.isEmpty())
+        return QString();
+    QFileInfo fi(mediaFile);
+    if (!fi.isFile())
+        return QString();
+    QByteArray key = fi.absoluteFilePath().toUtf8();
+    key += '/' + QByteArray::number(fi.size());
+    key += '/' + QByteArray::number(fi.lastModified().toMSecsSinceEpoch());
+    return dir + "/" + QCryptographicHash::hash(key, QCryptographicHash::Md5).toHex() + ".kfi";
+}
+
+QString KeyFrameIndex::defaultCacheDir()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    QString dir = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#else
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#endif
+    if (dir.isEmpty())
+        dir = qApp->applicationDirPath() + "/cache";
+    return dir + "/keyframes";
+}
+
+KeyFrameIndexer::KeyFrameIndexer(QObject *parent)
+    : QThread(parent)
+    , cancelled(false)
+    , ready(false)
+    , cache_dir(KeyFrameIndex::defaultCacheDir())
+{
+}
+
+KeyFrameIndexer::~KeyFrameIndexer()
+{
+    cancel();
+}
+
+void KeyFrameIndexer::setFile(const QString &file)
+{
+    media_file = file;
+    cancelled = false;
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    ready = false;
+}
+
+QString KeyFrameIndexer::file() const
+{
+    return media_file;
+}
+
+void KeyFrameIndexer::setCacheDir(const QString &dir)
+{
+    cache_dir = dir;
+}
+
+QString KeyFrameIndexer::cacheDir() const
+{
+    return cache_dir;
+}
+
+void KeyFrameIndexer::cancel()
+{
+    cancelled = true;
+    wait();
+}
+
+bool KeyFrameIndexer::isReady() const
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    return ready;
+}
+
+const KeyFrameIndex& KeyFrameIndexer::index() const
+{
+    return idx;
+}
+
+void KeyFrameIndexer::run()
+{
+    idx.clear();
+    AVDemuxer demuxer;
+    if (!demuxer.loadFile(media_file))
+        return;
+    const int stream = demuxer.videoStream();
+    if (stream < 0) {
+        qDebug("KeyFrameIndexer: no video stream");
+        return;
+    }
+    const QString cache(KeyFrameIndex::cacheFile(media_file, cache_dir));
+    if (idx.load(cache, stream)) {
+        qDebug("KeyFrameIndexer: %d key frames loaded from cache", idx.size());
+    } else {
+        demuxer.discardStreamsExcept(QList<int>() << stream);
+        qint64 frame = 0;
+        int errors = 0;
+        while (!cancelled) {
+            if (!demuxer.readFrame()) {
+                if (demuxer.atEnd() || ++errors > kMaxReadErrors)
+                    break;
+                continue;
+            }
+            errors = 0;
+            const Packet *pkt = demuxer.packet();
+            if (pkt->isEnd())
+                break;
+            if (demuxer.stream() != stream)
+                continue;
+            if (pkt->hasKeyFrame && pkt->position >= 0) {
+                KeyFrameIndex::Entry e;
+                e.pts = qint64(pkt->pts*AV_TIME_BASE);
+                e.position = pkt->position;
+                e.frame = frame;
+                idx.append(e);
+            }
+            ++frame;
+        }
+        if (cancelled) {
+            idx.clear();
+            return;
+        }
+        idx.sort();
+        qDebug("KeyFrameIndexer: %d key frames in %lld frames", idx.size(), frame);
+        idx.save(cache, stream);
+    }
+    if (idx.isEmpty())
+        return;
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    ready = true;
+}
+
+} //namespace QtAV
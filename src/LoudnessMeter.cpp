@@ -0,0 +1,442 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/LoudnessMeter.h"
+#include <QtCore/qmath.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QTAV_LOUDNESS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace QtAV {
+
+const qreal LoudnessMeter::kMinLoudness = -200.0;
+
+static const int kMaxChannels = 8;
+static const int kSubBlocksMomentary = 4; //400ms
+static const int kSubBlocksShortTerm = 30; //3s
+static const double kAbsoluteGate = -70.0;
+static const double kRelativeGate = -10.0;
+static const double kHistogramStep = 0.1;
+static const int kHistogramBins = 750; //up to +5LUFS
+static const int kOversample = 4;
+static const int kTaps = 12; //taps per phase
+static const float kDenormal = 1e-15f;
+
+static inline double energyToLoudness(double energy)
+{
+    if (energy <= 0)
+        return LoudnessMeter::kMinLoudness;
+    return -0.691 + 10.0*log10(energy);
+}
+
+class LoudnessMeterPrivate : public DPtrPrivate<LoudnessMeter>
+{
+public:
+    LoudnessMeterPrivate()
+        : rate(0)
+        , channels(0)
+        , sub_block_size(0)
+        , sub_block_pos(0)
+        , energy_count(0)
+        , energy_index(0)
+        , blocks(0)
+        , hist_pos(0)
+        , peak(0)
+        , history(kMaxChannels*2*kTaps)
+        , hist_count(kHistogramBins)
+        , hist_energy(kHistogramBins)
+    {
+        memset(b, 0, sizeof(b));
+        memset(a, 0, sizeof(a));
+        memset(fir, 0, sizeof(fir));
+        setup(0, 0);
+        reset();
+    }
+    void setup(int sampleRate, int nb_channels) {
+        rate = sampleRate;
+        channels = qBound(0, nb_channels, kMaxChannels);
+        sub_block_size = qMax(1, rate/10);
+        for (int c = 0; c < kMaxChannels; ++c)
+            weight[c] = 1.0;
+        if (channels == 6) { // FL FR FC LFE BL BR
+            weight[3] = 0;
+            weight[4] = weight[5] = 1.41;
+        }
+        if (rate <= 0)
+            return;
+        // K-weighting. same as libebur128, works for any sample rate
+        double f0 = 1681.974450955533;
+        double G = 3.999843853973347;
+        double Q = 0.7071752369554196;
+        double K = tan(M_PI*f0/double(rate));
+        const double Vh = pow(10.0, G/20.0);
+        const double Vb = pow(Vh, 0.4996667741545416);
+        double a0 = 1.0 + K/Q + K*K;
+        b[0][0] = (Vh + Vb*K/Q + K*K)/a0;
+        b[0][1] = 2.0*(K*K - Vh)/a0;
+        b[0][2] = (Vh - Vb*K/Q + K*K)/a0;
+        a[0][1] = 2.0*(K*K - 1.0)/a0;
+        a[0][2] = (1.0 - K/Q + K*K)/a0;
+        f0 = 38.13547087602444;
+        Q = 0.5003270373238773;
+        K = tan(M_PI*f0/double(rate));
+        a0 = 1.0 + K/Q + K*K;
+        b[1][0] = 1.0;
+        b[1][1] = -2.0;
+        b[1][2] = 1.0;
+        a[1][1] = 2.0*(K*K - 1.0)/a0;
+        a[1][2] = (1.0 - K/Q + K*K)/a0;
+        // true peak interpolation filter: hann windowed sinc, 4 phases
+        const int N = kOversample*kTaps;
+        const double center = double(N - 1)/2.0;
+        for (int k = 0; k < N; ++k) {
+            const double t = (double(k) - center)/double(kOversample);
+            const double sinc = qFuzzyIsNull(t) ? 1.0 : sin(M_PI*t)/(M_PI*t);
+            const double w = 0.5 - 0.5*cos(2.0*M_PI*double(k)/double(N - 1));
+            fir[k%kOversample][k/kOversample] = float(sinc*w);
+        }
+        reset();
+    }
+    void reset() {
+        memset(z, 0, sizeof(z));
+        history.fill(0);
+        hist_pos = 0;
+        peak = 0;
+        hist_count.fill(0);
+        hist_energy.fill(0);
+        blocks = 0;
+        resetWindow();
+    }
+    void resetWindow() {
+        sub_block_pos = 0;
+        energy_count = 0;
+        energy_index = 0;
+        memset(sum_k, 0, sizeof(sum_k));
+        memset(sum_raw, 0, sizeof(sum_raw));
+        memset(energy, 0, sizeof(energy));
+        memset(raw_ms, 0, sizeof(raw_ms));
+    }
+    // K-weight n frames and accumulate the square sums. n frames are in the current sub block
+    void filter(const float *in, int n);
+    void truePeak(const float *in, int n);
+    void endSubBlock();
+
+    int rate, channels;
+    double weight[kMaxChannels];
+    float b[2][3], a[2][3];
+    float z[2][2][kMaxChannels]; //[stage][z1, z2][channel]
+    int sub_block_size, sub_block_pos;
+    double sum_k[kMaxChannels], sum_raw[kMaxChannels];
+    // channel weighted mean square of the last sub blocks. a ring buffer
+    double energy[kSubBlocksShortTerm];
+    // mean square of each channel in the last 4 sub blocks
+    double raw_ms[kSubBlocksMomentary][kMaxChannels];
+    int energy_count, energy_index;
+    qint64 blocks;
+    // true peak
+    float fir[kOversample][kTaps];
+    int hist_pos;
+    float peak;
+    // per channel, 2*kTaps so that the latest kTaps samples are continuous
+    QVector<float> history;
+    QVector<quint32> hist_count;
+    QVector<double> hist_energy;
+};
+
+void LoudnessMeterPrivate::filter(const float *in, int n)
+{
+#if QTAV_LOUDNESS_SSE
+    const __m128 b00 = _mm_set1_ps(b[0][0]), b01 = _mm_set1_ps(b[0][1]), b02 = _mm_set1_ps(b[0][2]);
+    const __m128 a01 = _mm_set1_ps(a[0][1]), a02 = _mm_set1_ps(a[0][2]);
+    const __m128 a11 = _mm_set1_ps(a[1][1]), a12 = _mm_set1_ps(a[1][2]);
+    const __m128 m2 = _mm_set1_ps(-2.0f);
+    // 1 channel per lane
+    for (int c0 = 0; c0 < channels; c0 += 4) {
+        const int nc = qMin(4, channels - c0);
+        __m128 z10 = _mm_loadu_ps(&z[0][0][c0]), z20 = _mm_loadu_ps(&z[0][1][c0]);
+        __m128 z11 = _mm_loadu_ps(&z[1][0][c0]), z21 = _mm_loadu_ps(&z[1][1][c0]);
+        __m128 sk = _mm_setzero_ps(), sr = _mm_setzero_ps();
+        const float *f = in + c0;
+        for (int i = 0; i < n; ++i, f += channels) {
+            __m128 x;
+            if (nc == 4)
+                x = _mm_loadu_ps(f);
+            else if (nc == 2)
+                x = _mm_setr_ps(f[0], f[1], 0, 0);
+            else if (nc == 1)
+                x = _mm_set_ss(f[0]);
+            else
+                x = _mm_setr_ps(f[0], f[1], f[2], 0);
+            sr = _mm_add_ps(sr, _mm_mul_ps(x, x));
+            // transposed direct form II. stage 0: high shelf
+            const __m128 y0 = _mm_add_ps(_mm_mul_ps(b00, x), z10);
+            z10 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b01, x), _mm_mul_ps(a01, y0)), z20);
+            z20 = _mm_sub_ps(_mm_mul_ps(b02, x), _mm_mul_ps(a02, y0));
+            // stage 1: high pass, b = {1, -2, 1}
+            const __m128 y1 = _mm_add_ps(y0, z11);
+            z11 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(m2, y0), _mm_mul_ps(a11, y1)), z21);
+            z21 = _mm_sub_ps(y0, _mm_mul_ps(a12, y1));
+            sk = _mm_add_ps(sk, _mm_mul_ps(y1, y1));
+        }
+        _mm_storeu_ps(&z[0][0][c0], z10);
+        _mm_storeu_ps(&z[0][1][c0], z20);
+        _mm_storeu_ps(&z[1][0][c0], z11);
+        _mm_storeu_ps(&z[1][1][c0], z21);
+        float k[4], r[4];
+        _mm_storeu_ps(k, sk);
+        _mm_storeu_ps(r, sr);
+        for (int c = 0; c < nc; ++c) {
+            sum_k[c0 + c] += k[c];
+            sum_raw[c0 + c] += r[c];
+        }
+    }
+#else
+    for (int c = 0; c < channels; ++c) {
+        float z10 = z[0][0][c], z20 = z[0][1][c], z11 = z[1][0][c], z21 = z[1][1][c];
+        float sk = 0, sr = 0;
+        const float *f = in + c;
+        for (int i = 0; i < n; ++i, f += channels) {
+            const float x = *f;
+            sr += x*x;
+            const float y0 = b[0][0]*x + z10;
+            z10 = b[0][1]*x - a[0][1]*y0 + z20;
+            z20 = b[0][2]*x - a[0][2]*y0;
+            const float y1 = y0 + z11;
+            z11 = -2.0f*y0 - a[1][1]*y1 + z21;
+            z21 = y0 - a[1][2]*y1;
+            sk += y1*y1;
+        }
+        z[0][0][c] = z10; z[0][1][c] = z20; z[1][0][c] = z11; z[1][1][c] = z21;
+        sum_k[c] += sk;
+        sum_raw[c] += sr;
+    }
+#endif //QTAV_LOUDNESS_SSE
+    // avoid denormal states in silence
+    for (int c = 0; c < channels; ++c) {
+        for (int s = 0; s < 2; ++s) {
+            if (fabsf(z[s][0][c]) < kDenormal)
+                z[s][0][c] = 0;
+            if (fabsf(z[s][1][c]) < kDenormal)
+                z[s][1][c] = 0;
+        }
+    }
+}
+
+void LoudnessMeterPrivate::truePeak(const float *in, int n)
+{
+    float *hist = history.data();
+    int pos = hist_pos;
+    float p = peak;
+    for (int i = 0; i < n; ++i) {
+        pos = (pos + kTaps - 1) % kTaps;
+        for (int c = 0; c < channels; ++c) {
+            const float x = in[i*channels + c];
+            float *h = hist + c*2*kTaps;
+            h[pos] = h[pos + kTaps] = x;
+            // h[pos + j] is the sample j frames ago
+            const float *w = h + pos;
+#if QTAV_LOUDNESS_SSE
+            const __m128 w0 = _mm_loadu_ps(w), w1 = _mm_loadu_ps(w + 4), w2 = _mm_loadu_ps(w + 8);
+            __m128 m = _mm_setzero_ps();
+            for (int ph = 0; ph < kOversample; ++ph) {
+                __m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_loadu_ps(fir[ph]))
+                                                 , _mm_mul_ps(w1, _mm_loadu_ps(fir[ph] + 4)))
+                                      , _mm_mul_ps(w2, _mm_loadu_ps(fir[ph] + 8)));
+                // horizontal add
+                s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+                s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+                // abs
+                s = _mm_andnot_ps(_mm_set_ss(-0.0f), s);
+                m = _mm_max_ss(m, s);
+            }
+            float v;
+            _mm_store_ss(&v, m);
+            p = qMax(p, v);
+#else
+            for (int ph = 0; ph < kOversample; ++ph) {
+                float s = 0;
+                for (int j = 0; j < kTaps; ++j)
+                    s += w[j]*fir[ph][j];
+                p = qMax(p, fabsf(s));
+            }
+#endif //QTAV_LOUDNESS_SSE
+            p = qMax(p, fabsf(x));
+        }
+    }
+    hist_pos = pos;
+    peak = p;
+}
+
+void LoudnessMeterPrivate::endSubBlock()
+{
+    double e = 0;
+    const int raw_index = energy_count % kSubBlocksMomentary;
+    for (int c = 0; c < channels; ++c) {
+        e += weight[c]*sum_k[c]/double(sub_block_pos);
+        raw_ms[raw_index][c] = sum_raw[c]/double(sub_block_pos);
+    }
+    memset(sum_k, 0, sizeof(sum_k));
+    memset(sum_raw, 0, sizeof(sum_raw));
+    sub_block_pos = 0;
+    energy[energy_index] = e;
+    energy_index = (energy_index + 1) % kSubBlocksShortTerm;
+    ++energy_count;
+    if (energy_count < kSubBlocksMomentary)
+        return;
+    // a 400ms gating block. 75% overlap
+    double block = 0;
+    for (int i = 1; i <= kSubBlocksMomentary; ++i)
+        block += energy[(energy_index - i + kSubBlocksShortTerm) % kSubBlocksShortTerm];
+    block /= double(kSubBlocksMomentary);
+    const double l = energyToLoudness(block);
+    if (l < kAbsoluteGate)
+        return;
+    const int bin = qMin(int((l - kAbsoluteGate)/kHistogramStep), kHistogramBins - 1);
+    hist_count[bin]++;
+    hist_energy[bin] += block;
+    ++blocks;
+}
+
+LoudnessMeter::LoudnessMeter()
+{
+}
+
+LoudnessMeter::~LoudnessMeter()
+{
+}
+
+void LoudnessMeter::setAudioFormat(int sampleRate, int channels)
+{
+    if (channels > kMaxChannels)
+        qWarning("LoudnessMeter: only the first %d channels are measured", kMaxChannels);
+    d_func().setup(sampleRate, channels);
+}
+
+int LoudnessMeter::sampleRate() const
+{
+    return d_func().rate;
+}
+
+int LoudnessMeter::channels() const
+{
+    return d_func().channels;
+}
+
+void LoudnessMeter::reset()
+{
+    d_func().reset();
+}
+
+void LoudnessMeter::resetWindow()
+{
+    d_func().resetWindow();
+}
+
+void LoudnessMeter::process(const float *interleaved, int samples)
+{
+    DPTR_D(LoudnessMeter);
+    if (d.rate <= 0 || d.channels <= 0)
+        return;
+    d.truePeak(interleaved, samples);
+    while (samples > 0) {
+        const int n = qMin(samples, d.sub_block_size - d.sub_block_pos);
+        d.filter(interleaved, n);
+        d.sub_block_pos += n;
+        if (d.sub_block_pos >= d.sub_block_size)
+            d.endSubBlock();
+        interleaved += n*d.channels;
+        samples -= n;
+    }
+}
+
+qreal LoudnessMeter::momentaryLoudness() const
+{
+    DPTR_D(const LoudnessMeter);
+    if (d.energy_count < kSubBlocksMomentary)
+        return kMinLoudness;
+    double e = 0;
+    for (int i = 1; i <= kSubBlocksMomentary; ++i)
+        e += d.energy[(d.energy_index - i + kSubBlocksShortTerm) % kSubBlocksShortTerm];
+    return energyToLoudness(e/double(kSubBlocksMomentary));
+}
+
+qreal LoudnessMeter::shortTermLoudness() const
+{
+    DPTR_D(const LoudnessMeter);
+    if (d.energy_count < kSubBlocksShortTerm)
+        return kMinLoudness;
+    double e = 0;
+    for (int i = 0; i < kSubBlocksShortTerm; ++i)
+        e += d.energy[i];
+    return energyToLoudness(e/double(kSubBlocksShortTerm));
+}
+
+qreal LoudnessMeter::integratedLoudness() const
+{
+    DPTR_D(const LoudnessMeter);
+    if (d.blocks <= 0)
+        return kMinLoudness;
+    double e = 0;
+    for (int i = 0; i < kHistogramBins; ++i)
+        e += d.hist_energy[i];
+    const double gate = energyToLoudness(e/double(d.blocks)) + kRelativeGate;
+    const int start = qMax(0, int(ceil((gate - kAbsoluteGate)/kHistogramStep)));
+    e = 0;
+    qint64 n = 0;
+    for (int i = start; i < kHistogramBins; ++i) {
+        e += d.hist_energy[i];
+        n += d.hist_count[i];
+    }
+    if (n <= 0)
+        return kMinLoudness;
+    return energyToLoudness(e/double(n));
+}
+
+qreal LoudnessMeter::truePeak() const
+{
+    DPTR_D(const LoudnessMeter);
+    if (d.peak <= 0)
+        return kMinLoudness;
+    return 20.0*log10(d.peak);
+}
+
+QVector<qreal> LoudnessMeter::rms() const
+{
+    DPTR_D(const LoudnessMeter);
+    QVector<qreal> r(d.channels, kMinLoudness);
+    const int n = qMin(d.energy_count, kSubBlocksMomentary);
+    if (n <= 0)
+        return r;
+    for (int c = 0; c < d.channels; ++c) {
+        double ms = 0;
+        for (int i = 0; i < n; ++i)
+            ms += d.raw_ms[i][c];
+        ms /= double(n);
+        if (ms > 0)
+            r[c] = 10.0*log10(ms);
+    }
+    return r;
+}
+
+} //namespace QtAV
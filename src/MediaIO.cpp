@@ -0,0 +1,482 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/MediaIO.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QIODevice>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif //Q_OS_UNIX
+
+namespace QtAV {
+
+// the size of a read from a sequential device
+static const int kReadAheadChunk = 64*1024;
+
+static int readPacket(void *opaque, uint8_t *buf, int size)
+{
+    MediaIO *io = static_cast<MediaIO*>(opaque);
+    if (io->isInterrupted())
+        return AVERROR_EXIT;
+    const qint64 n = io->read((char*)buf, size);
+    if (n < 0)
+        return io->isInterrupted() ? AVERROR_EXIT : AVERROR(EIO);
+    if (n == 0)
+        return AVERROR_EOF;
+    return (int)n;
+}
+
+static int64_t seekPacket(void *opaque, int64_t offset, int whence)
+{
+    MediaIO *io = static_cast<MediaIO*>(opaque);
+    if (whence == AVSEEK_SIZE)
+        return io->size();
+    if (!io->isSeekable())
+        return -1;
+    qint64 pos = offset;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += io->position();
+        break;
+    case SEEK_END:
+        if (io->size() < 0)
+            return -1;
+        pos += io->size();
+        break;
+    default:
+        return -1;
+    }
+    if (pos < 0 || !io->seek(pos))
+        return -1;
+    return pos;
+}
+
+MediaIO::MediaIO()
+    : interrupted(false)
+    , timeout_ms(-1)
+    , ctx(0)
+{
+}
+
+MediaIO::~MediaIO()
+{
+    // derived classes call close() because onClose() is virtual
+    Q_ASSERT(!ctx);
+}
+
+bool MediaIO::open(int bufferSize)
+{
+    close();
+    interrupted = false;
+    if (!onOpen())
+        return false;
+    unsigned char *buf = (unsigned char*)av_malloc(bufferSize);
+    if (!buf) {
+        qWarning("MediaIO: can not allocate %d bytes", bufferSize);
+        onClose();
+        return false;
+    }
+    ctx = avio_alloc_context(buf, bufferSize, 0, this, readPacket, 0, seekPacket);
+    if (!ctx) {
+        qWarning("MediaIO: avio_alloc_context error");
+        av_free(buf);
+        onClose();
+        return false;
+    }
+    ctx->seekable = isSeekable() ? AVIO_SEEKABLE_NORMAL : 0;
+    return true;
+}
+
+void MediaIO::close()
+{
+    if (!ctx)
+        return;
+    // the buffer may be reallocated by avio
+    av_freep(&ctx->buffer);
+    av_freep(&ctx);
+    onClose();
+}
+
+AVIOContext* MediaIO::avioContext() const
+{
+    return ctx;
+}
+
+void MediaIO::setInterrupted(bool value)
+{
+    interrupted = value;
+}
+
+bool MediaIO::isInterrupted() const
+{
+    return interrupted;
+}
+
+void MediaIO::setTimeout(qint64 value)
+{
+    timeout_ms = value;
+}
+
+qint64 MediaIO::timeout() const
+{
+    return timeout_ms;
+}
+
+class ReadAheadBuffer
+{
+public:
+    ReadAheadBuffer(int size)
+        : window(size)
+        , head(0)
+        , pos(0)
+        , channel_end(false)
+        , device_end(false)
+        , stop(false)
+        , full(false)
+    {}
+    QMutex mutex;
+    QWaitCondition data_cond;
+    QByteArray data;
+    int window;
+    int head; //data before head are read
+    qint64 pos; //bytes read by QIODeviceIO::read()
+    bool channel_end; //no data will arrive
+    bool device_end; //all data are in the buffer
+    bool stop;
+    bool full; //the reader waits for QIODeviceIO::read()
+};
+
+QIODeviceReader::QIODeviceReader(QIODevice *device, const QSharedPointer<ReadAheadBuffer> &buffer)
+    : QObject(0)
+    , dev(device)
+    , ahead(buffer)
+{
+    connect(dev, SIGNAL(readyRead()), SLOT(readData()));
+    connect(dev, SIGNAL(readChannelFinished()), SLOT(finish()));
+    // the device is not readable after close()
+    connect(dev, SIGNAL(aboutToClose()), SLOT(finish()));
+    connect(dev, SIGNAL(destroyed()), SLOT(onDeviceDestroyed()));
+}
+
+void QIODeviceReader::readData()
+{
+    QByteArray chunk;
+    while (true) {
+        int space = 0;
+        bool channel_end = false;
+        {
+            QMutexLocker lock(&ahead->mutex);
+            Q_UNUSED(lock);
+            if (ahead->stop || ahead->device_end)
+                return;
+            space = ahead->window - (ahead->data.size() - ahead->head);
+            ahead->full = space <= 0;
+            if (ahead->full)
+                return;
+            channel_end = ahead->channel_end;
+        }
+        qint64 n = -1;
+        if (dev && dev->isOpen()) {
+            chunk.resize(qMin(space, kReadAheadChunk));
+            n = dev->read(chunk.data(), chunk.size());
+        }
+        // wait for readyRead()
+        if (n == 0 && !channel_end)
+            return;
+        QMutexLocker lock(&ahead->mutex);
+        Q_UNUSED(lock);
+        if (n <= 0) {
+            qDebug("QIODeviceIO: end of the sequential device");
+            ahead->device_end = true;
+            ahead->data_cond.wakeAll();
+            return;
+        }
+        // drop the data already read
+        if (ahead->head > 0 && ahead->head >= ahead->data.size()/2) {
+            ahead->data.remove(0, ahead->head);
+            ahead->head = 0;
+        }
+        ahead->data.append(chunk.constData(), n);
+        ahead->data_cond.wakeAll();
+    }
+}
+
+void QIODeviceReader::finish()
+{
+    {
+        QMutexLocker lock(&ahead->mutex);
+        Q_UNUSED(lock);
+        ahead->channel_end = true;
+    }
+    readData();
+}
+
+void QIODeviceReader::onDeviceDestroyed()
+{
+    dev = 0;
+    finish();
+}
+
+QIODeviceIO::QIODeviceIO(QIODevice *device, int readAhead)
+    : MediaIO()
+    , dev(device)
+    , window(qMax(readAhead, kReadAheadChunk))
+    , reader(0)
+{
+}
+
+QIODeviceIO::~QIODeviceIO()
+{
+    close();
+}
+
+void QIODeviceIO::setInterrupted(bool value)
+{
+    MediaIO::setInterrupted(value);
+    if (!ahead)
+        return;
+    QMutexLocker lock(&ahead->mutex);
+    Q_UNUSED(lock);
+    ahead->data_cond.wakeAll();
+}
+
+bool QIODeviceIO::isSeekable() const
+{
+    return dev && !dev->isSequential();
+}
+
+qint64 QIODeviceIO::read(char *data, qint64 maxSize)
+{
+    if (!reader) {
+        const qint64 n = dev->read(data, maxSize);
+        if (n == 0 && !dev->atEnd())
+            return -1;
+        return n;
+    }
+    // the reader's slots can not be invoked while the device's thread waits here
+    const bool same_thread = dev->thread() == QThread::currentThread();
+    QElapsedTimer timer;
+    timer.start();
+    ReadAheadBuffer &a = *ahead;
+    QMutexLocker lock(&a.mutex);
+    Q_UNUSED(lock);
+    while (a.head >= a.data.size() && !a.device_end && !interrupted) {
+        if (timeout_ms >= 0 && timer.hasExpired(timeout_ms)) {
+            qWarning("QIODeviceIO: read timeout");
+            return -1;
+        }
+        if (!same_thread) {
+            a.data_cond.wait(&a.mutex, 100);
+            continue;
+        }
+        a.mutex.unlock();
+        // readyRead() and readChannelFinished() are emitted in it and the reader is called directly
+        const bool ready = dev->isOpen() && dev->waitForReadyRead(100);
+        reader->readData();
+        a.mutex.lock();
+        // avoid busy waiting if the device does not support waitForReadyRead()
+        if (!ready && a.head >= a.data.size() && !a.device_end)
+            a.data_cond.wait(&a.mutex, 10);
+    }
+    if (a.head >= a.data.size())
+        return interrupted ? -1 : 0;
+    const int n = qMin<qint64>(maxSize, a.data.size() - a.head);
+    memcpy(data, a.data.constData() + a.head, n);
+    a.head += n;
+    a.pos += n;
+    if (a.full) {
+        a.full = false;
+        QMetaObject::invokeMethod(reader, "readData", Qt::QueuedConnection);
+    }
+    return n;
+}
+
+bool QIODeviceIO::seek(qint64 pos)
+{
+    if (!isSeekable())
+        return false;
+    return dev->seek(pos);
+}
+
+qint64 QIODeviceIO::position() const
+{
+    if (reader) {
+        QMutexLocker lock(&ahead->mutex);
+        Q_UNUSED(lock);
+        return ahead->pos;
+    }
+    return dev->pos();
+}
+
+qint64 QIODeviceIO::size() const
+{
+    // QIODevice::size() of a sequential device is bytesAvailable()
+    if (!isSeekable())
+        return -1;
+    return dev->size();
+}
+
+bool QIODeviceIO::onOpen()
+{
+    if (!dev || !dev->isOpen() || !dev->isReadable()) {
+        qWarning("QIODeviceIO: device is not open for reading");
+        return false;
+    }
+    if (isSeekable()) {
+        // reload. demuxer reads the header at the beginning
+        return dev->seek(0);
+    }
+    ahead = QSharedPointer<ReadAheadBuffer>(new ReadAheadBuffer(window));
+    reader = new QIODeviceReader(dev, ahead);
+    reader->moveToThread(dev->thread());
+    // the data already available. readyRead() is not emitted for them
+    QMetaObject::invokeMethod(reader, "readData", Qt::QueuedConnection);
+    return true;
+}
+
+void QIODeviceIO::onClose()
+{
+    if (!reader)
+        return;
+    {
+        QMutexLocker lock(&ahead->mutex);
+        Q_UNUSED(lock);
+        ahead->stop = true;
+    }
+    // it may be reading in the device's thread
+    reader->deleteLater();
+    reader = 0;
+    ahead.clear();
+}
+
+MMapIO::MMapIO(const QString &file, int readAhead)
+    : MediaIO()
+    , f(file)
+    , window(qMax(readAhead, kReadAheadChunk))
+    , data(0)
+    , data_size(0)
+    , pos(0)
+    , advised_begin(0)
+    , advised_end(0)
+{
+}
+
+MMapIO::~MMapIO()
+{
+    close();
+}
+
+bool MMapIO::isSeekable() const
+{
+    return true;
+}
+
+qint64 MMapIO::read(char *dst, qint64 maxSize)
+{
+    if (!data)
+        return -1;
+    const qint64 n = qMin(maxSize, data_size - pos);
+    if (n <= 0)
+        return 0;
+    if (pos < advised_begin || pos + n > advised_end)
+        adviseWillNeed(pos);
+    memcpy(dst, data + pos, n);
+    pos += n;
+    return n;
+}
+
+bool MMapIO::seek(qint64 value)
+{
+    if (value < 0 || value > data_size)
+        return false;
+    pos = value;
+    // the window is advised by the next read. a seek for probing may not be followed by a read
+    return true;
+}
+
+qint64 MMapIO::position() const
+{
+    return pos;
+}
+
+qint64 MMapIO::size() const
+{
+    return data_size;
+}
+
+bool MMapIO::onOpen()
+{
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning("MMapIO: can not open %s: %s", qPrintable(f.fileName()), qPrintable(f.errorString()));
+        return false;
+    }
+    data_size = f.size();
+    data = data_size > 0 ? f.map(0, data_size) : 0;
+    if (!data) {
+        qWarning("MMapIO: can not map %s: %s", qPrintable(f.fileName()), qPrintable(f.errorString()));
+        f.close();
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    if (madvise(data, data_size, MADV_SEQUENTIAL) != 0)
+        qDebug("MMapIO: madvise MADV_SEQUENTIAL error");
+#endif //Q_OS_UNIX
+    pos = 0;
+    advised_begin = advised_end = 0;
+    return true;
+}
+
+void MMapIO::onClose()
+{
+    if (data)
+        f.unmap(data);
+    data = 0;
+    data_size = 0;
+    f.close();
+}
+
+void MMapIO::adviseWillNeed(qint64 value)
+{
+#ifdef Q_OS_UNIX
+    // the address must be page aligned
+    static const qint64 page = sysconf(_SC_PAGESIZE);
+    const qint64 begin = value - value % page;
+    const qint64 end = qMin(data_size, value + window);
+    if (madvise(data + begin, end - begin, MADV_WILLNEED) != 0)
+        qDebug("MMapIO: madvise MADV_WILLNEED error");
+    // advise again when half of the window is read
+    advised_begin = begin;
+    advised_end = qMin(data_size, value + window/2);
+#else
+    Q_UNUSED(value);
+    advised_begin = 0;
+    advised_end = data_size;
+#endif //Q_OS_UNIX
+}
+
+} //namespace QtAV
@@ -24,12 +24,16 @@
 namespace QtAV {
 
 const qreal Packet::kEndPts = -0.618;
+const qint64 Packet::kNoTimestamp = -Q_INT64_C(0x7fffffffffffffff) - 1;
 
 Packet::Packet()
     : hasKeyFrame(false)
     , isCorrupt(false)
     , pts(0)
     , duration(0)
+    , position(-1)
+    , stream_pts(kNoTimestamp)
+    , stream_dts(kNoTimestamp)
 {
 }
 
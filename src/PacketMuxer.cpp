@@ -0,0 +1,224 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/PacketMuxer.h>
+#include <QtAV/Packet.h>
+#include <QtAV/QtAV_Compat.h>
+
+namespace QtAV {
+
+static int64_t toStreamTime(qreal seconds, const AVRational& tb)
+{
+    return int64_t(seconds/av_q2d(tb) + 0.5);
+}
+
+PacketMuxer::PacketMuxer()
+    : format_ctx(0)
+    , offset(0)
+    , end_time(0)
+{
+}
+
+PacketMuxer::~PacketMuxer()
+{
+    close();
+}
+
+int PacketMuxer::open(AVFormatContext *in_ctx, const QList<int> &streams, const QString &fileName, const QString &format)
+{
+    close();
+    offset = 0;
+    end_time = 0;
+    int ret = avformat_alloc_output_context2(&format_ctx, NULL
+                                             , format.isEmpty() ? NULL : format.toUtf8().constData()
+                                             , fileName.toUtf8().constData());
+    if (ret < 0 || !format_ctx) {
+        qWarning("PacketMuxer: can not find output format for %s: %s", qPrintable(fileName), av_err2str(ret));
+        format_ctx = 0;
+        return ret < 0 ? ret : AVERROR_MUXER_NOT_FOUND;
+    }
+    AVOutputFormat *ofmt = format_ctx->oformat;
+    // adts aac in mpegts etc. must be converted for mp4
+    const bool mp4 = strstr(ofmt->name, "mp4") || strstr(ofmt->name, "mov") || strstr(ofmt->name, "ipod");
+    foreach (int i, streams) {
+        if (i < 0 || i >= (int)in_ctx->nb_streams)
+            continue;
+        AVStream *in = in_ctx->streams[i];
+        AVStream *out = avformat_new_stream(format_ctx, 0);
+        if (!out || (ret = avcodec_copy_context(out->codec, in->codec)) < 0) {
+            qWarning("PacketMuxer: failed to add stream %d", i);
+            close();
+            return out ? ret : AVERROR(ENOMEM);
+        }
+        out->codec->codec_tag = 0; //tags of the input format may be invalid in the output format
+        out->time_base = in->time_base;
+        if (ofmt->flags & AVFMT_GLOBALHEADER)
+            out->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
+        Stream s;
+        s.input = i;
+        s.in_tb_num = in->time_base.num;
+        s.in_tb_den = in->time_base.den;
+        s.last_dts = AV_NOPTS_VALUE;
+        s.bsf = 0;
+        if (mp4 && in->codec->codec_id == CODEC_ID_AAC)
+            s.bsf = av_bitstream_filter_init("aac_adtstoasc");
+        mStreams.append(s);
+    }
+    if (mStreams.isEmpty()) {
+        qWarning("PacketMuxer: no stream to write");
+        close();
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+    if (!(ofmt->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&format_ctx->pb, fileName.toUtf8().constData(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            qWarning("PacketMuxer: can not open %s: %s", qPrintable(fileName), av_err2str(ret));
+            close();
+            return ret;
+        }
+    }
+    ret = avformat_write_header(format_ctx, NULL);
+    if (ret < 0) {
+        qWarning("PacketMuxer: write header error: %s", av_err2str(ret));
+        close();
+        return ret;
+    }
+    qDebug("PacketMuxer: %d streams to %s(%s)", mStreams.size(), qPrintable(fileName), ofmt->name);
+    return 0;
+}
+
+bool PacketMuxer::isOpen() const
+{
+    return !!format_ctx;
+}
+
+int PacketMuxer::finish()
+{
+    if (!format_ctx)
+        return 0;
+    av_interleaved_write_frame(format_ctx, NULL); //flush
+    int ret = av_write_trailer(format_ctx);
+    if (ret < 0)
+        qWarning("PacketMuxer: write trailer error: %s", av_err2str(ret));
+    close();
+    return ret;
+}
+
+void PacketMuxer::close()
+{
+    for (int i = 0; i < mStreams.size(); ++i) {
+        if (mStreams[i].bsf)
+            av_bitstream_filter_close(mStreams[i].bsf);
+    }
+    mStreams.clear();
+    if (!format_ctx)
+        return;
+    if (format_ctx->pb && !(format_ctx->oformat->flags & AVFMT_NOFILE))
+        avio_close(format_ctx->pb);
+    avformat_free_context(format_ctx);
+    format_ctx = 0;
+}
+
+int PacketMuxer::outputStream(int input) const
+{
+    for (int i = 0; i < mStreams.size(); ++i) {
+        if (mStreams[i].input == input)
+            return i;
+    }
+    return -1;
+}
+
+int PacketMuxer::streamCount() const
+{
+    return mStreams.size();
+}
+
+int PacketMuxer::mediaType(int stream) const
+{
+    if (!format_ctx || stream < 0 || stream >= (int)format_ctx->nb_streams)
+        return AVMEDIA_TYPE_UNKNOWN;
+    return format_ctx->streams[stream]->codec->codec_type;
+}
+
+int PacketMuxer::write(const Packet &packet, int stream, bool rebase)
+{
+    Stream &s = mStreams[stream];
+    AVStream *out = format_ctx->streams[stream];
+    AVRational in_tb;
+    in_tb.num = s.in_tb_num;
+    in_tb.den = s.in_tb_den;
+    int64_t dts = packet.stream_dts != Packet::kNoTimestamp ? packet.stream_dts : packet.stream_pts;
+    if (dts == Packet::kNoTimestamp)
+        dts = toStreamTime(packet.pts, in_tb);
+    if (rebase)
+        offset = av_rescale_q(dts, in_tb, AV_TIME_BASE_Q) - end_time;
+    const int64_t shift = av_rescale_q(offset, AV_TIME_BASE_Q, in_tb);
+    // packets before the rebase packet, e.g. audio interleaved later
+    if (dts - shift < 0)
+        return 0;
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.stream_index = stream;
+    pkt.dts = av_rescale_q(dts - shift, in_tb, out->time_base);
+    pkt.pts = pkt.dts;
+    if (packet.stream_pts != Packet::kNoTimestamp)
+        pkt.pts = av_rescale_q(packet.stream_pts - shift, in_tb, out->time_base);
+    if (s.last_dts != AV_NOPTS_VALUE && pkt.dts <= s.last_dts)
+        pkt.dts = s.last_dts + 1;
+    if (pkt.pts < pkt.dts)
+        pkt.pts = pkt.dts;
+    s.last_dts = pkt.dts;
+    pkt.duration = toStreamTime(packet.duration, out->time_base);
+    if (packet.hasKeyFrame)
+        pkt.flags |= AV_PKT_FLAG_KEY;
+    pkt.data = (uint8_t*)packet.data.constData();
+    pkt.size = packet.data.size();
+    uint8_t *filtered = 0;
+    if (s.bsf) {
+        int size = 0;
+        int ret = av_bitstream_filter_filter(s.bsf, out->codec, NULL, &filtered, &size
+                                             , pkt.data, pkt.size, pkt.flags & AV_PKT_FLAG_KEY);
+        if (ret < 0)
+            return ret;
+        pkt.data = filtered;
+        pkt.size = size;
+        // 0: filtered points to the input
+        if (ret == 0)
+            filtered = 0;
+    }
+    const int64_t end = av_rescale_q(pkt.dts + pkt.duration, out->time_base, AV_TIME_BASE_Q);
+    // the muxer copies the data
+    int ret = av_interleaved_write_frame(format_ctx, &pkt);
+    if (filtered)
+        av_free(filtered);
+    if (ret < 0)
+        return ret;
+    if (end > end_time)
+        end_time = end;
+    return 0;
+}
+
+qint64 PacketMuxer::endTime() const
+{
+    return end_time;
+}
+
+} //namespace QtAV
@@ -0,0 +1,231 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/ProbeCache.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QDateTime>
+#include <QtCore/QFileInfo>
+
+namespace QtAV {
+
+// enough for the parameters not in the cache, e.g. the first timestamps
+static const int kProbeSize = 32*1024;
+static const int kAnalyzeDuration = AV_TIME_BASE/10;
+
+static inline AVRational makeRational(int num, int den)
+{
+    AVRational r;
+    r.num = num;
+    r.den = den;
+    return r;
+}
+
+ProbeInfo::ProbeInfo()
+{
+}
+
+bool ProbeInfo::isValid() const
+{
+    return !format.isEmpty() && !streams.isEmpty();
+}
+
+QByteArray ProbeInfo::formatName() const
+{
+    return format;
+}
+
+void ProbeInfo::fill(AVFormatContext *ctx)
+{
+    format.clear();
+    streams.clear();
+    if (!ctx || !ctx->iformat)
+        return;
+    // "mov,mp4,m4a,3gp,3g2,mj2". av_find_input_format() accepts one of them
+    format = QByteArray(ctx->iformat->name).split(',').first();
+    streams.resize(ctx->nb_streams);
+    for (unsigned int i = 0; i < ctx->nb_streams; ++i) {
+        const AVStream *st = ctx->streams[i];
+        const AVCodecContext *c = st->codec;
+        Stream &s = streams[i];
+        s.type = c->codec_type;
+        s.codec_id = c->codec_id;
+        s.width = c->width;
+        s.height = c->height;
+        s.pix_fmt = c->pix_fmt;
+        s.sample_rate = c->sample_rate;
+        s.channels = c->channels;
+        s.sample_fmt = c->sample_fmt;
+        s.frame_size = c->frame_size;
+        s.channel_layout = c->channel_layout;
+        s.fps_num = st->r_frame_rate.num;
+        s.fps_den = st->r_frame_rate.den;
+        s.avg_fps_num = st->avg_frame_rate.num;
+        s.avg_fps_den = st->avg_frame_rate.den;
+    }
+}
+
+void ProbeInfo::apply(AVFormatContext *ctx) const
+{
+    ctx->probesize = kProbeSize;
+    ctx->max_analyze_duration = kAnalyzeDuration;
+    // streams may be created later by avformat_find_stream_info(), e.g. mpeg-ts
+    const int n = qMin<int>(ctx->nb_streams, streams.size());
+    for (int i = 0; i < n; ++i) {
+        AVStream *st = ctx->streams[i];
+        AVCodecContext *c = st->codec;
+        const Stream &s = streams[i];
+        // header says another codec. matches() will fail
+        if (c->codec_type != s.type || c->codec_id != s.codec_id)
+            continue;
+        // only the parameters not in the header
+        if (c->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (c->width <= 0 || c->height <= 0) {
+                c->width = s.width;
+                c->height = s.height;
+            }
+            if (c->pix_fmt == QTAV_PIX_FMT_C(NONE))
+                c->pix_fmt = (AVPixelFormat)s.pix_fmt;
+            if (st->r_frame_rate.num <= 0 || st->r_frame_rate.den <= 0)
+                st->r_frame_rate = makeRational(s.fps_num, s.fps_den);
+            if (st->avg_frame_rate.num <= 0 || st->avg_frame_rate.den <= 0)
+                st->avg_frame_rate = makeRational(s.avg_fps_num, s.avg_fps_den);
+        } else if (c->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (c->sample_rate <= 0)
+                c->sample_rate = s.sample_rate;
+            if (c->channels <= 0)
+                c->channels = s.channels;
+            if (c->sample_fmt == AV_SAMPLE_FMT_NONE)
+                c->sample_fmt = (AVSampleFormat)s.sample_fmt;
+            if (c->frame_size <= 0)
+                c->frame_size = s.frame_size;
+            if (!c->channel_layout)
+                c->channel_layout = s.channel_layout;
+        }
+    }
+}
+
+bool ProbeInfo::matches(AVFormatContext *ctx) const
+{
+    if (!ctx || (int)ctx->nb_streams != streams.size())
+        return false;
+    for (unsigned int i = 0; i < ctx->nb_streams; ++i) {
+        const AVCodecContext *c = ctx->streams[i]->codec;
+        const Stream &s = streams[i];
+        if (c->codec_type != s.type || c->codec_id != s.codec_id)
+            return false;
+        if (c->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (c->width != s.width || c->height != s.height)
+                return false;
+        } else if (c->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (c->sample_rate != s.sample_rate || c->channels != s.channels)
+                return false;
+        }
+    }
+    return true;
+}
+
+ProbeCache& ProbeCache::instance()
+{
+    static ProbeCache sCache;
+    return sCache;
+}
+
+ProbeCache::ProbeCache()
+{
+    cache.setMaxCost(256);
+}
+
+bool ProbeCache::find(const QString &file, ProbeInfo *info) const
+{
+    const QByteArray k(key(file));
+    if (k.isEmpty())
+        return false;
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    ProbeInfo *pi = cache.object(k);
+    if (!pi)
+        return false;
+    if (info)
+        *info = *pi;
+    return true;
+}
+
+void ProbeCache::insert(const QString &file, AVFormatContext *ctx)
+{
+    const QByteArray k(key(file));
+    if (k.isEmpty())
+        return;
+    ProbeInfo *pi = new ProbeInfo();
+    pi->fill(ctx);
+    if (!pi->isValid()) {
+        delete pi;
+        return;
+    }
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    cache.insert(k, pi, 1);
+}
+
+void ProbeCache::remove(const QString &file)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    // the key of a modified file is not in the cache. remove all entries of the path
+    const QByteArray prefix(QFileInfo(file).absoluteFilePath().toUtf8() + '/');
+    foreach (const QByteArray& k, cache.keys()) {
+        if (k.startsWith(prefix))
+            cache.remove(k);
+    }
+}
+
+void ProbeCache::clear()
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    cache.clear();
+}
+
+void ProbeCache::setCapacity(int files)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    cache.setMaxCost(files);
+}
+
+int ProbeCache::capacity() const
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    return cache.maxCost();
+}
+
+QByteArray ProbeCache::key(const QString &file)
+{
+    QFileInfo fi(file);
+    if (!fi.isFile())
+        return QByteArray();
+    QByteArray k = fi.absoluteFilePath().toUtf8();
+    k += '/' + QByteArray::number(fi.size());
+    k += '/' + QByteArray::number(fi.lastModified().toMSecsSinceEpoch());
+    return k;
+}
+
+} //namespace QtAV
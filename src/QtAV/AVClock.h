@@ -107,12 +107,13 @@ double AVClock::value() const
     if (clock_type == AudioClock) {
         return pts_ + delay_;
     } else {
+        // the speed applies to the elapsed time only, otherwise the value jumps when the speed changes
         if (timer.isValid()) {
-            pts_ += double(timer.restart()) * kThousandth;
+            pts_ += double(timer.restart()) * kThousandth * speed();
         } else {//timer is paused
             qDebug("clock is paused. return the last value %f", pts_);
         }
-        return pts_ * speed();
+        return pts_;
     }
 }
 
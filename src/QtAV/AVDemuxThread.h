@@ -23,14 +23,25 @@
 #define QAV_DEMUXTHREAD_H
 
 #include <QtCore/QMutex>
+#include <QtCore/QQueue>
 #include <QtCore/QThread>
 #include <QtCore/QWaitCondition>
 #include <QtAV/QtAV_Global.h>
+#include <QtAV/Packet.h>
+
+#if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+#include <QtCore/QElapsedTimer>
+#else
+#include <QtCore/QTime>
+typedef QTime QElapsedTimer;
+#endif
 
 namespace QtAV {
 
 class AVDemuxer;
 class AVThread;
+class Statistics;
+class StreamRecorder;
 class Q_AV_EXPORT AVDemuxThread : public QThread
 {
     Q_OBJECT
@@ -42,15 +53,56 @@ public:
     AVThread* audioThread();
     void setVideoThread(AVThread *thread);
     AVThread* videoThread();
-    void seek(qint64 pos); //ms
+    // ms. asynchronous if running. the latest request wins
+    void seek(qint64 pos);
     //AVDemuxer* demuxer
     bool isPaused() const;
     bool isEnd() const;
+    /*!
+     * trick play. only video key frames are queued, audio and other video packets are discarded by
+     * the demuxer. minInterval: min pts distance(s) of 2 queued key frames, others are dropped
+     */
+    void setKeyFrameOnly(bool only, qreal minInterval = 0);
+    bool isKeyFrameOnly() const;
+    /*!
+     * packets are read in an io thread into a staging buffer, and the demux thread dispatches them
+     * to the avthreads. a slow read does not starve the queues and a full queue does not stop
+     * reading. the io thread reads ahead until the staged packets reach bytes or seconds(pts
+     * distance). default is 32MB and 8s
+     */
+    void setPrefetchLimit(qint64 bytes, qreal seconds);
+    qint64 prefetchBytes() const;
+    qreal prefetchDuration() const;
+    // pts(s) of the last audio or video packet read. -1 if none after start or seek
+    qreal lastPts() const;
+    /*!
+     * catch up with a live stream. the queued packets are dropped, then the read packets are dropped
+     * until a video key frame(or audio packet if no video) at or after pts
+     */
+    void dropTo(qreal pts);
+    /*!
+     * jitter buffer for network streams. the arrival time jitter of the packets against pts is
+     * measured, and the target depth follows it between floor and ceiling(ms). packets are not
+     * dispatched until the target is buffered when starting, after a seek and after an underrun.
+     * reading stops when the buffer reaches the ceiling
+     */
+    void setJitterBufferEnabled(bool enabled);
+    bool isJitterBufferEnabled() const;
+    void setJitterBufferRange(int floorMs, int ceilingMs);
+    // Statistics::jitterBuffer() is updated
+    void setStatistics(Statistics *s);
+    // the dispatched packets are passed to recorder. not owned
+    void setRecorder(StreamRecorder *recorder);
+signals:
+    // waiting for the jitter buffer
+    void bufferingChanged(bool buffering);
 public slots:
     void stop(); //TODO: remove it?
     void pause(bool p);
 private slots:
     void notifyEnd();
+    // pause again after the frame at the seek target is presented
+    void onSeekFinished();
 
 protected:
     virtual void run();
@@ -62,8 +114,37 @@ protected:
 
 private:
     void setAVThread(AVThread *&pOld, AVThread* pNew);
+    // run the pending seek request or the seek at the end of scrubbing. return true if seeked
+    bool processNextSeek();
+    void seekInternal(qint64 pos, bool previewSeek);
+    // set the stream discard flags. called in demux thread
+    void applyKeyFrameOnly();
+    void applyStreamDiscard();
+    // io stage. called in read_thread
+    void readPackets();
+    bool isStagingFull() const;
+    qreal stagedDuration() const;
+    // jitter buffer. called with staging_mutex locked
+    void measureJitter(int stream, qreal pts);
+    void updateJitterStatistics();
+    // true if packets can be dispatched. otherwise wait for a while
+    bool waitForJitterBuffer();
+    // dispatch stage. wait at most timeout ms if no packet is staged
+    bool takePacket(Packet *pkt, int *stream, int timeout);
+    void clearStaging();
     bool paused, seeking;
+    bool pause_after_seek;
     volatile bool end;
+    // seek mailbox, protected by seek_mutex
+    QMutex seek_mutex;
+    qint64 seek_pos;
+    bool seek_preview;
+    QElapsedTimer seek_timer;
+    // used in demux thread
+    bool preview, preview_done;
+    volatile bool key_frame_only;
+    bool key_frame_only_applied;
+    qreal key_frame_interval, last_key_pts;
     AVDemuxer *demuxer;
     AVThread *audio_thread, *video_thread;
     int audio_stream, video_stream;
@@ -71,6 +152,38 @@ private:
     QWaitCondition cond, seek_cond;
 
     int running_threads;
+
+    class ReadThread;
+    friend class ReadThread;
+    ReadThread *read_thread;
+    // held by a read or a seek. the staged packets are always read after the last seek
+    QMutex read_mutex;
+    struct StagedPacket {
+        Packet packet;
+        int stream;
+    };
+    mutable QMutex staging_mutex;
+    QWaitCondition staging_data_cond, staging_space_cond;
+    QQueue<StagedPacket> staging;
+    qint64 staging_bytes;
+    qint64 prefetch_bytes;
+    qreal prefetch_seconds;
+    bool read_end, stop_read;
+    // live mode. protected by staging_mutex
+    qreal last_pts;
+    qreal drop_pts; //<0: not dropping
+
+    // jitter buffer. protected by staging_mutex
+    bool jitter_enabled;
+    qreal jitter_floor, jitter_ceiling; //s
+    qreal jitter, jitter_target; //s
+    qreal last_transit; //arrival time - pts. <-1e9: none
+    int jitter_stream;
+    bool buffering, overflowing;
+    int underruns, overflows;
+    QElapsedTimer arrival_timer;
+    Statistics *statistics;
+    StreamRecorder *recorder;
 };
 
 } //namespace QtAV
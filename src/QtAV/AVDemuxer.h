@@ -41,12 +41,15 @@ struct AVCodec;
 struct AVFrame;
 struct AVStream;
 struct AVDictionary;
+class QIODevice;
 
 // TODO: force codec name. clean code
 namespace QtAV {
 
 class AVError;
 class Packet;
+class KeyFrameIndexer;
+class MediaIO;
 class Q_AV_EXPORT AVDemuxer : public QObject //QIODevice?
 {
     Q_OBJECT
@@ -73,6 +76,12 @@ public:
     bool atEnd() const;
     bool close();
     bool loadFile(const QString& fileName);
+    /*!
+     * take the opened input of other, which is loaded in another thread, e.g. by AVPreloader.
+     * other is closed. the codec contexts are not changed, so decoders opened with other's codec
+     * contexts can be used. the streams to play are selected again
+     */
+    bool moveFrom(AVDemuxer *other);
     bool isLoaded(const QString& fileName) const;
     bool prepareStreams(); //called by loadFile(). if change to a new stream, call it(e.g. in AVPlayer)
 
@@ -118,6 +127,12 @@ public:
     bool autoResetStream() const;
     //set stream by index in stream list
     bool setStreamIndex(StreamType st, int index);
+    /*!
+     * readFrame() skips the packets of discarded streams in av_read_frame(), so they are neither
+     * parsed nor copied. the streams not in the list are discarded. keyFrameOnly: only the key frames
+     * of the listed streams are read. call it after loadFile() and when no readFrame() is running
+     */
+    void discardStreamsExcept(const QList<int>& streams, bool keyFrameOnly = false);
     // current open stream
     int currentStream(StreamType st) const;
     QList<int> streams(StreamType st) const;
@@ -178,6 +193,54 @@ public:
     void setOptions(const QHash<QByteArray, QByteArray>& dict);
     QHash<QByteArray, QByteArray> options() const;
 
+    /*!
+     * build a key frame index of the video stream in a thread when a local file is loaded.
+     * seek() is a byte seek to the key frame found in the index once the index is ready.
+     * useful for formats without a good index, e.g. mpeg-ts. default is false
+     */
+    void setKeyFrameIndexEnabled(bool enabled);
+    bool isKeyFrameIndexEnabled() const;
+    // empty: do not save the index. default is KeyFrameIndex::defaultCacheDir()
+    void setKeyFrameIndexCacheDir(const QString& dir);
+    QString keyFrameIndexCacheDir() const;
+    /*!
+     * cache the streams and codec parameters found in a local file. the next load of the same
+     * file(same path, size and modification time) probes only a few packets, and probes again if
+     * the streams do not match. the cache is shared by all demuxers. default is false
+     */
+    void setProbeCacheEnabled(bool enabled);
+    bool isProbeCacheEnabled() const;
+    /*!
+     * read the media from an opened device instead of the file name passed to loadFile(), e.g. data
+     * in memory, in qt resources or decrypted by a QIODevice. the file name is only a name and a
+     * format hint. the device is not owned. a sequential device is read ahead in its own thread,
+     * which must run an event loop, and can not be seeked or loaded twice. if loadFile() is called in
+     * the device's thread, the event loop is blocked and waitForReadyRead() is used, so a device
+     * without it, e.g. QNetworkReply, fails after getInterruptTimeout(). 0: use the file name(default)
+     */
+    void setIODevice(QIODevice *device);
+    QIODevice* ioDevice() const;
+    /*!
+     * size of the AVIOContext buffer of the custom input. a sequential device is read ahead up to
+     * 64x the size. default is 32KB
+     */
+    void setIOBufferSize(int bytes);
+    int ioBufferSize() const;
+    /*!
+     * read a local file mapped into memory instead of the ffmpeg file protocol. no read() system
+     * call, and the kernel is advised to read ahead from the current position. falls back to the
+     * file protocol if the file can not be mapped. default is false
+     */
+    void setMMapEnabled(bool enabled);
+    bool isMMapEnabled() const;
+    /*!
+     * for live streams. probe only a few packets and do not buffer in the demuxer, so the first
+     * frame comes soon and packets are read as soon as received. the format options set by
+     * setOptions() are still applied. default is false
+     */
+    void setLowLatency(bool value);
+    bool isLowLatency() const;
+
 signals:
     /*emit when the first frame is read*/
     void started();
@@ -199,6 +262,9 @@ private:
     // set wanted_xx_stream. call openCodecs() to read new stream frames
     bool setStream(StreamType st, int stream);
     bool findStreams();
+    void startKeyFrameIndexer();
+    // remove the probe cache of the file and load again
+    bool reloadWithoutProbeCache(const QString& fileName);
     QString formatName(AVFormatContext *ctx, bool longName = false) const;
 
     bool _is_input;
@@ -207,7 +273,6 @@ private:
     //copy the info, not parse the file when constructed, then need member vars
     QString _file_name;
     QMutex mutex; //for seek and readFrame
-    QElapsedTimer seek_timer;
 
     SeekUnit mSeekUnit;
     SeekTarget mSeekTarget;
@@ -217,6 +282,17 @@ private:
 
     AVDictionary *mpDict;
     QHash<QByteArray, QByteArray> mOptions;
+
+    bool mIndexEnabled;
+    QString mIndexCacheDir;
+    KeyFrameIndexer *mpIndexer;
+    bool mProbeCache;
+
+    QIODevice *mpDevice;
+    MediaIO *mpIO;
+    int mIOBufferSize;
+    bool mMMap;
+    bool mLowLatency;
 };
 
 } //namespace QtAV
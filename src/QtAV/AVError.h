@@ -47,6 +47,7 @@ public:
         CloseCodecError,
         DecodeError,
         ResampleError,
+        WriteError,
 
         UnknowError
     };
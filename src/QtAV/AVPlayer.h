@@ -44,7 +44,13 @@ class AVClock;
 class AVDemuxThread;
 class Filter;
 class VideoCapture;
+class StreamRecorder;
+class FrameExporter;
+class FrameSink;
 class OutputSet;
+class GOPCache;
+class AVPreloader;
+class ImageConverter;
 class Q_AV_EXPORT AVPlayer : public QObject
 {
     Q_OBJECT
@@ -56,6 +62,7 @@ class Q_AV_EXPORT AVPlayer : public QObject
     Q_PROPERTY(int brightness READ brightness WRITE setBrightness NOTIFY brightnessChanged)
     Q_PROPERTY(int contrast READ contrast WRITE setContrast NOTIFY contrastChanged)
     Q_PROPERTY(int saturation READ saturation WRITE setSaturation NOTIFY saturationChanged)
+    Q_PROPERTY(bool loading READ isLoading NOTIFY loadingChanged)
 public:
     explicit AVPlayer(QObject *parent = 0);
     ~AVPlayer();
@@ -65,10 +72,40 @@ public:
     // If path is different from previous one, the stream to play will be reset to default.
     void setFile(const QString& path);
     QString file() const;
+    /*!
+     * \brief setIODevice
+     * play the data read from an opened device, e.g. a QBuffer or a decrypting device. file() is a
+     * name of the device. setFile() releases it. the device is not owned and must be alive while
+     * playing. a sequential device is read ahead in its own thread, which must run an event loop,
+     * and can not seek or replay. load() in the device's thread blocks the event loop: use loadAsync()
+     * for a device without waitForReadyRead(), e.g. QNetworkReply.
+     * see AVDemuxer::setIODevice()
+     */
+    void setIODevice(QIODevice *device);
+    QIODevice* ioDevice() const;
     // force reload even if already loaded. otherwise only reopen codecs if necessary
     bool load(const QString& path, bool reload = true);
     bool load(bool reload = true);
     bool isLoaded() const;
+    /*!
+     * \brief setNextFile
+     * gapless playback. open the file, probe the streams and open the decoders in a thread while
+     * playing. when the current file reaches the end, the next file starts without opening it again,
+     * and the audio device is not reopened if the audio format is the same.
+     * play(path) and load(path) use the preloaded file too. empty path: cancel
+     */
+    void setNextFile(const QString& path);
+    QString nextFile() const;
+    /*!
+     * \brief loadAsync
+     * open the file, probe the streams and open the decoders in a thread, then emit loaded() or
+     * error() in the player's thread. The caller is never blocked. setFile() with another path
+     * cancels it. play() before loaded() starts playing when loaded.
+     * If a file is playing, the new file is used by the next play()
+     */
+    void loadAsync(const QString& path);
+    void loadAsync();
+    bool isLoading() const;
     qreal durationF() const; //unit: s, This function may be removed in the future.
     qint64 duration() const; //unit: ms. media duration. network stream may be very small, why?
     // the media's property.
@@ -109,6 +146,14 @@ public:
     bool setAudioStream(int n, bool now = false);
     bool setVideoStream(int n, bool now = false);
     bool setSubtitleStream(int n, bool now = false);
+    /*!
+     * \brief setAudioOnly
+     * do not read and decode video. the video stream is discarded by the demuxer, and the video
+     * decoder and thread are released. if playing, playback restarts at the current position like
+     * setAudioStream(n, true). no effect if there is no audio
+     */
+    void setAudioOnly(bool value);
+    bool isAudioOnly() const;
     int currentAudioStream() const;
     int currentVideoStream() const;
     int currentSubtitleStream() const;
@@ -123,6 +168,21 @@ public:
      */
     bool captureVideo();
     VideoCapture *videoCapture();
+    /*!
+     * \brief startRecording
+     * write the playing audio and video packets to fileName without re-encoding, e.g. record a
+     * camera. format: ffmpeg muxer name, e.g. "mp4", "matroska", "mpegts". empty: guess from
+     * fileName. recording stops when playback stops. see StreamRecorder
+     */
+    bool startRecording(const QString& fileName, const QString& format = QString());
+    void stopRecording();
+    bool isRecording() const;
+    StreamRecorder *recorder();
+    /*!
+     * export decoded frames as an image sequence. start the exporter before play(), it's stopped
+     * when playback stops. see FrameExporter
+     */
+    FrameExporter *frameExporter();
     /*
      * replay without parsing the stream if it's already loaded. (not implemented)
      * to force reload the stream, close() then play()
@@ -159,6 +219,90 @@ public:
      */
     void setSpeed(qreal speed);
     qreal speed() const;
+    /*!
+     * \brief setKeyFrameOnlySpeed
+     * trick play. if speed() >= speed, only video key frames are demuxed and decoded, spaced to
+     * match the speed, and audio is muted. the clock is external in this mode.
+     * speed <= 0: disable. default is 4.0
+     */
+    void setKeyFrameOnlySpeed(qreal speed);
+    qreal keyFrameOnlySpeed() const;
+    /*!
+     * \brief setLoudnessMeterEnabled
+     * measure EBU R128 loudness, true peak and rms of the audio output. results are in
+     * statistics().audio_only.loudness()
+     */
+    void setLoudnessMeterEnabled(bool enabled);
+    bool isLoudnessMeterEnabled() const;
+    /*!
+     * \brief setKeyFrameIndexEnabled
+     * index the video key frames of a local file in a thread when it's loaded, then seek by the
+     * index. the index is cached. see AVDemuxer::setKeyFrameIndexEnabled()
+     */
+    void setKeyFrameIndexEnabled(bool enabled);
+    bool isKeyFrameIndexEnabled() const;
+    /*!
+     * \brief setProbeCacheEnabled
+     * reuse the stream info of a local file opened before to reduce the time to the first frame.
+     * see AVDemuxer::setProbeCacheEnabled()
+     */
+    void setProbeCacheEnabled(bool enabled);
+    bool isProbeCacheEnabled() const;
+    /*!
+     * \brief setMMapEnabled
+     * read local files mapped into memory. see AVDemuxer::setMMapEnabled()
+     */
+    void setMMapEnabled(bool enabled);
+    bool isMMapEnabled() const;
+    /*!
+     * \brief setPrefetchLimit
+     * packets are read ahead in a thread until bytes or seconds are buffered, which absorbs slow
+     * reads, e.g. from a network share. see AVDemuxThread::setPrefetchLimit()
+     */
+    void setPrefetchLimit(qint64 bytes, qreal seconds);
+    qint64 prefetchBytes() const;
+    qreal prefetchDuration() const;
+    /*!
+     * \brief setLiveMode
+     * low latency playback of a live stream, e.g. rtsp or udp. applied at the next load: the stream
+     * is probed briefly, the decoder does not delay frames and the queues are shallow. while playing,
+     * latency() is kept around latencyTarget(): playback is a little faster if it's above the
+     * target, and packets are dropped to a key frame if it's far above the target
+     */
+    void setLiveMode(bool value);
+    bool isLiveMode() const;
+    // ms. default is 300
+    void setLatencyTarget(int ms);
+    int latencyTarget() const;
+    // ms. the duration of the media read but not played yet. -1 if unknown
+    int latency() const;
+    /*!
+     * \brief setJitterBufferEnabled
+     * smooth the bursty arrival of a network stream. the depth of the prefetch buffer follows the
+     * measured jitter between floor and ceiling(ms, default 100 and 2000), and playback waits while
+     * it's filled after an underrun. see Statistics::jitterBuffer()
+     */
+    void setJitterBufferEnabled(bool enabled);
+    bool isJitterBufferEnabled() const;
+    void setJitterBufferRange(int floorMs, int ceilingMs);
+    /*!
+     * \brief setAccurateSeek
+     * true: seek to the exact frame. frames from the previous key frame to the target are decoded
+     * but not rendered, and audio starts at the target sample. false: seek to the key frame(default)
+     */
+    void setAccurateSeek(bool accurate);
+    bool isAccurateSeek() const;
+    /*!
+     * \brief setReversePlayback
+     * play backward from the current position at speed(). GOPs are decoded forward in a thread into a
+     * frame cache and presented in reverse order, the previous GOP is prefetched. audio is paused.
+     * false: stop at the current frame. pause(false) plays forward from there
+     */
+    void setReversePlayback(bool reverse);
+    bool isReversePlayback() const;
+    // MB. memory limit of the decoded frames for reverse playback and playPreviousFrame(). default is 256
+    void setFrameCacheLimit(int mb);
+    int frameCacheLimit() const;
 
     Statistics& statistics();
     const Statistics& statistics() const;
@@ -170,6 +314,14 @@ public:
     bool installAudioFilter(Filter *filter);
     bool installVideoFilter(Filter *filter);
     bool uninstallFilter(Filter *filter);
+    /*
+     * tap the decoded frames before conversion, e.g. for analysis. the sink is not owned. it's
+     * installed when the video thread is ready. after uninstallFrameSink(), the sink may be used
+     * until the video thread processes the next task, close() the sink if it blocks the thread.
+     * delete the sink after frameSinkUninstalled()
+     */
+    bool installFrameSink(FrameSink *sink);
+    bool uninstallFrameSink(FrameSink *sink);
 
     void setPriority(const QVector<VideoDecoderId>& ids);
     //void setPriority(const QVector<AudioOutputId>& ids);
@@ -195,6 +347,11 @@ public:
 
 signals:
     void error(const QtAV::AVError& e); //explictly use QtAV::AVError in connection for Qt4 syntax
+    // loadAsync() finished
+    void loaded();
+    // the video thread does not use the sink any more. see uninstallFrameSink()
+    void frameSinkUninstalled(QtAV::FrameSink *sink);
+    void loadingChanged(bool loading);
     void paused(bool p);
     void started();
     void stopped();
@@ -204,6 +361,10 @@ signals:
     void startPositionChanged(qint64 position);
     void stopPositionChanged(qint64 position);
     void positionChanged(qint64 position);
+    // the video frame at the seek target is presented. emitted for accurate seek and seek when paused
+    void seekFinished();
+    // waiting for the jitter buffer to be filled
+    void bufferingChanged(bool buffering);
     void brightnessChanged(int val);
     void contrastChanged(int val);
     void saturationChanged(int val);
@@ -214,6 +375,8 @@ public slots:
     void play(); //replay
     void stop();
     void playNextFrame();
+    // step backward 1 frame from the frame cache. the player is paused
+    void playPreviousFrame();
 
     /*!
      * \brief setRepeat
@@ -259,6 +422,10 @@ public slots:
 
 private slots:
     void stopFromDemuxerThread();
+    // play the preloaded next file at the end of the current file
+    void playNextFile();
+    void onAsyncLoadFinished();
+    void onBufferingChanged(bool buffering);
     void aboutToQuitApp();
     // start/stop notify timer in this thread. use QMetaObject::invokeMethod
     void startNotifyTimer();
@@ -274,6 +441,22 @@ private:
     bool setupVideoThread();
     template<class Out>
     void setAVOutput(Out*& pOut, Out* pNew, AVThread* thread);
+    // pause and present frames from gop_cache
+    bool enterFrameCache();
+    // seek: continue from the last cached frame
+    void leaveFrameCache(bool seek);
+    void startFrameCacheTimer(int ms);
+    void presentCachedFrame();
+    // live mode catch up. called by live_timer_id
+    void checkLatency();
+    // speed() and the catch up speed
+    void applySpeed();
+    // enter or leave trick play for the current speed
+    void updateKeyFrameOnly();
+    AVPreloader* createPreloader(const QString& path);
+    // cancel and delete it when finished
+    void discardPreloader(AVPreloader*& loader);
+    void setLoading(bool value);
     //TODO: addAVOutput()
 
 
@@ -281,6 +464,7 @@ private:
     bool loaded;
     AVFormatContext	*formatCtx; //changed when reading a packet
     QString path;
+    QIODevice *io_device;
     qint64 media_end_pos;
     /*
      * unit: s. 0~1. stream's start time/duration(). or last position/duration() if change to new stream
@@ -306,15 +490,52 @@ private:
     VideoThread *video_thread;
 
     VideoCapture *video_capture;
+    StreamRecorder *stream_recorder;
+    FrameExporter *frame_exporter;
+    QList<FrameSink*> frame_sinks;
     Statistics mStatistics;
     qreal mSpeed;
     bool ao_enable;
+    bool mLoudnessMeter;
     OutputSet *mpVOSet, *mpAOSet;
     QVector<VideoDecoderId> vcodec_ids;
 
     int mBrightness, mContrast, mSaturation;
 
     QHash<QByteArray, QByteArray> audio_codec_opt, video_codec_opt;
+    bool audio_only;
+
+    // reverse playback and backward stepping. frames are from gop_cache if cache_pts >= 0
+    GOPCache *gop_cache;
+    ImageConverter *cache_conv;
+    qreal cache_pts;
+    int cache_steps; //<0: backward, >0: forward
+    int cache_timer_id;
+    int cache_limit;
+    bool reverse;
+
+    // trick play
+    qreal key_frame_only_speed;
+    bool key_frame_only;
+    AVClock::ClockType key_frame_only_clock; //clock type to restore
+
+    // live mode
+    bool live_mode;
+    int latency_target;
+    int live_timer_id;
+    qreal catch_up_speed; //1.0: not catching up
+
+    // gapless playback
+    QString next_file;
+    AVPreloader *next_loader;
+    // loadAsync()
+    AVPreloader *async_loader;
+    bool loading;
+    bool play_after_load;
+    bool async_loaded; //play() does not load again
+    // opened by a preloader. used by setupAudioThread() and setupVideoThread()
+    AudioDecoder *preloaded_audio_dec;
+    VideoDecoder *preloaded_video_dec;
 };
 
 } //namespace QtAV
@@ -0,0 +1,83 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_AVPRELOADER_H
+#define QTAV_AVPRELOADER_H
+
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/AVError.h>
+#include <QtAV/VideoDecoderTypes.h>
+#include <QtCore/QHash>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+/*
+ * Open a file, probe the streams and open the decoders in a thread. Used by AVPlayer to load
+ * the next file while playing and to load without blocking the caller. When finished, the player
+ * takes the demuxer's input by AVDemuxer::moveFrom() and the decoders.
+ * A loader can not be reused. cancel() it, then delete it when finished.
+ */
+namespace QtAV {
+
+class AudioDecoder;
+class VideoDecoder;
+class Q_AV_EXPORT AVPreloader : public QThread
+{
+    Q_OBJECT
+public:
+    AVPreloader(const QString& file, QObject *parent = 0);
+    ~AVPreloader();
+    QString file() const;
+    // call them before start()
+    void setFormatOptions(const QHash<QByteArray, QByteArray>& dict);
+    void setAudioCodecOptions(const QHash<QByteArray, QByteArray>& dict);
+    void setVideoCodecOptions(const QHash<QByteArray, QByteArray>& dict);
+    void setVideoDecoders(const QVector<VideoDecoderId>& ids);
+    // interrupt the blocking io. the thread finishes soon
+    void cancel();
+    bool isCancelled() const;
+    // finished without error. the demuxer and decoders can be taken
+    bool isReady() const;
+    AVError error() const;
+    AVDemuxer* demuxer();
+    // the caller owns the decoder. null if no such stream or failed to open
+    AudioDecoder* takeAudioDecoder();
+    VideoDecoder* takeVideoDecoder();
+
+protected:
+    virtual void run();
+
+private slots:
+    void setError(const QtAV::AVError& e);
+
+private:
+    volatile bool cancelled;
+    bool ready;
+    QString media_file;
+    AVDemuxer dmx;
+    AVError err;
+    QHash<QByteArray, QByteArray> audio_codec_opt, video_codec_opt;
+    QVector<VideoDecoderId> vcodec_ids;
+    AudioDecoder *audio_dec;
+    VideoDecoder *video_dec;
+};
+
+} //namespace QtAV
+#endif // QTAV_AVPRELOADER_H
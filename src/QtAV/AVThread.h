@@ -76,6 +76,16 @@ public:
 
     // TODO: resample, resize task etc.
     void scheduleTask(QRunnable *task);
+    /*!
+     * accurate seek. The target is used after the next flush packet(i.e. an invalid packet) is taken.
+     * the frames before the target are decoded but not converted or presented.
+     * pauseAfterSeek: pause the thread after the target is presented. e.g. seek when paused
+     */
+    void setSeekTarget(qreal pts, bool pauseAfterSeek = false);
+
+signals:
+    // emitted when the frame at the target set by setSeekTarget() is presented
+    void seekFinished(qreal pts);
 
 public slots:
     virtual void stop();
@@ -93,6 +103,10 @@ protected:
     // has timeout so that the pending tasks can be processed
     bool tryPause(int timeout = 100);
     bool processNextTask(); //in AVThread
+    // call it when a flush packet is taken. the pending seek target becomes the current one
+    void takeSeekTarget();
+    // call it after the frame at the seek target is presented
+    void finishSeek(qreal pts);
 
     DPTR_DECLARE(AVThread)
 
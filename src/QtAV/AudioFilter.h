@@ -0,0 +1,63 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_AUDIOFILTER_H
+#define QTAV_AUDIOFILTER_H
+
+#include <QtAV/Filter.h>
+#include <QtAV/AudioFormat.h>
+
+/*
+ * AudioFilter works on an AudioFrame in AudioThread. The frame passed to process(Statistics*, Frame*)
+ * is an AudioFrame in requiredSampleFormat() and with requiredChannels(). AudioThread groups the
+ * filters with the same requirement so that a frame is converted only when needed.
+ * example:
+ *    class GainFilter : public AudioFilter {
+ *    public:
+ *        AudioFormat::SampleFormat requiredSampleFormat() const { return AudioFormat::SampleFormat_FloatPlanar; }
+ *    protected:
+ *        void process(Statistics*, Frame* frame) {
+ *            AudioFrame *af = static_cast<AudioFrame*>(frame);
+ *            for (int c = 0; c < af->channelCount(); ++c) {
+ *                float *s = af->samples<float>(c);
+ *                ...
+ *            }
+ *        }
+ *    };
+ */
+namespace QtAV {
+
+class Q_AV_EXPORT AudioFilter : public Filter
+{
+public:
+    AudioFilter();
+    virtual ~AudioFilter();
+    // SampleFormat_Unknown(default): the filter accepts any format
+    virtual AudioFormat::SampleFormat requiredSampleFormat() const;
+    // 0(default): the filter accepts any channel count
+    virtual int requiredChannels() const;
+protected:
+    AudioFilter(FilterPrivate& d);
+};
+
+} //namespace QtAV
+
+#endif // QTAV_AUDIOFILTER_H
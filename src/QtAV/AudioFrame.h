@@ -23,6 +23,7 @@
 #define QTAV_AUDIOFRAME_H
 
 #include <QtAV/Frame.h>
+#include <QtAV/AudioFormat.h>
 
 namespace QtAV {
 
@@ -32,11 +33,58 @@ class Q_AV_EXPORT AudioFrame : public Frame
     Q_DECLARE_PRIVATE(AudioFrame)
 public:
     AudioFrame();
+    //must call setSamplesPerChannel() and allocate() or set planes and linesize manually
+    AudioFrame(const AudioFormat& format);
+    /*!
+     * wrap the samples in data. data is shared until the frame is written.
+     * samples per channel is computed from the data size.
+     */
+    AudioFrame(const QByteArray& data, const AudioFormat& format);
     AudioFrame(const AudioFrame &other);
     virtual ~AudioFrame();
 
     AudioFrame &operator =(const AudioFrame &other);
 
+    bool isValid() const;
+    // Deep copy. planes of the result are aligned
+    AudioFrame clone() const;
+    /*!
+     * Allocate memory for format() and samplesPerChannel(). planes and bytesPerLine will be set.
+     * Each plane starts at a kAlignment bytes aligned address so that filters can use simd
+     * load/store.
+     */
+    virtual int allocate();
+    AudioFormat format() const;
+    int channelCount() const;
+    /*!
+     * samples in 1 channel. for packed format, plane 0 contains samplesPerChannel()*channelCount() samples
+     */
+    int samplesPerChannel() const;
+    void setSamplesPerChannel(int samples);
+    // in seconds
+    qreal duration() const;
+    /*!
+     * typed access to a plane. T must match format().sampleFormat(), e.g. float for
+     * SampleFormat_Float and SampleFormat_FloatPlanar. Writing through the returned pointer is
+     * in place. If the samples are shared with a QByteArray outside the frame, they are detached
+     * first. Copies of the frame share the same samples as AudioFrame is explicitly shared.
+     */
+    template<typename T> T* samples(int plane = 0) { return reinterpret_cast<T*>(writableBits(plane)); }
+    template<typename T> const T* constSamples(int plane = 0) const { return reinterpret_cast<const T*>(bits(plane)); }
+    /*!
+     * convert sample format and channels. sample rate is not changed (use AudioResampler).
+     * return a new frame, or this frame if fmt is the same as format()
+     */
+    AudioFrame to(const AudioFormat& fmt) const;
+    /*!
+     * Returns the samples as 1 continuous buffer without alignment padding. For planar format
+     * the planes are appended in channel order.
+     */
+    QByteArray samplesData() const;
+
+    static const int kAlignment;
+private:
+    uchar* writableBits(int plane);
 };
 
 } //namespace QtAV
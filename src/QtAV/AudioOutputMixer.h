@@ -0,0 +1,119 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_AUDIOOUTPUTMIXER_H
+#define QTAV_AUDIOOUTPUTMIXER_H
+
+#include <QtAV/AudioOutput.h>
+#include <QtAV/AudioFormat.h>
+#include <QtCore/QThread>
+
+/*
+ * Mix the audio of several players into 1 device stream.
+ * AudioMixer owns the real device output and a thread which pulls a period from every source,
+ * applies the source's gain and pan on a float bus and writes the result to the device.
+ * AudioOutputMixer is the source a player writes to. write() blocks while the source has enough
+ * data queued, so the player's AudioThread is paced by the device like a normal output, and the
+ * audio clock of each player still follows its own samples.
+ * example:
+ *    AVPlayer player1, player2;
+ *    player1.setAudioOutput(AudioOutputFactory::create(AudioOutputId_Mixer));
+ *    player2.setAudioOutput(AudioOutputFactory::create(AudioOutputId_Mixer));
+ *    static_cast<AudioOutputMixer*>(player2.audio())->setPan(0.5);
+ */
+namespace QtAV {
+
+class AudioOutputMixer;
+class AudioMixerPrivate;
+class Q_AV_EXPORT AudioMixer : public QThread
+{
+    DPTR_DECLARE_PRIVATE(AudioMixer)
+public:
+    // the mixer used by AudioOutputMixer if no mixer is set
+    static AudioMixer& instance();
+
+    AudioMixer(QObject *parent = 0);
+    ~AudioMixer();
+    /*!
+     * the device output created by AudioOutputFactory. default is PortAudio, or OpenAL if PortAudio
+     * is not available. can not be AudioOutputId_Mixer. Call it before any source is opened.
+     */
+    void setDevice(AudioOutputId id);
+    AudioOutputId device() const;
+    /*!
+     * the bus format. Sample format is always SampleFormat_Float. Sources are resampled to this
+     * format by their players. Call it before any source is opened. default is 48000Hz stereo
+     */
+    void setSampleRate(int rate);
+    void setChannels(int channels);
+    const AudioFormat& audioFormat() const;
+    // samples per channel mixed in 1 loop. default is 1024
+    void setPeriodSize(int samples);
+    int periodSize() const;
+    int sourceCount() const;
+    // stop the mixing thread and close the device. it starts again when a source is added
+    void stop();
+
+protected:
+    virtual void run();
+
+private:
+    bool addSource(AudioOutputMixer *source);
+    void removeSource(AudioOutputMixer *source);
+    friend class AudioOutputMixer;
+    DPTR_DECLARE(AudioMixer)
+};
+
+class AudioOutputMixerPrivate;
+class Q_AV_EXPORT AudioOutputMixer : public AudioOutput
+{
+    DPTR_DECLARE_PRIVATE(AudioOutputMixer)
+public:
+    AudioOutputMixer();
+    ~AudioOutputMixer();
+    // call it before open(). 0: AudioMixer::instance()
+    void setMixer(AudioMixer *mixer);
+    AudioMixer* mixer() const;
+    // add to the mixer. audioFormat() is changed to the bus format
+    virtual bool open();
+    virtual bool close();
+    // gain applied on the bus. the volume is already applied by AudioThread
+    void setGain(qreal gain);
+    qreal gain() const;
+    // [-1, 1]. -1: left only, 0: center, 1: right only. used only if the bus is stereo
+    void setPan(qreal pan);
+    qreal pan() const;
+    // in seconds. samples written but not mixed yet
+    qreal bufferedDuration() const;
+    // in seconds. samples mixed into the bus since open(). It's the clock of this source
+    qreal playedDuration() const;
+
+protected:
+    virtual bool write();
+
+private:
+    // called in mixer thread. read at most samples per channel. return samples per channel read
+    int read(float *dst, int samples);
+    friend class AudioMixer;
+};
+
+} //namespace QtAV
+#endif // QTAV_AUDIOOUTPUTMIXER_H
@@ -34,6 +34,9 @@ class AudioThread : public AVThread
     DPTR_DECLARE_PRIVATE(AudioThread)
 public:
     explicit AudioThread(QObject *parent = 0);
+    // measure loudness of the output and update Statistics::AudioOnly. the meter is reset when enabled
+    void setLoudnessMeterEnabled(bool enabled);
+    bool isLoudnessMeterEnabled() const;
 
 protected:
     virtual void run();
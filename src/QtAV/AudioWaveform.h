@@ -0,0 +1,108 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_AUDIOWAVEFORM_H
+#define QTAV_AUDIOWAVEFORM_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtAV/AVError.h>
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+
+/*
+ * Waveform overview of the audio track of a file, e.g. for a seek bar or an editor timeline.
+ * Only the audio stream is demuxed and decoded, other streams are discarded by the demuxer.
+ * The file is split into time ranges which are decoded by worker threads of QThreadPool. Decoded
+ * samples are reduced to min, max and rms of every bucketSize() samples per channel (level 0),
+ * then level n+1 is built by merging 2 buckets of level n until 1 bucket is left.
+ * Level 0 is saved in a sidecar file in cacheDir() whose name is computed from the file path, size
+ * and modification time, so opening the same file again does not decode anything.
+ * example:
+ *    AudioWaveform *wf = new AudioWaveform(this);
+ *    connect(wf, SIGNAL(ready()), SLOT(updateWaveform()));
+ *    wf->setFile(file);
+ *    wf->start();
+ *    ...
+ *    QVector<AudioWaveform::Peak> peaks = wf->peaks(wf->levelForBuckets(width()));
+ */
+namespace QtAV {
+
+class AudioWaveformPrivate;
+class Q_AV_EXPORT AudioWaveform : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(AudioWaveform)
+public:
+    // all channels are reduced together. values are in [-1, 1]
+    struct Peak {
+        float min;
+        float max;
+        float rms;
+    };
+
+    explicit AudioWaveform(QObject *parent = 0);
+    ~AudioWaveform();
+    // local file is required to split the work. other urls are decoded in 1 thread
+    void setFile(const QString& file);
+    QString file() const;
+    // empty: do not use the sidecar cache. default is "waveform" in the cache location
+    void setCacheDir(const QString& dir);
+    QString cacheDir() const;
+    // samples per channel in 1 bucket of level 0. default is 256
+    void setBucketSize(int samples);
+    // max worker threads. default is QThread::idealThreadCount()
+    void setThreadCount(int count);
+    int threadCount() const;
+    /*!
+     * load the sidecar cache or start decoding. ready() or error() will be emitted.
+     * return false if it's running.
+     */
+    bool start();
+    // stop the workers. no signal will be emitted
+    void cancel();
+    bool isRunning() const;
+    bool isReady() const;
+
+    int sampleRate() const;
+    int channels() const;
+    // samples per channel
+    qint64 samples() const;
+    // ms
+    qint64 duration() const;
+    int levelCount() const;
+    // samples per channel in 1 bucket of the given level
+    int bucketSize(int level = 0) const;
+    QVector<Peak> peaks(int level = 0) const;
+    // the coarsest level which has at least count buckets, e.g. count is the width in pixels
+    int levelForBuckets(int count) const;
+
+signals:
+    // [0, 1]
+    void progress(qreal value);
+    void ready();
+    void error(const QtAV::AVError& e);
+
+private:
+    friend class WaveformTask;
+    DPTR_DECLARE(AudioWaveform)
+};
+
+} //namespace QtAV
+#endif // QTAV_AUDIOWAVEFORM_H
@@ -0,0 +1,145 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_BOUNDEDQUEUE_H
+#define QTAV_BOUNDEDQUEUE_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+
+// what to do with a new item if a BoundedQueue is full
+enum DropPolicy {
+    Block, //the producer waits
+    DropOldest, //the oldest queued item is dropped
+    DropNewest //the new item is dropped
+};
+
+/*!
+ * A queue with a capacity and a DropPolicy. It is not locked itself, the owner protects it with its
+ * mutex and wakes the condition used in put() after taking items.
+ */
+template <typename T>
+class BoundedQueue : public QQueue<T>
+{
+public:
+    BoundedQueue(int capacity, DropPolicy policy);
+
+    void setCapacity(int max); //at least 1
+    int capacity() const;
+    void setDropPolicy(DropPolicy policy);
+    DropPolicy dropPolicy() const;
+    int droppedCount() const; //items dropped by put()
+    bool isFull() const;
+    // DropNewest and full: count a new item as dropped and return true. used to skip preparing the item
+    bool dropNewest();
+    /*!
+     * queue t. called with mutex locked. Block: wait on cond until there is room or *abort is true.
+     * the dropped oldest item is returned in removed, so the caller can release it.
+     * return false if t is not queued (dropped, or aborted)
+     */
+    bool put(const T& t, QMutex *mutex, QWaitCondition *cond, const volatile bool *abort = 0, T *removed = 0);
+
+private:
+    int cap;
+    DropPolicy policy;
+    int dropped;
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(int capacity, DropPolicy policy)
+    : cap(qMax(capacity, 1))
+    , policy(policy)
+    , dropped(0)
+{
+}
+
+template <typename T>
+void BoundedQueue<T>::setCapacity(int max)
+{
+    cap = qMax(max, 1);
+}
+
+template <typename T>
+int BoundedQueue<T>::capacity() const
+{
+    return cap;
+}
+
+template <typename T>
+void BoundedQueue<T>::setDropPolicy(DropPolicy policy)
+{
+    this->policy = policy;
+}
+
+template <typename T>
+DropPolicy BoundedQueue<T>::dropPolicy() const
+{
+    return policy;
+}
+
+template <typename T>
+int BoundedQueue<T>::droppedCount() const
+{
+    return dropped;
+}
+
+template <typename T>
+bool BoundedQueue<T>::isFull() const
+{
+    return this->size() >= cap;
+}
+
+template <typename T>
+bool BoundedQueue<T>::dropNewest()
+{
+    if (policy != DropNewest || !isFull())
+        return false;
+    ++dropped;
+    return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::put(const T &t, QMutex *mutex, QWaitCondition *cond, const volatile bool *abort, T *removed)
+{
+    if (isFull()) {
+        if (policy == Block) {
+            while (isFull() && !(abort && *abort))
+                cond->wait(mutex);
+            if (abort && *abort)
+                return false;
+        } else {
+            if (dropNewest())
+                return false;
+            ++dropped;
+            const T old(this->dequeue());
+            if (removed)
+                *removed = old;
+        }
+    }
+    this->enqueue(t);
+    return true;
+}
+
+} //namespace QtAV
+#endif // QTAV_BOUNDEDQUEUE_H
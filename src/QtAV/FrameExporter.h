@@ -0,0 +1,118 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMEEXPORTER_H
+#define QTAV_FRAMEEXPORTER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+
+/*
+ * Export every Nth decoded frame or the frames at scene changes as an image sequence. The frames are
+ * selected in the video thread in the decoded format, copied once and then scaled and encoded by a
+ * pool of workers, so the video thread only pays for the copy. Files are named by the export index,
+ * e.g. frame_000012.jpg, and manifest.csv in the output dir lists "index,pts,file" in index order
+ * even if the workers finish out of order. The memory of the frames in flight is limited by
+ * setMemoryBudget(): the video thread waits if it's exceeded, so no frame is dropped.
+ * If unthrottled, the video thread does not wait for the clock while exporting, so the export speed
+ * is limited by the decoder and the workers. Disable audio (AVPlayer::enableAudio(false)) in this
+ * case, otherwise the audio output still plays in real time and slows down the demuxer.
+ * example:
+ *    FrameExporter *e = player->frameExporter();
+ *    e->setMode(FrameExporter::SceneChange);
+ *    e->setOutputSize(QSize(320, 180));
+ *    e->start("/tmp/frames");
+ *    player->enableAudio(false);
+ *    player->play("movie.mkv"); //stopped when playback stops
+ */
+namespace QtAV {
+
+class VideoFrame;
+class FrameExporterPrivate;
+class Q_AV_EXPORT FrameExporter : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(FrameExporter)
+public:
+    enum Mode {
+        EveryNthFrame, //see setInterval()
+        SceneChange //see setSceneThreshold()
+    };
+    enum Format {
+        Jpeg,
+        Png,
+        RawYUV //planar yuv420p, lines are not padded
+    };
+
+    explicit FrameExporter(QObject *parent = 0);
+    // the running export is stopped
+    ~FrameExporter();
+    // default is EveryNthFrame
+    void setMode(Mode mode);
+    Mode mode() const;
+    // export 1 of every n decoded frames. default is 1
+    void setInterval(int n);
+    int interval() const;
+    // mean absolute luma difference [0, 255] to the last exported frame. default is 30
+    void setSceneThreshold(int threshold);
+    int sceneThreshold() const;
+    // default is Jpeg
+    void setFormat(Format format);
+    Format format() const;
+    // [0, 100], <0: default
+    void setQuality(int quality);
+    int quality() const;
+    // invalid size: the frame size. 1 of width and height can be <=0 to keep the aspect ratio
+    void setOutputSize(const QSize& size);
+    QSize outputSize() const;
+    // default is "frame_"
+    void setNamePrefix(const QString& prefix);
+    QString namePrefix() const;
+    // encoding threads. default is QThread::idealThreadCount()
+    void setThreadCount(int count);
+    int threadCount() const;
+    // bytes of the decoded frames not encoded yet. default is 256MB
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+    // don't sync the video thread to the clock while exporting. default is true
+    void setUnthrottled(bool value);
+    bool isUnthrottled() const;
+    // change the settings above before start(). return false if running or dir can not be created
+    bool start(const QString& dir);
+    // wait for the frames in flight, then write the manifest. finished() is emitted
+    void stop();
+    bool isRunning() const;
+    // frames written
+    int exportedCount() const;
+    // called by the video thread for every decoded frame before conversion. thread safe
+    void process(const VideoFrame& frame, qreal pts);
+
+signals:
+    void finished(int count);
+
+private:
+    friend class ExportWorker;
+    DPTR_DECLARE(FrameExporter)
+};
+
+} //namespace QtAV
+#endif // QTAV_FRAMEEXPORTER_H
@@ -0,0 +1,111 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMESINK_H
+#define QTAV_FRAMESINK_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtAV/BoundedQueue.h>
+#include <QtAV/VideoFrame.h>
+#include <QtCore/QSize>
+
+/*
+ * Tap the decoded video frames before they are converted for the renderers. A frame is delivered in
+ * the decoded format (e.g. yuv420p planes), or downscaled and/or luma only (gray8) if the consumer,
+ * e.g. motion detection or OCR, does not need the full frame. Downscaling is done in the video
+ * thread while copying the frame, so it costs less than copying the full frame.
+ * The frames are queued. Pull them with take() in the consumer thread, or reimplement receive() and
+ * setPushMode(true) to get them in a delivery thread. If the queue is full, the drop policy decides.
+ * example:
+ *    FrameSink *sink = new FrameSink();
+ *    sink->setLumaOnly(true);
+ *    sink->setOutputSize(QSize(160, 0));
+ *    player->installFrameSink(sink);
+ *    // consumer thread
+ *    SinkFrame f;
+ *    while (sink->take(&f))
+ *        detectMotion(f.frame.bits(0), f.frame.bytesPerLine(0), f.frame.width(), f.frame.height());
+ */
+namespace QtAV {
+
+class Q_AV_EXPORT SinkFrame
+{
+public:
+    SinkFrame() : pts(0), stream(-1) {}
+    VideoFrame frame; //owns the data
+    qreal pts;
+    int stream; //index in the file
+};
+
+class FrameSinkPrivate;
+class Q_AV_EXPORT FrameSink
+{
+    DPTR_DECLARE_PRIVATE(FrameSink)
+public:
+    FrameSink();
+    // a subclass in push mode must call close() in its destructor
+    virtual ~FrameSink();
+    // a disabled sink does not copy the frames. default is true
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    // queued frames. default is 4
+    void setCapacity(int frames);
+    int capacity() const;
+    // what to do with a new frame if the queue is full. Block: the video thread waits. default is DropOldest
+    void setDropPolicy(DropPolicy policy);
+    DropPolicy dropPolicy() const;
+    // invalid size: the frame size. 1 of width and height can be <=0 to keep the aspect ratio
+    void setOutputSize(const QSize& size);
+    QSize outputSize() const;
+    // deliver the luma plane only in gray8. default is false
+    void setLumaOnly(bool value);
+    bool isLumaOnly() const;
+    /*!
+     * push: frames are delivered by calling receive() in a dedicated thread. pull: call take().
+     * It can be called in receive(). The thread exits after receive() returns and a new one starts
+     * when push mode is enabled again. default is false
+     */
+    void setPushMode(bool push);
+    bool isPushMode() const;
+    // timeout: ms, <0: wait forever. false if timeout or closed
+    bool take(SinkFrame* frame, int timeout = -1);
+    int queuedCount() const;
+    // frames dropped because the queue is full
+    int droppedCount() const;
+    // wake up take() and the blocked video thread, stop the push thread and clear the queue
+    void close();
+    // reopen after close()
+    void open();
+    bool isClosed() const;
+    // called by the video thread. thread safe
+    void put(const VideoFrame& frame, qreal pts, int stream);
+
+protected:
+    // called in the delivery thread in push mode
+    virtual void receive(const SinkFrame& frame);
+
+private:
+    friend class SinkThread;
+    DPTR_DECLARE(FrameSink)
+};
+
+} //namespace QtAV
+#endif // QTAV_FRAMESINK_H
@@ -0,0 +1,49 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMEUTILS_H
+#define QTAV_FRAMEUTILS_H
+
+#include <QtCore/QSize>
+
+/*
+ * Helpers to copy and convert decoded frames outside the video thread's converter, used by
+ * VideoCapture, FrameExporter, FrameSink and JpegEncoder.
+ */
+namespace QtAV {
+
+class ImageConverter;
+class VideoFrame;
+// planes and line sizes for ImageConverter::convert(). unused planes are 0
+void framePlanes(const VideoFrame& frame, const quint8 *planes[4], int strides[4]);
+/*!
+ * the size a frame of size is scaled to. invalid outSize: size. 1 of width and height can be <= 0
+ * to keep the aspect ratio. a scaled size is even for the subsampled chroma
+ */
+QSize scaledFrameSize(const QSize& size, const QSize& outSize);
+/*!
+ * convert to ffmpeg pixel format fffmt of size. conv is created if null. the result refers to the
+ * converter's buffer, so it's valid until the next conversion. clone() it to keep it
+ */
+VideoFrame convertFrame(const VideoFrame& frame, int fffmt, const QSize& size, ImageConverter *&conv);
+
+} //namespace QtAV
+#endif // QTAV_FRAMEUTILS_H
@@ -0,0 +1,94 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_GOPCACHE_H
+#define QTAV_GOPCACHE_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtAV/VideoFrame.h>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+/*
+ * Decoded frames of whole GOPs, used for reverse playback and backward stepping.
+ * A GOP is decoded forward from its key frame in this thread with its own demuxer and decoder,
+ * then the frames can be read in any order. When a GOP is used, the GOP before it is prefetched.
+ * GOPs far from the current position are dropped if the frames take more memory than the limit.
+ * The limit wins over keeping whole GOPs: if a GOP alone is larger, only the frames nearest to the
+ * requested position are kept, and a position out of them is decoded again from the key frame.
+ * Frame pts is the packet pts, the same as VideoThread.
+ */
+namespace QtAV {
+
+class Q_AV_EXPORT GOPCache : public QThread
+{
+public:
+    GOPCache(QObject *parent = 0);
+    ~GOPCache();
+    // stop the thread and clear the cache. call start() to decode
+    void setFile(const QString& file);
+    QString file() const;
+    // bytes of all cached frames, including the GOP being decoded. default is 256MB
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit() const;
+    qint64 memoryUsage() const;
+    /*!
+     * the last frame before pts(s). if the GOP containing it is not cached, it will be decoded and
+     * false is returned. try again later
+     */
+    bool frameBefore(qreal pts, VideoFrame *frame, qreal *framePts);
+    // the first frame after pts(s)
+    bool frameAfter(qreal pts, VideoFrame *frame, qreal *framePts);
+    void clear();
+    // stop and wait
+    void cancel();
+
+protected:
+    virtual void run();
+
+private:
+    struct GOP {
+        GOP() : start(0), end(0), bytes(0) {}
+        qreal start, end; //[start, end)
+        QVector<qreal> pts;
+        QVector<VideoFrame> frames;
+        qint64 bytes;
+    };
+    // index of the cached GOP containing pts. -1 if not cached
+    int findGOP(qreal pts) const;
+    void request(qreal pts, bool urgent);
+    // reserved: bytes of the GOP being decoded, which is not in the cache yet
+    void evict(qint64 reserved = 0);
+
+    volatile bool cancelled;
+    QString media_file;
+    qint64 mem_limit, mem_used;
+    qreal current; //last accessed position
+    mutable QMutex mutex;
+    QWaitCondition cond;
+    QList<GOP> gops; //sorted by start
+    QList<qreal> requests; //the first is the most urgent
+};
+
+} //namespace QtAV
+#endif // QTAV_GOPCACHE_H
@@ -0,0 +1,64 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_JPEGENCODER_H
+#define QTAV_JPEGENCODER_H
+
+#include <QtCore/QByteArray>
+
+/*
+ * JPEG is encoded by libavcodec's mjpeg encoder from full range yuv, so a capture does not need the
+ * RGB conversion. Other formats, including mpeg range yuv, are converted to YUVJ* first. Standard
+ * jpeg decoders assume the full range, so mpeg range data would look washed out. The encoder and converter are kept
+ * and reused for the frames of the same size and format, so a worker should keep 1 JpegEncoder.
+ * Not thread safe.
+ */
+struct AVCodecContext;
+struct AVFrame;
+namespace QtAV {
+
+class ImageConverter;
+class VideoFrame;
+class JpegEncoder
+{
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+    // quality: [0, 100], <0: default. empty if failed
+    QByteArray encode(const VideoFrame& frame, int quality = -1);
+    // mjpeg accepts the frames of this ffmpeg pixel format without conversion
+    static bool isJpegFormat(int fffmt);
+    // the full range format fffmt is converted to
+    static int jpegFormat(int fffmt);
+    // the converter used by encode(). the caller can use it for other conversions and set it
+    ImageConverter*& converter();
+
+private:
+    bool open(int width, int height, int fffmt, int quality);
+    void close();
+
+    AVCodecContext *codec_ctx;
+    AVFrame *frame;
+    ImageConverter *conv;
+};
+
+} //namespace QtAV
+#endif // QTAV_JPEGENCODER_H
@@ -0,0 +1,99 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_KEYFRAMEINDEX_H
+#define QTAV_KEYFRAMEINDEX_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+/*
+ * Sorted table of the video key frames of a file. Seeking with the table is a binary search and
+ * a byte seek, which is much faster and more accurate than av_seek_frame() for formats without a
+ * good index, e.g. mpeg-ts, raw streams and broken mp4.
+ * KeyFrameIndexer builds the table in a thread by reading packets of the video stream without
+ * decoding. The table is saved in a cache file whose name is computed from the file path, size
+ * and modification time.
+ */
+namespace QtAV {
+
+class Q_AV_EXPORT KeyFrameIndex
+{
+public:
+    struct Entry {
+        qint64 pts; //us
+        qint64 position; //byte offset in the file
+        qint64 frame; //video frame number
+    };
+
+    KeyFrameIndex();
+    bool isEmpty() const;
+    int size() const;
+    void clear();
+    void append(const Entry& entry);
+    const Entry& at(int i) const;
+    // sort by pts. call it after all entries are appended
+    void sort();
+    // the last key frame at or before pts(us). return false if no such key frame
+    bool find(qint64 pts, Entry *entry) const;
+    // the file must be the same as the one saved. stream is the video stream index
+    bool load(const QString& path, int stream);
+    bool save(const QString& path, int stream) const;
+    // cache file of the media file in dir. empty if it's not a local file
+    static QString cacheFile(const QString& mediaFile, const QString& dir);
+    // "keyframes" in the cache location
+    static QString defaultCacheDir();
+
+private:
+    QVector<Entry> entries;
+};
+
+class Q_AV_EXPORT KeyFrameIndexer : public QThread
+{
+public:
+    KeyFrameIndexer(QObject *parent = 0);
+    ~KeyFrameIndexer();
+    // call them before start()
+    void setFile(const QString& file);
+    QString file() const;
+    // empty: do not use the cache file
+    void setCacheDir(const QString& dir);
+    QString cacheDir() const;
+    // stop and wait
+    void cancel();
+    // true if the index is complete. then index() will not change
+    bool isReady() const;
+    const KeyFrameIndex& index() const;
+
+protected:
+    virtual void run();
+
+private:
+    volatile bool cancelled;
+    bool ready;
+    mutable QMutex mutex;
+    QString media_file, cache_dir;
+    KeyFrameIndex idx;
+};
+
+} //namespace QtAV
+#endif // QTAV_KEYFRAMEINDEX_H
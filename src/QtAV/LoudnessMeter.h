@@ -0,0 +1,73 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_LOUDNESSMETER_H
+#define QTAV_LOUDNESSMETER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QVector>
+
+/*
+ * EBU R128 / ITU-R BS.1770 loudness meter.
+ * Input is float interleaved samples. The signal is K-weighted with 2 biquads, then the mean square
+ * is accumulated in 100ms sub-blocks. momentary(400ms) and short-term(3s) loudness use a sliding
+ * window of the sub-blocks. Integrated loudness uses 400ms blocks with 75% overlap, an absolute gate
+ * at -70LUFS and a relative gate 10LU below the ungated loudness. Block loudness is stored in a 0.1LU
+ * histogram so memory does not grow with the duration.
+ * True peak is measured on a 4x oversampled signal.
+ */
+namespace QtAV {
+
+class LoudnessMeterPrivate;
+class Q_AV_EXPORT LoudnessMeter
+{
+    DPTR_DECLARE_PRIVATE(LoudnessMeter)
+public:
+    // returned if there is not enough data, e.g. -HUGE_VAL in libebur128
+    static const qreal kMinLoudness;
+
+    LoudnessMeter();
+    ~LoudnessMeter();
+    // reset all values. channels <= 8
+    void setAudioFormat(int sampleRate, int channels);
+    int sampleRate() const;
+    int channels() const;
+    void reset();
+    // reset momentary, short-term and rms, but keep integrated loudness and true peak. e.g. after seeking
+    void resetWindow();
+    // samples: samples per channel
+    void process(const float *interleaved, int samples);
+
+    // LUFS
+    qreal momentaryLoudness() const;
+    qreal shortTermLoudness() const;
+    qreal integratedLoudness() const;
+    // dBTP. max since reset()
+    qreal truePeak() const;
+    // dBFS of each channel in the last 400ms
+    QVector<qreal> rms() const;
+
+private:
+    DPTR_DECLARE(LoudnessMeter)
+};
+
+} //namespace QtAV
+#endif // QTAV_LOUDNESSMETER_H
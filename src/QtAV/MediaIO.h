@@ -0,0 +1,165 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_MEDIAIO_H
+#define QTAV_MEDIAIO_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+
+/*
+ * Custom input of AVDemuxer. MediaIO creates an AVIOContext whose read and seek callbacks call
+ * the virtual functions, so media can be read from any storage without the ffmpeg protocols.
+ * The callbacks are called in the thread calling AVDemuxer::loadFile() and readFrame().
+ */
+struct AVIOContext;
+class QIODevice;
+namespace QtAV {
+
+class MediaIO
+{
+public:
+    MediaIO();
+    virtual ~MediaIO();
+    // create the AVIOContext with a buffer of bufferSize bytes
+    bool open(int bufferSize);
+    // release the AVIOContext. call it after avformat_close_input()
+    void close();
+    // 0 if not opened
+    AVIOContext* avioContext() const;
+    // a blocking read returns an error if interrupted
+    virtual void setInterrupted(bool value);
+    bool isInterrupted() const;
+    // ms. a blocking read waiting longer returns an error. <0: no timeout(default)
+    void setTimeout(qint64 value);
+    qint64 timeout() const;
+
+    virtual bool isSeekable() const = 0;
+    // <0: error, 0: end of data
+    virtual qint64 read(char *data, qint64 maxSize) = 0;
+    virtual bool seek(qint64 pos) = 0;
+    virtual qint64 position() const = 0;
+    // <0: unknown
+    virtual qint64 size() const = 0;
+
+protected:
+    // called by open() and close()
+    virtual bool onOpen() { return true; }
+    virtual void onClose() {}
+    volatile bool interrupted;
+    qint64 timeout_ms;
+
+private:
+    AVIOContext *ctx;
+};
+
+class ReadAheadBuffer;
+class QIODeviceReader;
+/*
+ * Read from an opened QIODevice. The device is not owned. A random access device is read in the
+ * demuxer's thread. A sequential device can not seek. QIODevice is not thread safe, and sockets,
+ * network replies and processes only work in the thread they belong to, so a sequential device is
+ * read in its own thread when it emits readyRead(), and that thread must run an event loop. Up to
+ * readAhead bytes are kept ready, so the demuxer does not wait for the storage or network.
+ * If the demuxer reads in the device's thread, e.g. a synchronous AVPlayer::load() of a socket
+ * created in the gui thread, the event loop is blocked, so the device is read with
+ * waitForReadyRead(). A device without it, e.g. QNetworkReply, then fails after timeout().
+ */
+class QIODeviceIO : public MediaIO
+{
+public:
+    QIODeviceIO(QIODevice *device, int readAhead);
+    ~QIODeviceIO();
+    virtual void setInterrupted(bool value);
+    virtual bool isSeekable() const;
+    virtual qint64 read(char *data, qint64 maxSize);
+    virtual bool seek(qint64 pos);
+    virtual qint64 position() const;
+    virtual qint64 size() const;
+
+protected:
+    virtual bool onOpen();
+    virtual void onClose();
+
+private:
+    QIODevice *dev;
+    int window;
+    // shared with the reader, which is deleted later in the device's thread
+    QSharedPointer<ReadAheadBuffer> ahead;
+    QIODeviceReader *reader;
+};
+
+// fills the read ahead buffer of QIODeviceIO in the thread of the sequential device
+class QIODeviceReader : public QObject
+{
+    Q_OBJECT
+public:
+    QIODeviceReader(QIODevice *device, const QSharedPointer<ReadAheadBuffer>& buffer);
+public slots:
+    // read until the buffer is full or no data is available
+    void readData();
+    // no data will arrive. the data left in the device are still read
+    void finish();
+private slots:
+    void onDeviceDestroyed();
+private:
+    QIODevice *dev;
+    QSharedPointer<ReadAheadBuffer> ahead;
+};
+
+/*
+ * Read a local file mapped into memory. A read is a copy from the page cache to the AVIOContext
+ * buffer, without a read() system call. On unix the pages from the current position to readAhead
+ * bytes later are advised to be needed, so the kernel reads them in advance. The whole file is
+ * mapped, so open() fails if the address space is not enough, e.g. a large file on 32 bit systems.
+ * The file must not be truncated while it's mapped.
+ */
+class MMapIO : public MediaIO
+{
+public:
+    MMapIO(const QString& file, int readAhead);
+    ~MMapIO();
+    virtual bool isSeekable() const;
+    virtual qint64 read(char *data, qint64 maxSize);
+    virtual bool seek(qint64 pos);
+    virtual qint64 position() const;
+    virtual qint64 size() const;
+
+protected:
+    virtual bool onOpen();
+    virtual void onClose();
+
+private:
+    // advise the window from pos. called when pos is out of the advised window
+    void adviseWillNeed(qint64 pos);
+
+    QFile f;
+    int window;
+    uchar *data;
+    qint64 data_size;
+    qint64 pos;
+    qint64 advised_begin, advised_end;
+};
+
+} //namespace QtAV
+#endif // QTAV_MEDIAIO_H
@@ -44,6 +44,10 @@ public:
     bool isCorrupt;
     QByteArray data;
     qreal pts, duration;
+    qint64 position; //byte offset in the file. -1 if unknown
+    // AVPacket.pts/dts in stream time base, used by remuxing. kNoTimestamp if unknown
+    qint64 stream_pts, stream_dts;
+    static const qint64 kNoTimestamp; //AV_NOPTS_VALUE
 private:
     static const qreal kEndPts;
 };
@@ -0,0 +1,80 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_PACKETMUXER_H
+#define QTAV_PACKETMUXER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+/*
+ * Write demuxed packets to a new container without decoding, used by StreamRecorder and
+ * SegmentExporter. The output streams copy the codec parameters of the input streams. Output
+ * timestamps are the input timestamps minus an offset, which is set by a rebase packet: it's
+ * placed at the end of the written packets, so the output timeline has no gap. Packets before the
+ * offset are dropped, and dts is forced to increase.
+ */
+struct AVFormatContext;
+struct AVBitStreamFilterContext;
+namespace QtAV {
+
+class Packet;
+class PacketMuxer
+{
+public:
+    PacketMuxer();
+    ~PacketMuxer();
+    /*!
+     * streams: indexes of the input streams in in_ctx. format: ffmpeg muxer name, empty: guess from
+     * fileName. the header is written. AVERROR code if failed
+     */
+    int open(AVFormatContext *in_ctx, const QList<int>& streams, const QString& fileName, const QString& format = QString());
+    bool isOpen() const;
+    // write the trailer and close. AVERROR code if failed
+    int finish();
+    // close without the trailer, e.g. after an error
+    void close();
+    // -1 if the input stream is not written
+    int outputStream(int input) const;
+    int streamCount() const;
+    // AVMediaType of the output stream
+    int mediaType(int stream) const;
+    // rebase: the packet is placed at endTime(). AVERROR code if failed
+    int write(const Packet& packet, int stream, bool rebase = false);
+    // us. end of the written packets
+    qint64 endTime() const;
+
+private:
+    struct Stream {
+        int input;
+        int in_tb_num, in_tb_den; //input time base
+        qint64 last_dts; //output time base
+        AVBitStreamFilterContext *bsf;
+    };
+    AVFormatContext *format_ctx;
+    QVector<Stream> mStreams;
+    qint64 offset; //us. input timestamp at output 0
+    volatile qint64 end_time;
+};
+
+} //namespace QtAV
+#endif // QTAV_PACKETMUXER_H
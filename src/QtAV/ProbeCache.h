@@ -0,0 +1,91 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_PROBECACHE_H
+#define QTAV_PROBECACHE_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
+
+/*
+ * Stream layout and codec parameters found by avformat_find_stream_info() for local files. The
+ * key is the file path, size and modification time. When the same file is opened again, the
+ * input format is not probed, the codec parameters not in the file header are set from the cache
+ * and avformat_find_stream_info() reads only a few packets. If the streams found do not match
+ * the cache, AVDemuxer removes the entry and probes again.
+ */
+struct AVFormatContext;
+namespace QtAV {
+
+class ProbeInfo
+{
+public:
+    ProbeInfo();
+    bool isValid() const;
+    // AVInputFormat short name
+    QByteArray formatName() const;
+    // read the result of avformat_find_stream_info()
+    void fill(AVFormatContext *ctx);
+    // call it after avformat_open_input() and before avformat_find_stream_info()
+    void apply(AVFormatContext *ctx) const;
+    // call it after avformat_find_stream_info()
+    bool matches(AVFormatContext *ctx) const;
+
+private:
+    struct Stream {
+        int type; //AVMediaType
+        int codec_id;
+        int width, height, pix_fmt;
+        int sample_rate, channels, sample_fmt, frame_size;
+        qint64 channel_layout;
+        int fps_num, fps_den; //r_frame_rate
+        int avg_fps_num, avg_fps_den;
+    };
+    QByteArray format;
+    QVector<Stream> streams;
+};
+
+class ProbeCache
+{
+public:
+    static ProbeCache& instance();
+    // false if not found or the file is modified
+    bool find(const QString& file, ProbeInfo *info) const;
+    void insert(const QString& file, AVFormatContext *ctx);
+    void remove(const QString& file);
+    void clear();
+    // number of files. default is 256
+    void setCapacity(int files);
+    int capacity() const;
+
+private:
+    ProbeCache();
+    // empty if not a local file
+    static QByteArray key(const QString& file);
+
+    mutable QMutex mutex;
+    QCache<QByteArray, ProbeInfo> cache;
+};
+
+} //namespace QtAV
+#endif // QTAV_PROBECACHE_H
@@ -29,18 +29,28 @@
 #include <QtAV/AVClock.h>
 #include <QtAV/AVDecoder.h>
 #include <QtAV/AVDemuxer.h>
+#include <QtAV/KeyFrameIndex.h>
 #include <QtAV/AVOutput.h>
 #include <QtAV/AVPlayer.h>
 #include <QtAV/OutputSet.h>
 #include <QtAV/Packet.h>
 #include <QtAV/Statistics.h>
+#include <QtAV/StreamRecorder.h>
+#include <QtAV/SegmentExporter.h>
+#include <QtAV/FrameExporter.h>
+#include <QtAV/FrameSink.h>
+#include <QtAV/LoudnessMeter.h>
 
 #include <QtAV/AudioDecoder.h>
+#include <QtAV/AudioFilter.h>
 #include <QtAV/AudioFormat.h>
+#include <QtAV/AudioFrame.h>
 #include <QtAV/AudioOutput.h>
+#include <QtAV/AudioOutputMixer.h>
 #include <QtAV/AudioOutputTypes.h>
 #include <QtAV/AudioResampler.h>
 #include <QtAV/AudioResamplerTypes.h>
+#include <QtAV/AudioWaveform.h>
 
 #include <QtAV/Filter.h>
 #include <QtAV/FilterContext.h>
@@ -51,6 +61,7 @@
 #include <QtAV/ImageConverterTypes.h>
 
 #include <QtAV/VideoCapture.h>
+#include <QtAV/VideoThumbnailer.h>
 #include <QtAV/VideoDecoder.h>
 #include <QtAV/VideoDecoderTypes.h>
 #include <QtAV/VideoFormat.h>
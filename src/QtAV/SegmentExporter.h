@@ -0,0 +1,77 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_SEGMENTEXPORTER_H
+#define QTAV_SEGMENTEXPORTER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+
+/*
+ * Lossless cut. A segment of a file is copied to a new container without decoding and encoding,
+ * so the speed is limited by the disk, not the codec.
+ * The input is seeked to the video key frame at or before the start, and the packets are copied
+ * until the end. Timestamps of the output start from 0. The start of the output is the key frame,
+ * so it may be earlier than the requested start, see actualStart(). The export runs in a thread.
+ * example:
+ *    SegmentExporter *e = new SegmentExporter(this);
+ *    connect(e, SIGNAL(progressChanged(qreal)), SLOT(updateProgress(qreal)));
+ *    connect(e, SIGNAL(finished(QString)), SLOT(onExported(QString)));
+ *    e->start("movie.mkv", "clip.mp4", 60000, 660000);
+ */
+namespace QtAV {
+
+class SegmentExporterPrivate;
+class Q_AV_EXPORT SegmentExporter : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(SegmentExporter)
+public:
+    explicit SegmentExporter(QObject *parent = 0);
+    // the running export is cancelled
+    ~SegmentExporter();
+    /*!
+     * export [start, end](ms) of file to outFile. streams: indexes of 1 video and 1 audio stream
+     * in the file, empty: the default video and audio streams. format: ffmpeg muxer name, empty:
+     * guess from outFile. return false if an export is running
+     */
+    bool start(const QString& file, const QString& outFile, qint64 start, qint64 end
+               , const QList<int>& streams = QList<int>(), const QString& format = QString());
+    // stop and wait. the incomplete output is removed
+    void cancel();
+    bool isRunning() const;
+    // ms. the key frame the output starts at. -1 if not known yet
+    qint64 actualStart() const;
+    // [0, 1]
+    qreal progress() const;
+
+signals:
+    void progressChanged(qreal progress);
+    void finished(const QString& outFile);
+    void failed(const QString& outFile);
+
+private:
+    friend class ExportThread;
+    DPTR_DECLARE(SegmentExporter)
+};
+
+} //namespace QtAV
+#endif // QTAV_SEGMENTEXPORTER_H
@@ -23,9 +23,11 @@
 #define QTAV_STATISTICS_H
 
 #include <QtAV/QtAV_Global.h>
+#include <QtCore/QMutex>
 #include <QtCore/QTime>
 #include <QtCore/QQueue>
 #include <QtCore/QSharedData>
+#include <QtCore/QVector>
 
 /*
  * time unit is s
@@ -97,8 +99,27 @@ public:
          */
         int block_align;
         //int cutoff; //Audio cutoff bandwidth (0 means "automatic")
+        /*
+         * EBU R128 loudness of the output signal, measured if AVPlayer::setLoudnessMeterEnabled(true).
+         * LoudnessMeter::kMinLoudness if not available
+         */
+        class Q_AV_EXPORT Loudness {
+        public:
+            Loudness();
+            qreal momentary; //LUFS, 400ms
+            qreal short_term; //LUFS, 3s
+            qreal integrated; //LUFS, gated, since the meter is enabled
+            qreal true_peak; //dBTP
+            QVector<qreal> rms; //dBFS of each channel, 400ms
+        };
+        // a copy of the values updated by the audio thread. thread safe
+        Loudness loudness() const;
+        void setLoudness(const Loudness& value);
     private:
         class Private : public QSharedData {
+        public:
+            QMutex mutex;
+            Loudness loudness;
         };
         QExplicitlySharedDataPointer<Private> d;
     } audio_only;
@@ -143,6 +164,29 @@ public:
         };
         QExplicitlySharedDataPointer<Private> d;
     } video_only;
+    /*
+     * the jitter buffer between the demuxer and the decoders, if AVPlayer::setJitterBufferEnabled(true).
+     * time unit is ms
+     */
+    class Q_AV_EXPORT JitterBuffer {
+    public:
+        JitterBuffer();
+        int depth; //pts distance of the buffered packets
+        int target; //depth buffered before playing at the beginning and after an underrun
+        int jitter; //packet arrival time jitter against pts
+        int underruns; //times the decoders starved and playback waited
+        int overflows; //times reading stopped because the buffer reached the ceiling
+    };
+    // a copy of the values updated by the demux thread. thread safe
+    JitterBuffer jitterBuffer() const;
+    void setJitterBuffer(const JitterBuffer& value);
+private:
+    class Private : public QSharedData {
+    public:
+        QMutex mutex;
+        JitterBuffer jitter_buffer;
+    };
+    QExplicitlySharedDataPointer<Private> d;
 };
 
 } //namespace QtAV
@@ -0,0 +1,88 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_STREAMRECORDER_H
+#define QTAV_STREAMRECORDER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QObject>
+
+/*
+ * Record the playing stream to a file without decoding and encoding, e.g. a camera feed.
+ * AVDemuxThread passes every packet it dispatches to the recorder, and the packets are remuxed by
+ * libavformat to the output format(mp4, matroska, mpegts...). No additional connection to the
+ * source is opened. Recording starts at a video key frame(audio packet if no video), and the
+ * timestamps start from 0. After a seek it continues at the next key frame without a gap.
+ * Packets are written in a thread. The queue is bounded, so a slow disk never blocks playback: if
+ * the queue is full, packets are dropped until the next key frame.
+ * example:
+ *    player->startRecording("camera.mkv");
+ *    ...
+ *    player->stopRecording();
+ */
+namespace QtAV {
+
+class AVDemuxer;
+class AVError;
+class Packet;
+class StreamRecorderPrivate;
+class Q_AV_EXPORT StreamRecorder : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(StreamRecorder)
+public:
+    explicit StreamRecorder(QObject *parent = 0);
+    ~StreamRecorder();
+    /*!
+     * record the audio and video streams of demuxer which are read, i.e. not discarded.
+     * format: ffmpeg muxer name, e.g. "mp4", "matroska", "mpegts". empty: guess from fileName.
+     * the previous recording is stopped
+     */
+    bool start(AVDemuxer *demuxer, const QString& fileName, const QString& format = QString());
+    // the queued packets are written in the thread, then stopped() is emitted
+    void stop();
+    bool isRecording() const;
+    QString fileName() const;
+    // bytes of the packets waiting to write. default is 16MB
+    void setQueueLimit(qint64 bytes);
+    qint64 queueLimit() const;
+    // ms of the written media
+    qint64 duration() const;
+    // packets dropped because the queue is full
+    int droppedPackets() const;
+
+    // called by AVDemuxThread
+    void writePacket(const Packet& packet, int stream);
+    // the next packet is not continuous, e.g. after a seek
+    void discontinue();
+
+signals:
+    void started();
+    void stopped();
+    void error(const QtAV::AVError& e);
+
+private:
+    friend class RecordThread;
+    DPTR_DECLARE(StreamRecorder)
+};
+
+} //namespace QtAV
+#endif // QTAV_STREAMRECORDER_H
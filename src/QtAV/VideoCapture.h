@@ -23,15 +23,27 @@
 #ifndef VIDEOCAPTURE_H
 #define VIDEOCAPTURE_H
 
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
 #include <QtGui/QImage>
 #include <QtAV/QtAV_Global.h>
+#include <QtAV/BoundedQueue.h>
+#include <QtAV/VideoFrame.h>
 
+/*
+ * The decoded frame is captured in its native format before it's converted for the renderers, and
+ * saved in a dedicated thread pool. JPEG is encoded by libavcodec's mjpeg encoder from full
+ * range yuv without the RGB conversion, other formats are converted to RGB32 and saved by QImage. The pending captures are bounded,
+ * see setMaxPending() and setDropPolicy(), so a slow disk does not accumulate frames.
+ */
 class QSize;
 namespace QtAV {
 
-//on capture per thread or all in one thread?
+class CaptureTask;
+class ImageConverter;
 class Q_AV_EXPORT VideoCapture : public QObject
 {
     Q_OBJECT
@@ -47,6 +59,11 @@ public:
     void setAutoSave(bool a);
     bool autoSave() const;
     void request();
+    /*!
+     * burst mode. capture the next frames frames, 1 of every interval frames. the capture names
+     * are suffixed by the index if captureName() is set
+     */
+    void requestBurst(int frames, int interval = 1);
     void cancel();
     bool isRequested() const;
     void start();
@@ -61,7 +78,18 @@ public:
     QString captureName() const;
     void setCaptureDir(const QString& dir);
     QString captureDir() const;
-    //used to get current playing statistics.
+    // saving threads. default is 2
+    void setThreadCount(int count);
+    int threadCount() const;
+    // captures waiting to be saved. default is 8
+    void setMaxPending(int count);
+    int maxPending() const;
+    // what to do with a new capture if maxPending() captures are not saved. default is DropNewest
+    void setDropPolicy(DropPolicy policy);
+    DropPolicy dropPolicy() const;
+    // captures dropped because of maxPending()
+    int droppedCount() const;
+    //used to get current playing statistics. RGB32 of the last captured frame
     void getRawImage(QByteArray* raw, int *w, int *h, QImage::Format *fmt = 0);
 signals:
     /*use it to popup a dialog for selecting dir, name etc. TODO: block avthread if not async*/
@@ -70,27 +98,37 @@ signals:
     void finished();
 private:
     void setPosition(qreal pts);
-    //get/set: ensure thread safe because they are not in the same thread
-    void setRawImage(const QByteArray& raw, const QSize& size, QImage::Format format = QImage::Format_RGB32);
-    void setRawImage(const QByteArray& raw, int w, int h, QImage::Format format = QImage::Format_RGB32);
+    /*!
+     * called by VideoThread for every decoded frame if isRequested(). baseName is used for the auto
+     * name. the frame is copied once because the decoder reuses the buffer
+     */
+    void capture(const VideoFrame& frame, const QString& baseName);
+    // push a task to the pending queue with the drop policy. start a worker if needed
+    void enqueue(CaptureTask *task);
+    // RGB32 image. conv is created if null
+    static QImage toImage(const VideoFrame& frame, ImageConverter *&conv);
 
     friend class CaptureTask;
+    friend class CaptureWorker;
     friend class VideoThread;
     bool async;
     bool is_requested;
     bool auto_save;
     ErrorCode error;
-    //TODO: use blocking queue? If not, the parameters will change when thre previous is not finished
-    //or use a capture event that wrapper all these parameters
-    int width, height;
     int qual;
-    QImage::Format qfmt;
     QString fmt;
     QString name, dir;
-    QByteArray data;
-    //QImage image;
+    // burst
+    int burst_frames, burst_interval, burst_index, frame_count;
+    VideoFrame last_frame;
     mutable QReadWriteLock lock;
     qreal pts;
+    // protected by mutex
+    QMutex mutex;
+    QWaitCondition cond;
+    BoundedQueue<CaptureTask*> pending;
+    int workers;
+    QThreadPool pool;
 };
 
 } //namespace QtAV
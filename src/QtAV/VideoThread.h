@@ -28,6 +28,8 @@
 
 namespace QtAV {
 
+class FrameExporter;
+class FrameSink;
 class ImageConverter;
 class OSDFilter;
 class VideoCapture;
@@ -39,6 +41,12 @@ class VideoThread : public AVThread
 public:
     explicit VideoThread(QObject *parent = 0);
     VideoCapture *setVideoCapture(VideoCapture* cap); //ensure thread safe
+    FrameExporter *setFrameExporter(FrameExporter* exporter);
+    void setStreamIndex(int stream);
+    // frames are put in the sinks in the decoded format. return false if already installed
+    bool installFrameSink(FrameSink* sink);
+    // call it in this thread (scheduleTask()) if running, then the sink is not used after it
+    bool uninstallFrameSink(FrameSink* sink);
     //ImageConverter *imageConverter();
     //virtual bool event(QEvent *event);
 
@@ -0,0 +1,87 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#ifndef QTAV_VIDEOTHUMBNAILER_H
+#define QTAV_VIDEOTHUMBNAILER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+#include <QtGui/QImage>
+
+/*
+ * Thumbnails for timeline previews and playlists, independent of AVPlayer.
+ * A pool of demuxer + decoder pairs is kept for the recently used files. A request seeks to the
+ * key frame before the position, decodes only that frame with skip_frame = AVDISCARD_NONKEY and
+ * lowres when the video is much larger than the thumbnail, then scales it to the thumbnail size.
+ * Requests run on worker threads, the newest first. Results are kept in a LRU cache keyed by
+ * (file, time bucket, size), so requests in the same bucket share 1 thumbnail.
+ * example:
+ *    VideoThumbnailer *t = new VideoThumbnailer(this);
+ *    connect(t, SIGNAL(ready(QString,qint64,QImage)), SLOT(showPreview(QString,qint64,QImage)));
+ *    t->request(file, mouse_pos_ms, QSize(160, 90));
+ */
+namespace QtAV {
+
+class VideoThumbnailerPrivate;
+class Q_AV_EXPORT VideoThumbnailer : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(VideoThumbnailer)
+public:
+    explicit VideoThumbnailer(QObject *parent = 0);
+    ~VideoThumbnailer();
+    // ms. default is 1000
+    void setTimeBucket(int ms);
+    int timeBucket() const;
+    // worker threads. default is QThread::idealThreadCount()
+    void setThreadCount(int count);
+    int threadCount() const;
+    // max opened demuxer + decoder pairs of all files. default is 8
+    void setDecoderCount(int count);
+    int decoderCount() const;
+    // KB. default is 32MB
+    void setCacheLimit(int kb);
+    int cacheLimit() const;
+    // older pending requests are dropped if more, and failed() is emitted for them. default is 32
+    void setMaxPendingRequests(int count);
+    int maxPendingRequests() const;
+    /*!
+     * request a thumbnail at pos(ms) which fits in size. ready() or failed() will be emitted with the
+     * same file and pos, even if it's in the cache.
+     */
+    void request(const QString& file, qint64 pos, const QSize& size);
+    // the cached thumbnail, or a null image. nothing is decoded
+    QImage cached(const QString& file, qint64 pos, const QSize& size) const;
+    // drop pending requests. failed() is emitted for them
+    void cancel();
+    void clearCache();
+
+signals:
+    void ready(const QString& file, qint64 pos, const QImage& image);
+    void failed(const QString& file, qint64 pos);
+
+private:
+    friend class ThumbnailWorker;
+    DPTR_DECLARE(VideoThumbnailer)
+};
+
+} //namespace QtAV
+#endif // QTAV_VIDEOTHUMBNAILER_H
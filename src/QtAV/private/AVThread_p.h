@@ -56,6 +56,10 @@ public:
       , filter_context(0)
       , statistics(0)
       , ready(false)
+      , seek_target(-1)
+      , pending_seek_target(-1)
+      , pause_after_seek(false)
+      , pending_pause_after_seek(false)
     {
     }
     virtual ~AVThreadPrivate();
@@ -77,6 +81,11 @@ public:
     QWaitCondition ready_cond;
     QMutex ready_mutex;
     bool ready;
+    // accurate seek. frames before seek_target are decoded but not presented. < 0: not seeking
+    qreal seek_target;
+    // set by setSeekTarget(), used when the flush packet is taken. protected by mutex
+    qreal pending_seek_target;
+    bool pause_after_seek, pending_pause_after_seek;
 };
 
 } //namespace QtAV
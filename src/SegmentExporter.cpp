@@ -0,0 +1,282 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/SegmentExporter.h>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/Packet.h>
+#include <QtAV/PacketMuxer.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QFile>
+#include <QtCore/QThread>
+
+namespace QtAV {
+
+static const int kMaxReadErrors = 8;
+// seek earlier if the demuxer seeks after the start
+static const int kMaxSeekRetries = 4;
+static const qreal kSeekRetryStep = 2.0; //s
+static const qreal kProgressStep = 0.01;
+
+class ExportThread : public QThread
+{
+public:
+    ExportThread(SegmentExporter *exporter) : QThread(exporter), mpExporter(exporter) {}
+protected:
+    virtual void run();
+private:
+    SegmentExporter *mpExporter;
+};
+
+class SegmentExporterPrivate : public DPtrPrivate<SegmentExporter>
+{
+public:
+    SegmentExporterPrivate()
+        : start(0)
+        , end(0)
+        , cancelled(false)
+        , output_created(false)
+        , actual_start(-1)
+        , progress(0)
+        , thread(0)
+        , exporter(0)
+    {}
+    bool exportSegment();
+    // seek and find the key frame at or before start. false if not found
+    bool seekToKeyFrame(AVDemuxer *demuxer, int keyStream);
+
+    QString file, out_file, format;
+    qint64 start, end;
+    QList<int> streams;
+    volatile bool cancelled;
+    bool output_created;
+    volatile qint64 actual_start;
+    volatile qreal progress;
+    ExportThread *thread;
+    SegmentExporter *exporter;
+};
+
+bool SegmentExporterPrivate::seekToKeyFrame(AVDemuxer *demuxer, int keyStream)
+{
+    AVFormatContext *fmt_ctx = demuxer->formatContext();
+    const qreal target = qreal(start)/1000.0;
+    for (int retry = 0; retry < kMaxSeekRetries && !cancelled; ++retry) {
+        // AVDemuxer::seek() may seek forward. we need the key frame before start
+        const qint64 upos = qMax<qint64>(0, (target - qreal(retry)*kSeekRetryStep)*qreal(AV_TIME_BASE));
+        int ret = av_seek_frame(fmt_ctx, -1, upos, AVSEEK_FLAG_BACKWARD);
+        if (ret < 0) {
+            qWarning("SegmentExporter: seek error: %s", av_err2str(ret));
+            return false;
+        }
+        int errors = 0;
+        while (!cancelled) {
+            if (!demuxer->readFrame()) {
+                if (demuxer->atEnd() || ++errors > kMaxReadErrors)
+                    return false;
+                continue;
+            }
+            errors = 0;
+            const Packet *pkt = demuxer->packet();
+            if (pkt->isEnd())
+                return false;
+            if (demuxer->stream() != keyStream || !pkt->hasKeyFrame)
+                continue;
+            if (pkt->pts <= target || upos == 0) {
+                actual_start = qint64(pkt->pts*1000.0);
+                return true;
+            }
+            break;
+        }
+    }
+    return false;
+}
+
+bool SegmentExporterPrivate::exportSegment()
+{
+    AVDemuxer demuxer;
+    if (!demuxer.loadFile(file))
+        return false;
+    if (!streams.isEmpty()) {
+        demuxer.setAutoResetStream(false);
+        foreach (int s, streams) {
+            if (demuxer.videoStreams().contains(s))
+                demuxer.setStreamIndex(AVDemuxer::VideoStream, demuxer.videoStreams().indexOf(s));
+            else if (demuxer.audioStreams().contains(s))
+                demuxer.setStreamIndex(AVDemuxer::AudioStream, demuxer.audioStreams().indexOf(s));
+            else
+                qWarning("SegmentExporter: stream %d is not an audio or video stream", s);
+        }
+        demuxer.prepareStreams();
+    }
+    // video first. its key frame is the start
+    QList<int> selected;
+    const int inputs[] = { demuxer.videoStream(), demuxer.audioStream() };
+    for (unsigned int i = 0; i < sizeof(inputs)/sizeof(inputs[0]); ++i) {
+        if (inputs[i] >= 0 && (streams.isEmpty() || streams.contains(inputs[i])))
+            selected.append(inputs[i]);
+    }
+    if (selected.isEmpty()) {
+        qWarning("SegmentExporter: no stream to export in %s", qPrintable(file));
+        return false;
+    }
+    demuxer.discardStreamsExcept(selected);
+    if (!seekToKeyFrame(&demuxer, selected.first())) {
+        if (!cancelled)
+            qWarning("SegmentExporter: no key frame before %lld ms", start);
+        return false;
+    }
+    // the first key frame is after the range
+    if (actual_start > end) {
+        qWarning("SegmentExporter: no key frame in [%lld, %lld] ms. the first one is at %lld ms", start, end, actual_start);
+        return false;
+    }
+    PacketMuxer muxer;
+    if (muxer.open(demuxer.formatContext(), selected, out_file, format) < 0)
+        return false;
+    output_created = true;
+    qDebug("SegmentExporter: export %s [%lld, %lld] ms to %s", qPrintable(file), actual_start, end, qPrintable(out_file));
+    const qreal end_pts = qreal(end)/1000.0;
+    const qreal range = qMax<qreal>(end_pts - qreal(actual_start)/1000.0, 0.001);
+    QList<int> ended; //streams reached the end
+    bool first = true;
+    bool rebase = true; //the first written packet
+    int errors = 0;
+    // the key frame found by seekToKeyFrame() is the current packet
+    while (!cancelled && ended.size() < selected.size()) {
+        if (!first && !demuxer.readFrame()) {
+            if (demuxer.atEnd() || ++errors > kMaxReadErrors)
+                break;
+            continue;
+        }
+        errors = 0;
+        // the current packet is processed once
+        first = false;
+        const Packet *pkt = demuxer.packet();
+        if (pkt->isEnd())
+            break;
+        const int stream = demuxer.stream();
+        const int out = muxer.outputStream(stream);
+        if (out < 0 || ended.contains(stream))
+            continue;
+        if (pkt->pts > end_pts) {
+            ended.append(stream);
+            continue;
+        }
+        int ret = muxer.write(*pkt, out, rebase);
+        rebase = false;
+        if (ret < 0) {
+            qWarning("SegmentExporter: write packet error: %s", av_err2str(ret));
+            muxer.close();
+            return false;
+        }
+        const qreal p = qBound<qreal>(0, (pkt->pts*1000.0 - actual_start)/1000.0/range, 1);
+        if (p - progress >= kProgressStep) {
+            progress = p;
+            QMetaObject::invokeMethod(exporter, "progressChanged", Qt::QueuedConnection, Q_ARG(qreal, p));
+        }
+    }
+    if (cancelled) {
+        muxer.close();
+        return false;
+    }
+    if (muxer.finish() < 0)
+        return false;
+    progress = 1;
+    QMetaObject::invokeMethod(exporter, "progressChanged", Qt::QueuedConnection, Q_ARG(qreal, 1.0));
+    qDebug("SegmentExporter: %lld ms exported to %s", muxer.endTime()/1000LL, qPrintable(out_file));
+    return true;
+}
+
+void ExportThread::run()
+{
+    SegmentExporterPrivate &d = mpExporter->d_func();
+    if (d.exportSegment()) {
+        QMetaObject::invokeMethod(mpExporter, "finished", Qt::QueuedConnection, Q_ARG(QString, d.out_file));
+        return;
+    }
+    // incomplete output
+    if (d.output_created)
+        QFile::remove(d.out_file);
+    if (!d.cancelled)
+        QMetaObject::invokeMethod(mpExporter, "failed", Qt::QueuedConnection, Q_ARG(QString, d.out_file));
+}
+
+SegmentExporter::SegmentExporter(QObject *parent)
+    : QObject(parent)
+{
+    DPTR_D(SegmentExporter);
+    d.exporter = this;
+    d.thread = new ExportThread(this);
+}
+
+SegmentExporter::~SegmentExporter()
+{
+    cancel();
+}
+
+bool SegmentExporter::start(const QString &file, const QString &outFile, qint64 start, qint64 end
+                            , const QList<int> &streams, const QString &format)
+{
+    DPTR_D(SegmentExporter);
+    if (d.thread->isRunning()) {
+        qWarning("SegmentExporter: export is running");
+        return false;
+    }
+    if (end <= start || start < 0) {
+        qWarning("SegmentExporter: invalid range [%lld, %lld]", start, end);
+        return false;
+    }
+    d.file = file;
+    d.out_file = outFile;
+    d.start = start;
+    d.end = end;
+    d.streams = streams;
+    d.format = format;
+    d.cancelled = false;
+    d.output_created = false;
+    d.actual_start = -1;
+    d.progress = 0;
+    d.thread->start();
+    return true;
+}
+
+void SegmentExporter::cancel()
+{
+    DPTR_D(SegmentExporter);
+    d.cancelled = true;
+    d.thread->wait();
+}
+
+bool SegmentExporter::isRunning() const
+{
+    return d_func().thread->isRunning();
+}
+
+qint64 SegmentExporter::actualStart() const
+{
+    return d_func().actual_start;
+}
+
+qreal SegmentExporter::progress() const
+{
+    return d_func().progress;
+}
+
+} //namespace QtAV
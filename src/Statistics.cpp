@@ -20,6 +20,7 @@
 ******************************************************************************/
 
 #include "QtAV/Statistics.h"
+#include "QtAV/LoudnessMeter.h"
 
 namespace QtAV {
 
@@ -42,6 +43,28 @@ Statistics::AudioOnly::AudioOnly():
 {
 }
 
+Statistics::AudioOnly::Loudness::Loudness():
+    momentary(LoudnessMeter::kMinLoudness)
+  , short_term(LoudnessMeter::kMinLoudness)
+  , integrated(LoudnessMeter::kMinLoudness)
+  , true_peak(LoudnessMeter::kMinLoudness)
+{
+}
+
+Statistics::AudioOnly::Loudness Statistics::AudioOnly::loudness() const
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    return d->loudness;
+}
+
+void Statistics::AudioOnly::setLoudness(const Loudness &value)
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    d->loudness = value;
+}
+
 Statistics::VideoOnly::VideoOnly():
     fps_guess(0)
   , fps(0)
@@ -77,7 +100,17 @@ qreal Statistics::VideoOnly::currentDisplayFPS() const
     return (qreal)d->ptsHistory.size()/(d->ptsHistory.last() - d->ptsHistory.first());
 }
 
-Statistics::Statistics()
+Statistics::JitterBuffer::JitterBuffer():
+    depth(0)
+  , target(0)
+  , jitter(0)
+  , underruns(0)
+  , overflows(0)
+{
+}
+
+Statistics::Statistics():
+    d(new Private())
 {
 }
 
@@ -92,6 +125,21 @@ void Statistics::reset()
     video = Common();
     audio_only = AudioOnly();
     video_only = VideoOnly();
+    setJitterBuffer(JitterBuffer());
+}
+
+Statistics::JitterBuffer Statistics::jitterBuffer() const
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    return d->jitter_buffer;
+}
+
+void Statistics::setJitterBuffer(const JitterBuffer &value)
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    d->jitter_buffer = value;
 }
 
 } //namespace QtAV
@@ -0,0 +1,270 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <QtAV/StreamRecorder.h>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/AVError.h>
+#include <QtAV/Packet.h>
+#include <QtAV/PacketMuxer.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+
+struct RecordPacket {
+    RecordPacket() : stream(-1), rebase(false), end(false) {}
+    Packet packet;
+    int stream; //output stream
+    bool rebase; //the first packet after a discontinuity
+    bool end;
+};
+
+class RecordThread : public QThread
+{
+public:
+    RecordThread(StreamRecorder *recorder) : QThread(recorder), mpRecorder(recorder) {}
+protected:
+    virtual void run();
+private:
+    StreamRecorder *mpRecorder;
+};
+
+class StreamRecorderPrivate : public DPtrPrivate<StreamRecorder>
+{
+public:
+    StreamRecorderPrivate()
+        : recording(false)
+        , wait_key(false)
+        , rebase(false)
+        , key_stream(-1)
+        , key_video(false)
+        , queue_bytes(0)
+        , queue_limit(16*1024*1024)
+        , dropped(0)
+        , thread(0)
+    {}
+
+    QString file;
+    // protected by mutex
+    QMutex mutex;
+    QWaitCondition cond;
+    bool recording;
+    bool wait_key, rebase;
+    int key_stream; //input stream to start at
+    bool key_video;
+    QQueue<RecordPacket> queue;
+    qint64 queue_bytes, queue_limit;
+    int dropped;
+    // written in record thread
+    PacketMuxer muxer;
+    RecordThread *thread;
+};
+
+void RecordThread::run()
+{
+    StreamRecorderPrivate &d = mpRecorder->d_func();
+    qDebug("stream recorder thread start running...");
+    int ret = 0;
+    while (true) {
+        RecordPacket rp;
+        {
+            QMutexLocker lock(&d.mutex);
+            Q_UNUSED(lock);
+            while (d.queue.isEmpty())
+                d.cond.wait(&d.mutex);
+            rp = d.queue.dequeue();
+            d.queue_bytes -= rp.packet.data.size();
+        }
+        if (rp.end)
+            break;
+        if (ret < 0)
+            continue; //drain the queue after an error
+        ret = d.muxer.write(rp.packet, rp.stream, rp.rebase);
+        if (ret < 0) {
+            qWarning("StreamRecorder: write packet error: %s", av_err2str(ret));
+            {
+                QMutexLocker lock(&d.mutex);
+                Q_UNUSED(lock);
+                d.recording = false;
+            }
+            QMetaObject::invokeMethod(mpRecorder, "error", Qt::QueuedConnection
+                                      , Q_ARG(QtAV::AVError, AVError(AVError::WriteError, ret)));
+        }
+    }
+    if (ret >= 0)
+        d.muxer.finish();
+    else
+        d.muxer.close();
+    qDebug("stream recorder thread stops running. %s", qPrintable(d.file));
+    QMetaObject::invokeMethod(mpRecorder, "stopped", Qt::QueuedConnection);
+}
+
+StreamRecorder::StreamRecorder(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<QtAV::AVError>("QtAV::AVError");
+    d_func().thread = new RecordThread(this);
+}
+
+StreamRecorder::~StreamRecorder()
+{
+    stop();
+    d_func().thread->wait();
+}
+
+bool StreamRecorder::start(AVDemuxer *demuxer, const QString &fileName, const QString &format)
+{
+    DPTR_D(StreamRecorder);
+    stop();
+    d.thread->wait();
+    AVFormatContext *in_ctx = demuxer ? demuxer->formatContext() : 0;
+    if (!in_ctx) {
+        qWarning("StreamRecorder: no input");
+        return false;
+    }
+    d.file = fileName;
+    // video first. the streams not read by AVDemuxThread are discarded
+    QList<int> streams;
+    const int inputs[] = { demuxer->videoStream(), demuxer->audioStream() };
+    for (unsigned int i = 0; i < sizeof(inputs)/sizeof(inputs[0]); ++i) {
+        if (inputs[i] >= 0 && inputs[i] < (int)in_ctx->nb_streams
+                && in_ctx->streams[inputs[i]]->discard != AVDISCARD_ALL)
+            streams.append(inputs[i]);
+    }
+    int ret = d.muxer.open(in_ctx, streams, fileName, format);
+    if (ret < 0) {
+        emit error(AVError(AVError::WriteError, ret));
+        return false;
+    }
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        d.key_stream = streams.first();
+        d.key_video = d.muxer.mediaType(0) == AVMEDIA_TYPE_VIDEO;
+        d.wait_key = true;
+        d.rebase = true;
+        d.dropped = 0;
+        d.recording = true;
+    }
+    d.thread->start();
+    emit started();
+    return true;
+}
+
+void StreamRecorder::stop()
+{
+    DPTR_D(StreamRecorder);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (!d.thread->isRunning())
+        return;
+    d.recording = false;
+    // after an error, the thread is still waiting for the end
+    if (!d.queue.isEmpty() && d.queue.last().end)
+        return;
+    RecordPacket rp;
+    rp.end = true;
+    d.queue.enqueue(rp);
+    d.cond.wakeAll();
+}
+
+bool StreamRecorder::isRecording() const
+{
+    return d_func().recording;
+}
+
+QString StreamRecorder::fileName() const
+{
+    return d_func().file;
+}
+
+void StreamRecorder::setQueueLimit(qint64 bytes)
+{
+    DPTR_D(StreamRecorder);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.queue_limit = bytes;
+}
+
+qint64 StreamRecorder::queueLimit() const
+{
+    return d_func().queue_limit;
+}
+
+qint64 StreamRecorder::duration() const
+{
+    return d_func().muxer.endTime()/1000LL;
+}
+
+int StreamRecorder::droppedPackets() const
+{
+    return d_func().dropped;
+}
+
+void StreamRecorder::writePacket(const Packet &packet, int stream)
+{
+    DPTR_D(StreamRecorder);
+    if (!d.recording || packet.isEnd())
+        return;
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (!d.recording)
+        return;
+    const int out = d.muxer.outputStream(stream);
+    if (out < 0)
+        return;
+    if (d.wait_key) {
+        if (stream != d.key_stream || (d.key_video && !packet.hasKeyFrame))
+            return;
+        d.wait_key = false;
+    }
+    if (d.queue_bytes + packet.data.size() > d.queue_limit && !d.queue.isEmpty()) {
+        // the following packets depend on the dropped one
+        ++d.dropped;
+        d.wait_key = true;
+        qWarning("StreamRecorder: queue is full. drop packets until the next key frame");
+        return;
+    }
+    RecordPacket rp;
+    rp.packet = packet;
+    rp.stream = out;
+    rp.rebase = d.rebase;
+    d.rebase = false;
+    d.queue_bytes += packet.data.size();
+    d.queue.enqueue(rp);
+    d.cond.wakeAll();
+}
+
+void StreamRecorder::discontinue()
+{
+    DPTR_D(StreamRecorder);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (!d.recording)
+        return;
+    d.wait_key = true;
+    d.rebase = true;
+}
+
+} //namespace QtAV
@@ -21,11 +21,16 @@
 
 
 #include <QtAV/VideoCapture.h>
+#include <QtAV/FrameUtils.h>
+#include <QtAV/ImageConverter.h>
+#include <QtAV/JpegEncoder.h>
+#include <QtAV/ImageConverterTypes.h>
+#include <QtAV/QtAV_Compat.h>
 #include <QtCore/QThread>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
+#include <QtCore/QFile>
 #include <QtCore/QRunnable>
-#include <QtCore/QThreadPool>
 #include <QtGui/QImage>
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
@@ -35,15 +40,14 @@
 #endif
 namespace QtAV {
 
-class CaptureTask : public QRunnable
+class CaptureTask
 {
 public:
     CaptureTask(VideoCapture* c):cap(c){
         format = "PNG";
-        qfmt = QImage::Format_RGB32;
-        setAutoDelete(true);
     }
-    virtual void run() {
+    // encoder: reused by the worker
+    void run(JpegEncoder *encoder) {
         bool main_thread = QThread::currentThread() == qApp->thread();
         qDebug("capture task running in thread %p [main thread=%d]", QThread::currentThreadId(), main_thread);
         if (!QDir(dir).exists()) {
@@ -54,10 +58,18 @@ public:
                 return;
             }
         }
-        QImage image((const uchar*)data.constData(), width, height, qfmt);
         QString path(dir + "/" + name + "." + format.toLower());
         qDebug("Saving capture to %s", qPrintable(path));
-        bool ok = image.save(path, format.toLatin1().constData(), quality);
+        bool ok = false;
+        const QString f(format.toLower());
+        if (f == "jpg" || f == "jpeg") {
+            const QByteArray jpeg(encoder->encode(frame, quality));
+            QFile file(path);
+            ok = !jpeg.isEmpty() && file.open(QIODevice::WriteOnly) && file.write(jpeg) == jpeg.size();
+        } else {
+            const QImage image(VideoCapture::toImage(frame, encoder->converter()));
+            ok = !image.isNull() && image.save(path, format.toLatin1().constData(), quality);
+        }
         if (!ok) {
             cap->error = VideoCapture::SaveError;
             qWarning("Failed to save capture");
@@ -67,10 +79,39 @@ public:
     }
 
     VideoCapture *cap;
-    int width, height, quality;
+    int quality;
     QString format, dir, name;
-    QImage::Format qfmt;
-    QByteArray data;
+    VideoFrame frame;
+};
+
+// runs the pending tasks in the pool
+class CaptureWorker : public QRunnable
+{
+public:
+    CaptureWorker(VideoCapture *c) : cap(c) {
+        setAutoDelete(true);
+    }
+    virtual void run() {
+        JpegEncoder encoder;
+        forever {
+            CaptureTask *task = 0;
+            {
+                QMutexLocker lock(&cap->mutex);
+                Q_UNUSED(lock);
+                if (cap->pending.isEmpty()) {
+                    cap->workers--;
+                    cap->cond.wakeAll();
+                    return;
+                }
+                task = cap->pending.dequeue();
+                cap->cond.wakeAll();
+            }
+            task->run(&encoder);
+            delete task;
+        }
+    }
+private:
+    VideoCapture *cap;
 };
 
 VideoCapture::VideoCapture(QObject *parent) :
@@ -79,8 +120,13 @@ VideoCapture::VideoCapture(QObject *parent) :
   , is_requested(false)
   , auto_save(true)
   , error(NoError)
-  , qfmt(QImage::Format_RGB32)
+  , burst_frames(0)
+  , burst_interval(1)
+  , burst_index(0)
+  , frame_count(0)
   , pts(0)
+  , pending(8, DropNewest)
+  , workers(0)
 {
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
     dir = QDesktopServices::storageLocation(QDesktopServices::PicturesLocation);
@@ -91,11 +137,20 @@ VideoCapture::VideoCapture(QObject *parent) :
         dir = qApp->applicationDirPath() + "/capture";
     fmt = "PNG";
     qual = -1;
+    pool.setMaxThreadCount(2);
 }
 
 VideoCapture::~VideoCapture()
 {
     qDebug("%p %s %s", QThread::currentThreadId(), __FILE__, __FUNCTION__);
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        qDeleteAll(pending);
+        pending.clear();
+        cond.wakeAll();
+    }
+    pool.waitForDone();
 }
 
 void VideoCapture::setAsync(bool async)
@@ -120,12 +175,26 @@ bool VideoCapture::autoSave() const
 
 void VideoCapture::request()
 {
+    requestBurst(1);
+}
+
+void VideoCapture::requestBurst(int frames, int interval)
+{
+    QWriteLocker locker(&lock);
+    Q_UNUSED(locker);
+    burst_frames = qMax(frames, 1);
+    burst_interval = qMax(interval, 1);
+    burst_index = 0;
+    frame_count = 0;
     is_requested = true;
 }
 
 void VideoCapture::cancel()
 {
+    QWriteLocker locker(&lock);
+    Q_UNUSED(locker);
     is_requested = false;
+    burst_frames = 0;
 }
 
 bool VideoCapture::isRequested() const
@@ -137,7 +206,6 @@ void VideoCapture::start()
 {
     //QReadLocker locker(&lock);
     //Q_UNUSED(locker);
-    is_requested = false;
     error = NoError;
     emit ready();
     if (!auto_save) {
@@ -145,18 +213,66 @@ void VideoCapture::start()
         return;
     }
     CaptureTask *task = new CaptureTask(this);
-    task->width = width;
-    task->height = height;
     task->quality = qual;
     task->dir = dir;
     task->name = name;
     task->format = fmt;
-    task->qfmt = qfmt;
-    task->data = data;
+    {
+        QReadLocker locker(&lock);
+        Q_UNUSED(locker);
+        task->frame = last_frame;
+    }
     if (isAsync()) {
-        QThreadPool::globalInstance()->start(task);
+        enqueue(task);
     } else {
-        task->run();
+        JpegEncoder encoder;
+        task->run(&encoder);
+        delete task;
+    }
+}
+
+void VideoCapture::capture(const VideoFrame &frame, const QString &baseName)
+{
+    int index = 0;
+    {
+        QWriteLocker locker(&lock);
+        Q_UNUSED(locker);
+        if (!is_requested)
+            return;
+        if (frame_count++ % burst_interval)
+            return;
+        index = burst_index++;
+        if (burst_index >= burst_frames)
+            is_requested = false;
+        last_frame = frame.clone();
+    }
+    const QString user_name(name);
+    bool auto_name = user_name.isEmpty() && autoSave();
+    if (auto_name)
+        name = baseName + "_" + QString::number(pts, 'f', 3);
+    else if (burst_frames > 1)
+        name = user_name + "_" + QString::number(index);
+    start();
+    name = user_name;
+}
+
+void VideoCapture::enqueue(CaptureTask *task)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    CaptureTask *old = 0;
+    if (!pending.put(task, &mutex, &cond, 0, &old)) {
+        qWarning("VideoCapture: %d captures pending. drop the newest one", pending.size());
+        delete task;
+        return;
+    }
+    if (old) {
+        qWarning("VideoCapture: %d captures pending. drop the oldest one", pending.size());
+        delete old;
+    }
+    if (workers < pool.maxThreadCount()) {
+        workers++;
+        pool.start(new CaptureWorker(this));
     }
 }
 
@@ -210,31 +326,70 @@ QString VideoCapture::captureDir() const
     return dir;
 }
 
-void VideoCapture::setRawImage(const QByteArray &raw, const QSize &size, QImage::Format fmt)
+void VideoCapture::setThreadCount(int count)
 {
-    setRawImage(raw, size.width(), size.height(), fmt);
+    pool.setMaxThreadCount(qMax(count, 1));
 }
 
-void VideoCapture::setRawImage(const QByteArray &raw, int w, int h, QImage::Format fmt)
+int VideoCapture::threadCount() const
 {
-    QWriteLocker locker(&lock);
-    Q_UNUSED(locker);
-    width = w;
-    height = h;
-    qfmt = fmt;
-    data = raw;
+    return pool.maxThreadCount();
+}
+
+void VideoCapture::setMaxPending(int count)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    pending.setCapacity(count);
+    cond.wakeAll();
+}
+
+int VideoCapture::maxPending() const
+{
+    return pending.capacity();
+}
+
+void VideoCapture::setDropPolicy(DropPolicy policy)
+{
+    pending.setDropPolicy(policy);
+}
+
+DropPolicy VideoCapture::dropPolicy() const
+{
+    return pending.dropPolicy();
+}
+
+int VideoCapture::droppedCount() const
+{
+    return pending.droppedCount();
+}
+
+QImage VideoCapture::toImage(const VideoFrame &frame, ImageConverter *&conv)
+{
+    if (!frame.isValid())
+        return QImage();
+    const VideoFrame f(convertFrame(frame, QTAV_PIX_FMT_C(RGB32), frame.size(), conv));
+    if (!f.isValid())
+        return QImage();
+    return QImage(f.bits(0), f.width(), f.height(), f.bytesPerLine(0), QImage::Format_RGB32).copy();
 }
 
 void VideoCapture::getRawImage(QByteArray *raw, int *w, int *h, QImage::Format *fmt)
 {
-    QReadLocker locker(&lock);
-    Q_UNUSED(locker);
-    *raw = data;
-    *w = width;
-    *h = height;
+    VideoFrame frame;
+    {
+        QReadLocker locker(&lock);
+        Q_UNUSED(locker);
+        frame = last_frame;
+    }
+    ImageConverter *conv = 0;
+    const QImage image(toImage(frame, conv));
+    delete conv;
+    *raw = QByteArray((const char*)image.constBits(), image.byteCount());
+    *w = image.width();
+    *h = image.height();
     if (fmt)
-        *fmt = qfmt;
+        *fmt = QImage::Format_RGB32;
 }
 
 } //namespace QtAV
-
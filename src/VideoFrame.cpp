@@ -181,7 +181,15 @@ VideoFrame VideoFrame::clone() const
     for (int i = 0; i < d->format.planeCount(); ++i) {
         // TODO: is plane 0 always luma?
         int h = i == 0 ? height() : d->format.chromaHeight(height());
-        memcpy(f.bits(i), bits(i), bytesPerLine(i)*h);
+        // the source may be a decoder's frame whose lines are padded
+        const int bpl = qMin(bytesPerLine(i), f.bytesPerLine(i));
+        const uchar *src = bits(i);
+        uchar *dst = f.bits(i);
+        for (int y = 0; y < h; ++y) {
+            memcpy(dst, src, bpl);
+            src += bytesPerLine(i);
+            dst += f.bytesPerLine(i);
+        }
     }
     return f;
 }
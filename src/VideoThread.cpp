@@ -24,6 +24,8 @@
 #include <QtAV/Packet.h>
 #include <QtAV/AVClock.h>
 #include <QtAV/VideoCapture.h>
+#include <QtAV/FrameExporter.h>
+#include <QtAV/FrameSink.h>
 #include <QtAV/VideoDecoder.h>
 #include <QtAV/VideoRenderer.h>
 #include <QtAV/ImageConverter.h>
@@ -45,6 +47,8 @@ public:
     VideoThreadPrivate():
         conv(0)
       , capture(0)
+      , exporter(0)
+      , stream(-1)
     {
         conv = ImageConverterFactory::create(ImageConverterId_FF); //TODO: set in AVPlayer
         conv->setOutFormat(PIX_FMT); //vo->defaultFormat
@@ -60,6 +64,9 @@ public:
     double pts; //current decoded pts. for capture. TODO: remove
     //QImage image; //use QByteArray? Then must allocate a picture in ImageConverter, see VideoDecoder
     VideoCapture *capture;
+    FrameExporter *exporter;
+    QList<FrameSink*> sinks;
+    int stream; //index in the file. for the sinks
 };
 
 VideoThread::VideoThread(QObject *parent) :
@@ -78,6 +85,37 @@ VideoCapture* VideoThread::setVideoCapture(VideoCapture *cap)
     return old;
 }
 
+FrameExporter* VideoThread::setFrameExporter(FrameExporter *exporter)
+{
+    DPTR_D(VideoThread);
+    QMutexLocker locker(&d.mutex);
+    FrameExporter *old = d.exporter;
+    d.exporter = exporter;
+    return old;
+}
+
+void VideoThread::setStreamIndex(int stream)
+{
+    d_func().stream = stream;
+}
+
+bool VideoThread::installFrameSink(FrameSink *sink)
+{
+    DPTR_D(VideoThread);
+    QMutexLocker locker(&d.mutex);
+    if (d.sinks.contains(sink))
+        return false;
+    d.sinks.append(sink);
+    return true;
+}
+
+bool VideoThread::uninstallFrameSink(FrameSink *sink)
+{
+    DPTR_D(VideoThread);
+    QMutexLocker locker(&d.mutex);
+    return d.sinks.removeOne(sink);
+}
+
 void VideoThread::setBrightness(int val)
 {
     DPTR_D(VideoThread);
@@ -184,11 +222,15 @@ void VideoThread::run()
             wait_key_frame = true;
             qDebug("Invalid packet! flush video codec context!!!!!!!!!! video packet queue size: %d", d.packets.size());
             dec->flush();
+            takeSeekTarget();
             continue;
         }
         qreal pts = pkt.pts;
+        const qreal duration = pkt.duration;
         // TODO: delta ref time
-        d.delay = pts - d.clock->value();
+        // no sync when decoding to the accurate seek target or exporting as fast as possible
+        const bool unthrottled = d.exporter && d.exporter->isRunning() && d.exporter->isUnthrottled();
+        d.delay = (d.seek_target >= 0 || unthrottled) ? 0 : pts - d.clock->value();
         /*
          *after seeking forward, a packet may be the old, v packet may be
          *the new packet, then the d.delay is very large, omit it.
@@ -259,9 +301,23 @@ void VideoThread::run()
 
         if (skip_render)
             continue;
+        // accurate seek. frames before the target are not converted or rendered
+        const bool seeking = d.seek_target >= 0;
+        if (seeking && pts + qMax<qreal>(duration, 0.001) <= d.seek_target)
+            continue;
         VideoFrame frame = dec->frame();
         if (!frame.isValid())
             continue;
+        // the decoded frame before filters and conversion
+        QList<FrameSink*> sinks;
+        {
+            QMutexLocker locker(&d.mutex);
+            Q_UNUSED(locker);
+            sinks = d.sinks;
+        }
+        foreach (FrameSink *sink, sinks) {
+            sink->put(frame, pts, d.stream);
+        }
         d.conv->setInFormat(frame.pixelFormatFFmpeg());
         d.conv->setInSize(frame.width(), frame.height());
         d.conv->setOutSize(frame.width(), frame.height());
@@ -300,26 +356,25 @@ void VideoThread::run()
             qDebug("video thread stop before send decoded data");
             break;
         }
-        frame.convertTo(VideoFormat::Format_RGB32);
-        d.outputSet->sendVideoFrame(frame); //TODO: group by format, convert group by group
         d.capture->setPosition(pts);
+        // in the decoded format. no conversion in this thread
         if (d.capture->isRequested()) {
-            bool auto_name = d.capture->name.isEmpty() && d.capture->autoSave();
-            if (auto_name) {
-                QString cap_name;
-                if (d.statistics)
-                    cap_name = QFileInfo(d.statistics->url).completeBaseName();
-                d.capture->setCaptureName(cap_name + "_" + QString::number(pts, 'f', 3));
-            }
-            //TODO: what if not rgb32 now? detach the frame
-            //FIXME: why frame.data() may crash?
-            d.capture->setRawImage(frame.frameData(), frame.width(), frame.height(), frame.imageFormat());
-            d.capture->start();
-            if (auto_name)
-                d.capture->setCaptureName("");
+            QString cap_name;
+            if (d.statistics)
+                cap_name = QFileInfo(d.statistics->url).completeBaseName();
+            d.capture->capture(frame, cap_name);
         }
+        if (d.exporter)
+            d.exporter->process(frame, pts);
+        frame.convertTo(VideoFormat::Format_RGB32);
+        d.outputSet->sendVideoFrame(frame); //TODO: group by format, convert group by group
+        if (seeking)
+            finishSeek(pts);
     }
     d.capture->cancel();
+    // e.g. uninstalling a frame sink. the caller waits for it
+    while (!d.tasks.isEmpty())
+        processNextTask();
     qDebug("Video thread stops running...");
 }
 
@@ -0,0 +1,449 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2013 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include <QtAV/VideoThumbnailer.h>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/ImageConverter.h>
+#include <QtAV/ImageConverterTypes.h>
+#include <QtAV/Packet.h>
+#include <QtAV/VideoDecoder.h>
+#include <QtAV/VideoDecoderTypes.h>
+#include <QtAV/QtAV_Compat.h>
+#include <QtCore/QCache>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+namespace QtAV {
+
+static const int kMaxPackets = 512; //video packets read to find a key frame
+static const int kMaxLowres = 3;
+
+class ThumbnailDecoder
+{
+public:
+    ThumbnailDecoder()
+        : dec(0)
+        , conv(0)
+        , lowres(0)
+    {}
+    ~ThumbnailDecoder() {
+        if (dec) {
+            dec->close();
+            delete dec;
+            dec = 0;
+        }
+        if (conv) {
+            delete conv;
+            conv = 0;
+        }
+        demuxer.close();
+    }
+    bool open(const QString& fileName) {
+        file = fileName;
+        if (!demuxer.loadFile(file))
+            return false;
+        AVCodecContext *codec_ctx = demuxer.videoCodecContext();
+        if (demuxer.videoStream() < 0 || !codec_ctx) {
+            qWarning("VideoThumbnailer: no video stream in %s", qPrintable(file));
+            return false;
+        }
+        demuxer.discardStreamsExcept(QList<int>() << demuxer.videoStream());
+        // decode key frames only
+        codec_ctx->skip_frame = AVDISCARD_NONKEY;
+        dec = VideoDecoderFactory::create(VideoDecoderId_FFmpeg);
+        if (!dec)
+            return false;
+        dec->setCodecContext(codec_ctx);
+        // requests run in parallel. frame threads also delay the output
+        dec->setDecodeThreads(1);
+        if (!dec->open())
+            return false;
+        dec->prepare();
+        conv = ImageConverterFactory::create(ImageConverterId_FF);
+        if (!conv)
+            return false;
+        conv->setOutFormat(VideoFormat::Format_RGB32);
+        return true;
+    }
+    QImage thumbnail(qint64 pos, const QSize& size) {
+        const AVCodecContext *codec_ctx = demuxer.videoCodecContext();
+        const QSize video_size(codec_ctx->width << lowres, codec_ctx->height << lowres);
+        if (video_size.isEmpty())
+            return QImage();
+        QSize out_size(video_size);
+        out_size.scale(size, Qt::KeepAspectRatio);
+        out_size = out_size.expandedTo(QSize(1, 1));
+        int level = 0;
+        while (level < kMaxLowres
+               && (video_size.width() >> (level + 1)) >= out_size.width()
+               && (video_size.height() >> (level + 1)) >= out_size.height()) {
+            ++level;
+        }
+        if (level != lowres) {
+            dec->close();
+            dec->setLowResolution(level);
+            if (!dec->open())
+                return QImage();
+            lowres = dec->lowResolution();
+        }
+        if (demuxer.duration() > 0)
+            pos = qBound<qint64>(0, pos, demuxer.duration() - 1);
+        demuxer.seek(pos);
+        dec->flush();
+        // frame() is invalid until a frame is decoded
+        dec->resizeVideoFrame(0, 0);
+        const int stream = demuxer.videoStream();
+        for (int i = 0; i < kMaxPackets;) {
+            if (!demuxer.readFrame()) {
+                if (demuxer.atEnd())
+                    break;
+                ++i;
+                continue;
+            }
+            const Packet *pkt = demuxer.packet();
+            if (pkt->isEnd())
+                break;
+            if (demuxer.stream() != stream)
+                continue;
+            ++i;
+            if (!dec->decode(pkt->data))
+                continue;
+            VideoFrame frame(dec->frame());
+            if (!frame.isValid())
+                continue;
+            const quint8 *planes[4] = { 0, 0, 0, 0 };
+            int strides[4] = { 0, 0, 0, 0 };
+            for (int p = 0; p < qMin(frame.planeCount(), 4); ++p) {
+                planes[p] = frame.bits(p);
+                strides[p] = frame.bytesPerLine(p);
+            }
+            conv->setInFormat(frame.pixelFormatFFmpeg());
+            conv->setInSize(frame.width(), frame.height());
+            conv->setOutSize(out_size.width(), out_size.height());
+            if (!conv->convert(planes, strides))
+                return QImage();
+            const QByteArray data(conv->outData());
+            return QImage((const uchar*)data.constData(), out_size.width(), out_size.height()
+                          , conv->outLineSizes().at(0), QImage::Format_RGB32).copy();
+        }
+        return QImage();
+    }
+
+    QString file;
+    AVDemuxer demuxer;
+    VideoDecoder *dec;
+    ImageConverter *conv;
+    int lowres;
+};
+
+struct ThumbnailRequest
+{
+    QString file;
+    QSize size;
+    qint64 pos; //the bucket position
+    QString key;
+    QList<qint64> positions; //requested positions in the bucket
+};
+
+// a dropped or cancelled request fails for every requested position
+static void failRequest(VideoThumbnailer *t, const ThumbnailRequest& r)
+{
+    foreach (qint64 pos, r.positions) {
+        QMetaObject::invokeMethod(t, "failed", Qt::QueuedConnection
+                                  , Q_ARG(QString, r.file), Q_ARG(qint64, pos));
+    }
+}
+
+class VideoThumbnailerPrivate : public DPtrPrivate<VideoThumbnailer>
+{
+public:
+    VideoThumbnailerPrivate()
+        : bucket(1000)
+        , max_decoders(8)
+        , max_pending(32)
+        , workers(0)
+        , decoders(0)
+    {
+        cache.setMaxCost(32*1024);
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+    }
+    ~VideoThumbnailerPrivate() {
+        qDeleteAll(idle);
+        idle.clear();
+    }
+    QString key(const QString& file, qint64 pos, const QSize& size) const {
+        return QString("%1|%2|%3x%4").arg(file).arg(pos/bucket).arg(size.width()).arg(size.height());
+    }
+    // a decoder of the file, or a new one. called in worker thread
+    ThumbnailDecoder* acquire(const QString& file) {
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            for (int i = idle.size() - 1; i >= 0; --i) {
+                if (idle[i]->file == file)
+                    return idle.takeAt(i);
+            }
+            if (decoders >= max_decoders && !idle.isEmpty()) {
+                delete idle.takeFirst();
+                decoders--;
+            }
+            decoders++;
+        }
+        ThumbnailDecoder *dec = new ThumbnailDecoder();
+        if (dec->open(file))
+            return dec;
+        delete dec;
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        decoders--;
+        return 0;
+    }
+    void release(ThumbnailDecoder *dec) {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        idle.append(dec); //the last is the most recently used
+        while (decoders > max_decoders && !idle.isEmpty()) {
+            delete idle.takeFirst();
+            decoders--;
+        }
+    }
+
+    int bucket;
+    int max_decoders;
+    int max_pending;
+    QThreadPool pool;
+    // protected by mutex
+    QMutex mutex;
+    QList<ThumbnailRequest> requests; //the last is the newest
+    QHash<QString, QList<qint64> > running; //key => requested positions
+    QCache<QString, QImage> cache; //cost is KB
+    QList<ThumbnailDecoder*> idle;
+    int workers;
+    int decoders;
+};
+
+class ThumbnailWorker : public QRunnable
+{
+public:
+    ThumbnailWorker(VideoThumbnailer *thumbnailer)
+        : t(thumbnailer)
+    {
+        setAutoDelete(true);
+    }
+    virtual void run() {
+        VideoThumbnailerPrivate &d = t->d_func();
+        forever {
+            ThumbnailRequest r;
+            {
+                QMutexLocker lock(&d.mutex);
+                Q_UNUSED(lock);
+                if (d.requests.isEmpty()) {
+                    d.workers--;
+                    return;
+                }
+                r = d.requests.takeLast();
+                d.running.insert(r.key, r.positions);
+            }
+            QImage image;
+            ThumbnailDecoder *dec = d.acquire(r.file);
+            if (dec) {
+                image = dec->thumbnail(r.pos, r.size);
+                d.release(dec);
+            }
+            QList<qint64> positions;
+            {
+                QMutexLocker lock(&d.mutex);
+                Q_UNUSED(lock);
+                positions = d.running.take(r.key);
+                if (!image.isNull())
+                    d.cache.insert(r.key, new QImage(image), qMax(1, image.byteCount()/1024));
+            }
+            foreach (qint64 pos, positions) {
+                if (image.isNull()) {
+                    QMetaObject::invokeMethod(t, "failed", Qt::QueuedConnection
+                                              , Q_ARG(QString, r.file), Q_ARG(qint64, pos));
+                } else {
+                    QMetaObject::invokeMethod(t, "ready", Qt::QueuedConnection
+                                              , Q_ARG(QString, r.file), Q_ARG(qint64, pos), Q_ARG(QImage, image));
+                }
+            }
+        }
+    }
+
+private:
+    VideoThumbnailer *t;
+};
+
+VideoThumbnailer::VideoThumbnailer(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<qint64>("qint64");
+}
+
+VideoThumbnailer::~VideoThumbnailer()
+{
+    cancel();
+    d_func().pool.waitForDone();
+}
+
+void VideoThumbnailer::setTimeBucket(int ms)
+{
+    DPTR_D(VideoThumbnailer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.bucket = qMax(1, ms);
+    d.cache.clear();
+}
+
+int VideoThumbnailer::timeBucket() const
+{
+    return d_func().bucket;
+}
+
+void VideoThumbnailer::setThreadCount(int count)
+{
+    d_func().pool.setMaxThreadCount(qMax(1, count));
+}
+
+int VideoThumbnailer::threadCount() const
+{
+    return d_func().pool.maxThreadCount();
+}
+
+void VideoThumbnailer::setDecoderCount(int count)
+{
+    DPTR_D(VideoThumbnailer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.max_decoders = qMax(1, count);
+}
+
+int VideoThumbnailer::decoderCount() const
+{
+    return d_func().max_decoders;
+}
+
+void VideoThumbnailer::setCacheLimit(int kb)
+{
+    DPTR_D(VideoThumbnailer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.cache.setMaxCost(kb);
+}
+
+int VideoThumbnailer::cacheLimit() const
+{
+    return d_func().cache.maxCost();
+}
+
+void VideoThumbnailer::setMaxPendingRequests(int count)
+{
+    DPTR_D(VideoThumbnailer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.max_pending = qMax(1, count);
+}
+
+int VideoThumbnailer::maxPendingRequests() const
+{
+    return d_func().max_pending;
+}
+
+void VideoThumbnailer::request(const QString &file, qint64 pos, const QSize &size)
+{
+    DPTR_D(VideoThumbnailer);
+    if (file.isEmpty() || size.isEmpty()) {
+        qWarning("VideoThumbnailer: invalid request");
+        QMetaObject::invokeMethod(this, "failed", Qt::QueuedConnection, Q_ARG(QString, file), Q_ARG(qint64, pos));
+        return;
+    }
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    const QString key(d.key(file, pos, size));
+    QImage *image = d.cache.object(key);
+    if (image) {
+        QMetaObject::invokeMethod(this, "ready", Qt::QueuedConnection
+                                  , Q_ARG(QString, file), Q_ARG(qint64, pos), Q_ARG(QImage, *image));
+        return;
+    }
+    if (d.running.contains(key)) {
+        d.running[key].append(pos);
+        return;
+    }
+    for (int i = 0; i < d.requests.size(); ++i) {
+        if (d.requests[i].key == key) {
+            // move to the end so that it runs earlier
+            ThumbnailRequest r(d.requests.takeAt(i));
+            r.positions.append(pos);
+            d.requests.append(r);
+            return;
+        }
+    }
+    ThumbnailRequest r;
+    r.file = file;
+    r.size = size;
+    r.pos = pos/d.bucket*d.bucket + d.bucket/2;
+    r.key = key;
+    r.positions.append(pos);
+    d.requests.append(r);
+    while (d.requests.size() > d.max_pending) {
+        failRequest(this, d.requests.takeFirst());
+    }
+    if (d.workers < d.pool.maxThreadCount()) {
+        d.workers++;
+        d.pool.start(new ThumbnailWorker(this));
+    }
+}
+
+QImage VideoThumbnailer::cached(const QString &file, qint64 pos, const QSize &size) const
+{
+    DPTR_D(const VideoThumbnailer);
+    QMutexLocker lock(const_cast<QMutex*>(&d.mutex));
+    Q_UNUSED(lock);
+    // QCache::object() updates the LRU order
+    QImage *image = const_cast<QCache<QString, QImage>&>(d.cache).object(d.key(file, pos, size));
+    if (!image)
+        return QImage();
+    return *image;
+}
+
+void VideoThumbnailer::cancel()
+{
+    DPTR_D(VideoThumbnailer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    foreach (const ThumbnailRequest& r, d.requests) {
+        failRequest(this, r);
+    }
+    d.requests.clear();
+}
+
+void VideoThumbnailer::clearCache()
+{
+    DPTR_D(VideoThumbnailer);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.cache.clear();
+}
+
+} //namespace QtAV
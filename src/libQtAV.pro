@@ -134,27 +134,42 @@ SOURCES += \
     AudioThread.cpp \
     AVThread.cpp \
     AudioDecoder.cpp \
+    AudioFilter.cpp \
     AudioFormat.cpp \
     AudioFrame.cpp \
     AudioOutput.cpp \
+    AudioOutputMixer.cpp \
     AudioOutputTypes.cpp \
     AudioResampler.cpp \
     AudioResamplerTypes.cpp \
+    AudioWaveform.cpp \
     AVDecoder.cpp \
     AVDemuxer.cpp \
     AVDemuxThread.cpp \
+    AVPreloader.cpp \
     Frame.cpp \
+    FrameExporter.cpp \
+    FrameSink.cpp \
+    FrameUtils.cpp \
+    LoudnessMeter.cpp \
     Filter.cpp \
     FilterContext.cpp \
     FilterManager.cpp \
+    GOPCache.cpp \
     GraphicsItemRenderer.cpp \
     ImageConverter.cpp \
     ImageConverterFF.cpp \
     ImageConverterIPP.cpp \
+    JpegEncoder.cpp \
+    KeyFrameIndex.cpp \
+    MediaIO.cpp \
     QPainterRenderer.cpp \
     OSD.cpp \
     OSDFilter.cpp \
     Packet.cpp \
+    PacketMuxer.cpp \
+    ProbeCache.cpp \
+    SegmentExporter.cpp \
     AVError.cpp \
     AVPlayer.cpp \
     VideoCapture.cpp \
@@ -168,11 +183,13 @@ SOURCES += \
     OutputSet.cpp \
     AVClock.cpp \
     Statistics.cpp \
+    StreamRecorder.cpp \
     VideoDecoder.cpp \
     VideoDecoderTypes.cpp \
     VideoDecoderFFmpeg.cpp \
     VideoDecoderFFmpegHW.cpp \
-    VideoThread.cpp
+    VideoThread.cpp \
+    VideoThumbnailer.cpp
 
 SDK_HEADERS *= \
     QtAV/QtAV.h \
@@ -181,23 +198,32 @@ SDK_HEADERS *= \
     QtAV/AudioResampler.h \
     QtAV/AudioResamplerTypes.h \
     QtAV/AudioDecoder.h \
+    QtAV/AudioFilter.h \
     QtAV/AudioFormat.h \
     QtAV/AudioFrame.h \
     QtAV/AudioOutput.h \
+    QtAV/AudioOutputMixer.h \
     QtAV/AudioOutputTypes.h \
+    QtAV/AudioWaveform.h \
     QtAV/AVDecoder.h \
     QtAV/AVDemuxer.h \
     QtAV/BlockingQueue.h \
+    QtAV/BoundedQueue.h \
     QtAV/Filter.h \
     QtAV/FilterContext.h \
     QtAV/Frame.h \
+    QtAV/FrameExporter.h \
+    QtAV/FrameSink.h \
+    QtAV/LoudnessMeter.h \
     QtAV/GraphicsItemRenderer.h \
     QtAV/ImageConverter.h \
     QtAV/ImageConverterTypes.h \
+    QtAV/KeyFrameIndex.h \
     QtAV/QPainterRenderer.h \
     QtAV/OSD.h \
     QtAV/OSDFilter.h \
     QtAV/Packet.h \
+    QtAV/SegmentExporter.h \
     QtAV/AVError.h \
     QtAV/AVPlayer.h \
     QtAV/VideoCapture.h \
@@ -212,8 +238,10 @@ SDK_HEADERS *= \
     QtAV/VideoDecoderFFmpegHW.h \
     QtAV/VideoFormat.h \
     QtAV/VideoFrame.h \
+    QtAV/VideoThumbnailer.h \
     QtAV/FactoryDefine.h \
     QtAV/Statistics.h \
+    QtAV/StreamRecorder.h \
     QtAV/version.h
 
 
@@ -221,6 +249,7 @@ HEADERS *= \
     $$SDK_HEADERS \
     QtAV/prepost.h \
     QtAV/AVDemuxThread.h \
+    QtAV/AVPreloader.h \
     QtAV/AVThread.h \
     QtAV/AudioThread.h \
     QtAV/VideoThread.h \
@@ -230,6 +259,12 @@ HEADERS *= \
     QtAV/singleton.h \
     QtAV/factory.h \
     QtAV/FilterManager.h \
+    QtAV/GOPCache.h \
+    QtAV/MediaIO.h \
+    QtAV/ProbeCache.h \
+    QtAV/PacketMuxer.h \
+    QtAV/FrameUtils.h \
+    QtAV/JpegEncoder.h \
     QtAV/private/AudioOutput_p.h \
     QtAV/private/AudioResampler_p.h \
     QtAV/private/AVThread_p.h \
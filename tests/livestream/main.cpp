@@ -0,0 +1,117 @@
+/*
+ * Live mode and jitter buffer test.
+ * usage: livestream [-port 1234] [-bitrate kbps] [-jitter ms] [-latency ms] file.ts
+ * file.ts is sent to udp://127.0.0.1:port in 7 ts packet datagrams at bitrate(default 4000kbps),
+ * each one delayed by a random 0~jitter ms(default 200), and looped at the end. The stream is
+ * played in live mode with the jitter buffer. latency and the jitter buffer statistics are
+ * printed every second: latency should stay around the target, and the jitter buffer target
+ * should follow the injected jitter.
+ */
+#include <stdio.h>
+#include <QApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QThread>
+#include <QtNetwork/QUdpSocket>
+#include <QtAV/QtAV.h>
+
+using namespace QtAV;
+class Sender : public QThread
+{
+public:
+    Sender(const QString& file, quint16 port, int kbps, int jitterMs):
+        QThread(0)
+      , stop(false)
+      , mFile(file)
+      , mPort(port)
+      , mKbps(qMax(kbps, 1))
+      , mJitter(qMax(jitterMs, 0))
+    {}
+    volatile bool stop;
+protected:
+    virtual void run() {
+        QFile f(mFile);
+        if (!f.open(QIODevice::ReadOnly)) {
+            qWarning("can not open %s", qPrintable(mFile));
+            return;
+        }
+        QUdpSocket socket;
+        QElapsedTimer timer;
+        timer.start();
+        qint64 sent = 0;
+        while (!stop) {
+            QByteArray data(f.read(188*7));
+            if (data.isEmpty()) {
+                f.seek(0);
+                continue;
+            }
+            // the send time at the bitrate, then delayed with jitter
+            qint64 due = sent*8LL/mKbps;
+            if (mJitter > 0)
+                due += qrand() % (mJitter + 1);
+            const qint64 wait = due - timer.elapsed();
+            if (wait > 0)
+                msleep(wait);
+            socket.writeDatagram(data, QHostAddress::LocalHost, mPort);
+            sent += data.size();
+        }
+    }
+private:
+    QString mFile;
+    quint16 mPort;
+    int mKbps, mJitter;
+};
+
+class Monitor : public QObject
+{
+public:
+    Monitor(AVPlayer *player) : QObject(0), mpPlayer(player) {
+        startTimer(1000);
+    }
+protected:
+    virtual void timerEvent(QTimerEvent *) {
+        const Statistics::JitterBuffer jb(mpPlayer->statistics().jitterBuffer());
+        printf("latency: %dms(target %dms) jitter: %dms buffer depth: %dms target: %dms underruns: %d overflows: %d\n"
+               , mpPlayer->latency(), mpPlayer->latencyTarget(), jb.jitter, jb.depth, jb.target, jb.underruns, jb.overflows);
+        fflush(stdout);
+    }
+    AVPlayer *mpPlayer;
+};
+
+static int intOption(const QStringList& args, const QString& name, int defaultValue)
+{
+    const int i = args.indexOf(name);
+    if (i < 0 || i + 1 >= args.size())
+        return defaultValue;
+    return args.at(i + 1).toInt();
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    const QStringList args(a.arguments());
+    if (args.size() < 2) {
+        printf("usage: %s [-port 1234] [-bitrate kbps] [-jitter ms] [-latency ms] file.ts\n", argv[0]);
+        return 1;
+    }
+    const quint16 port = intOption(args, "-port", 1234);
+    Sender sender(args.last(), port, intOption(args, "-bitrate", 4000), intOption(args, "-jitter", 200));
+    sender.start();
+
+    AVPlayer player;
+    WidgetRenderer renderer;
+    renderer.show();
+    player.addVideoRenderer(&renderer);
+    player.setLiveMode(true);
+    player.setLatencyTarget(intOption(args, "-latency", 500));
+    player.setJitterBufferEnabled(true);
+    player.setFile(QString("udp://127.0.0.1:%1").arg(port));
+    player.play();
+    Monitor monitor(&player);
+
+    int ret = a.exec();
+    player.stop();
+    sender.stop = true;
+    sender.wait();
+    return ret;
+}